@@ -1,5 +1,8 @@
 C:\VulkanSDK\1.3.243.0\Bin\glslc.exe shaders\simple_shader.vert -o shaders\simple_shader.vert.spv
+C:\VulkanSDK\1.3.243.0\Bin\glslc.exe -DOCTAHEDRAL_NORMAL shaders\simple_shader.vert -o shaders\simple_shader_compact.vert.spv
+C:\VulkanSDK\1.3.243.0\Bin\glslc.exe -DOCTAHEDRAL_NORMAL -DNO_COLOR shaders\simple_shader.vert -o shaders\simple_shader_compact_no_color.vert.spv
 C:\VulkanSDK\1.3.243.0\Bin\glslc.exe shaders\simple_shader.frag -o shaders\simple_shader.frag.spv
 C:\VulkanSDK\1.3.243.0\Bin\glslc.exe shaders\point_light.vert -o shaders\point_light.vert.spv
 C:\VulkanSDK\1.3.243.0\Bin\glslc.exe shaders\point_light.frag -o shaders\point_light.frag.spv
+C:\VulkanSDK\1.3.243.0\Bin\glslc.exe shaders\cull.comp -o shaders\cull.comp.spv
 pause
\ No newline at end of file
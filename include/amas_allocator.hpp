@@ -0,0 +1,122 @@
+#pragma once
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std
+#include <array>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace amas {
+
+	class AmasMemoryBlock;
+
+	// A sub-range of a VkDeviceMemory block handed out by AmasAllocator.
+	// The pointer stays valid until AmasAllocator::free, defragmentation may update memory/offset in place.
+	struct AmasAllocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+
+		// owner of the allocation, handed back through defragmentation moves so it can recreate its
+		// resource. Set by AmasDevice::createBuffer/createImageWithInfo, allocations without one
+		// are never moved.
+		void* userData = nullptr;
+
+	private:
+		friend class AmasAllocator;
+
+		AmasMemoryBlock* block = nullptr;
+		uint32_t node = 0;
+		VkDeviceSize alignment = 1;
+		uint32_t mapCount = 0;
+		bool linear = true;
+	};
+
+	class AmasAllocator {
+	public:
+		static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+		struct Stats {
+			uint32_t blockCount = 0;
+			uint32_t dedicatedBlockCount = 0;
+			uint32_t allocationCount = 0;
+			VkDeviceSize bytesReserved = 0;
+			VkDeviceSize bytesUsed = 0;
+			VkDeviceSize largestFreeRange = 0;
+			uint32_t freeRangeCount = 0;
+
+			// 0 when all free space is one contiguous range, approaching 1 as it splinters
+			float fragmentation() const;
+		};
+
+		// Destination reserved for an allocation by beginDefragmentation. The caller copies the
+		// contents to dstMemory/dstOffset and rebinds its resource before calling endDefragmentation,
+		// or gives the destinations back with cancelDefragmentation.
+		struct DefragmentationMove {
+			AmasAllocation* allocation;
+			VkDeviceMemory dstMemory;
+			VkDeviceSize dstOffset;
+
+		private:
+			friend class AmasAllocator;
+
+			AmasMemoryBlock* dstBlock;
+			uint32_t dstNode;
+		};
+
+		AmasAllocator(
+			VkDevice device,
+			VkPhysicalDevice physicalDevice,
+			VkDeviceSize preferredBlockSize = DEFAULT_BLOCK_SIZE);
+		~AmasAllocator();
+
+		AmasAllocator(const AmasAllocator&) = delete;
+		AmasAllocator& operator=(const AmasAllocator&) = delete;
+
+		AmasAllocation* allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, bool linear);
+		void free(AmasAllocation* allocation);
+
+		VkResult map(AmasAllocation* allocation, void** data);
+		void unmap(AmasAllocation* allocation);
+		VkResult flush(const AmasAllocation* allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		VkResult invalidate(const AmasAllocation* allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+		std::vector<DefragmentationMove> beginDefragmentation(uint32_t memoryTypeIndex, uint32_t maxMoves = 64);
+		void endDefragmentation(const std::vector<DefragmentationMove>& moves);
+		void cancelDefragmentation(const std::vector<DefragmentationMove>& moves);
+
+		Stats getStats() const;
+		Stats getStats(uint32_t memoryTypeIndex) const;
+		void printStats(std::ostream& out) const;
+
+	private:
+		struct Pool {
+			std::vector<std::unique_ptr<AmasMemoryBlock>> blocks;
+		};
+
+		Pool& poolFor(uint32_t memoryTypeIndex, bool linear);
+		AmasMemoryBlock* createBlock(uint32_t memoryTypeIndex, VkDeviceSize minSize, bool dedicated);
+		void destroyBlock(Pool& pool, AmasMemoryBlock* block);
+		VkDeviceSize blockSizeFor(uint32_t memoryTypeIndex) const;
+		VkMappedMemoryRange mappedRange(const AmasAllocation* allocation, VkDeviceSize size, VkDeviceSize offset) const;
+		void accumulateStats(const Pool& pool, Stats& stats) const;
+
+		VkDevice device;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkDeviceSize preferredBlockSize;
+		VkDeviceSize bufferImageGranularity;
+		VkDeviceSize nonCoherentAtomSize;
+		uint32_t maxMemoryAllocationCount;
+		uint32_t deviceMemoryCount = 0;
+
+		// two pools per memory type when bufferImageGranularity forces linear and optimal resources apart
+		std::array<Pool, VK_MAX_MEMORY_TYPES * 2> pools;
+		mutable std::mutex mutex;
+	};
+
+}  // namespace amas
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "amas_device.hpp"
+#include "amas_ecs.hpp"
+#include "amas_game_object.hpp"
+#include "amas_job_system.hpp"
+#include "amas_model.hpp"
+#include "amas_texture.hpp"
+
+// std
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace amas {
+
+	// Result of one load, empty until the asset is ready.
+	template <typename T>
+	class AmasAsset {
+	public:
+		explicit AmasAsset(std::string path) : path{ std::move(path) } {}
+
+		bool isReady() const { return ready.load(std::memory_order_acquire); }
+		// null until isReady()
+		const std::shared_ptr<T>& get() const { return asset; }
+		const std::string& getPath() const { return path; }
+
+	private:
+		friend class AmasAssetLoader;
+
+		std::string path;
+		std::shared_ptr<T> asset;
+		std::atomic<bool> ready{ false };
+	};
+
+	template <typename T>
+	using AmasAssetHandle = std::shared_ptr<AmasAsset<T>>;
+
+	// Decodes models and textures on the job system's workers. The gpu resources are created on
+	// the main thread by update(), their uploads then travel through the uploader like any other.
+	// Entities assigned an asset that is still loading show a placeholder until it is ready.
+	class AmasAssetLoader {
+	public:
+		AmasAssetLoader(AmasDevice& device, AmasJobSystem& jobSystem);
+		~AmasAssetLoader();
+
+		AmasAssetLoader(const AmasAssetLoader&) = delete;
+		AmasAssetLoader& operator=(const AmasAssetLoader&) = delete;
+
+		AmasAssetHandle<AmasModel> loadModel(const std::string& filepath);
+		AmasAssetHandle<AmasTexture> loadTexture(const std::string& filepath);
+
+		// Gives the entity the placeholder right away and the asset once it is ready.
+		void assignModel(AmasRegistry& registry, Entity entity, const AmasAssetHandle<AmasModel>& model);
+		void assignTexture(AmasRegistry& registry, Entity entity, const AmasAssetHandle<AmasTexture>& texture);
+
+		// Creates the gpu resources of everything decoded since the last call and swaps them into
+		// the entities waiting for them. Returns true when a material changed, descriptor sets
+		// holding its image have to be rewritten. Main thread only, decoding errors are rethrown here
+		// once everything else that finished has been handed out, only the first one per call.
+		bool update(AmasRegistry& registry, SceneBvh& sceneBvh);
+
+		// assets requested but not yet handed out by update
+		uint32_t getPendingCount() const { return pendingCount; }
+		const std::shared_ptr<AmasModel>& getPlaceholderModel() const { return placeholderModel; }
+		const std::shared_ptr<AmasTexture>& getPlaceholderTexture() const { return placeholderTexture; }
+
+	private:
+		template <typename T>
+		struct Assignment {
+			Entity entity;
+			AmasAssetHandle<T> asset;
+		};
+
+		// runs decode on a worker and queues finish, which update then runs on the main thread
+		void decodeAsync(std::function<std::function<void()>()> decode);
+
+		AmasDevice& amasDevice;
+		AmasJobSystem& jobSystem;
+
+		std::shared_ptr<AmasModel> placeholderModel;
+		std::shared_ptr<AmasTexture> placeholderTexture;
+
+		AmasJobCounter decodeJobs;
+		std::mutex decodedMutex;
+		std::vector<std::function<void()>> decoded;
+		uint32_t pendingCount = 0;
+
+		std::vector<Assignment<AmasModel>> modelAssignments;
+		std::vector<Assignment<AmasTexture>> textureAssignments;
+	};
+
+}  // namespace amas
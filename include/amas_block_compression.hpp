@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+// std
+#include <cstdint>
+
+namespace amas {
+
+	// Texel block formats textures are loaded in, and a cpu decoder for the BC ones so a texture
+	// still loads on a device that cannot sample them.
+	class AmasBlockCompression {
+	public:
+		struct FormatInfo {
+			uint32_t blockWidth = 1;
+			uint32_t blockHeight = 1;
+			uint32_t blockSize = 4;  // bytes
+		};
+
+		// false for formats textures are not loaded in
+		static bool getFormatInfo(VkFormat format, FormatInfo& info);
+		// bytes of a width x height level
+		static uint64_t levelSize(const FormatInfo& info, uint32_t width, uint32_t height);
+
+		// BC1, BC3 and BC7, the formats decompress handles
+		static bool canDecompress(VkFormat format);
+		// RGBA8 format, sRGB when format is, decompressed levels are uploaded in
+		static VkFormat decompressedFormat(VkFormat format);
+		// Writes the width x height RGBA8 texels of a level stored in format, rows tightly packed.
+		static void decompress(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba);
+	};
+
+}  // namespace amas
@@ -18,7 +18,7 @@ namespace amas {
 		AmasBuffer(const AmasBuffer&) = delete;
 		AmasBuffer& operator=(const AmasBuffer&) = delete;
 
-		VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		VkResult map(VkDeviceSize offset = 0);
 		void unmap();
 
 		void writeToBuffer(void* data, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
@@ -31,7 +31,8 @@ namespace amas {
 		VkDescriptorBufferInfo descriptorInfoForIndex(int index);
 		VkResult invalidateIndex(int index);
 
-		VkDeviceMemory getMemory() const { return memory; } // mine
+		VkDeviceMemory getMemory() const { return allocation->memory; } // mine
+		VkDeviceSize getMemoryOffset() const { return allocation->offset; }
 
 		VkBuffer getBuffer() const { return buffer; }
 		void* getMappedMemory() const { return mapped; }
@@ -48,7 +49,7 @@ namespace amas {
 		AmasDevice& amasDevice;
 		void* mapped = nullptr;
 		VkBuffer buffer = VK_NULL_HANDLE;
-		VkDeviceMemory memory = VK_NULL_HANDLE;
+		AmasAllocation* allocation = nullptr;
 
 		VkDeviceSize bufferSize;
 		uint32_t instanceCount;
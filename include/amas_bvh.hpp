@@ -0,0 +1,88 @@
+#pragma once
+
+#include "amas_frustum.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace amas {
+
+	// Dynamic AABB tree over scene objects. Leaves hold a tight box for queries and a fattened
+	// box for the tree itself, so small movements refit nothing and only objects leaving their
+	// fat box are reinserted. Inner nodes are kept balanced with tree rotations.
+	class AmasBvh {
+	public:
+		using ProxyId = int32_t;
+		static constexpr ProxyId NULL_PROXY = -1;
+
+		// leaf boxes are grown by this much on every side
+		static constexpr float FAT_MARGIN = .1f;
+
+		struct Box {
+			glm::vec3 min{};
+			glm::vec3 max{};
+
+			bool contains(const Box& other) const;
+			bool overlaps(const Box& other) const;
+			float surfaceArea() const;
+			static Box merge(const Box& a, const Box& b);
+		};
+
+		struct RayHit {
+			uint32_t objectId = 0;
+			float distance = 0.f;
+		};
+
+		AmasBvh() = default;
+
+		AmasBvh(const AmasBvh&) = delete;
+		AmasBvh& operator=(const AmasBvh&) = delete;
+
+		ProxyId insert(const Box& box, uint32_t objectId);
+		void remove(ProxyId proxy);
+		// Updates the bounds after the object moved, returns true when the leaf had to be reinserted.
+		bool move(ProxyId proxy, const Box& box);
+
+		// Appends the object ids whose tight boxes pass the query to result.
+		void queryFrustum(const AmasFrustum& frustum, std::vector<uint32_t>& result) const;
+		void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const;
+		void queryBox(const Box& box, std::vector<uint32_t>& result) const;
+		// Closest object whose tight box the ray enters within maxDistance, direction need not be normalized.
+		bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const;
+
+		uint32_t getProxyCount() const { return proxyCount; }
+		int getHeight() const { return root == NULL_PROXY ? 0 : nodes[root].height; }
+		uint32_t getObjectId(ProxyId proxy) const { return nodes[proxy].objectId; }
+
+	private:
+		struct Node {
+			Box box;        // fat box for leaves, union of the children otherwise
+			Box tightBox;   // leaves only
+			ProxyId parent = NULL_PROXY;  // doubles as the free list link
+			ProxyId left = NULL_PROXY;
+			ProxyId right = NULL_PROXY;
+			int height = -1;  // 0 for leaves, -1 for free nodes
+			uint32_t objectId = 0;
+
+			bool isLeaf() const { return left == NULL_PROXY; }
+		};
+
+		ProxyId allocateNode();
+		void freeNode(ProxyId node);
+		void insertLeaf(ProxyId leaf);
+		void removeLeaf(ProxyId leaf);
+		void refitAncestors(ProxyId node);
+		ProxyId balance(ProxyId node);
+		void collectLeaves(ProxyId node, std::vector<uint32_t>& result) const;
+
+		std::vector<Node> nodes;
+		ProxyId root = NULL_PROXY;
+		ProxyId freeList = NULL_PROXY;
+		uint32_t proxyCount = 0;
+
+		// traversal stack reused by the queries
+		mutable std::vector<ProxyId> queryStack;
+	};
+
+}  // namespace amas
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "amas_frustum.hpp"
+
 // libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -23,6 +25,7 @@ namespace amas {
 		const glm::mat4& getView() const { return viewMatrix; }
 		const glm::mat4& getInverseView() const { return inverseViewMatrix; }
 		const glm::vec3 getPosition() const { return glm::vec3(inverseViewMatrix[3]); }
+		AmasFrustum getFrustum() const { return AmasFrustum::fromMatrix(projectionMatrix * viewMatrix); }
 
 	private:
 		glm::mat4 projectionMatrix{ 1.f };
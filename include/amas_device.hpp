@@ -1,13 +1,18 @@
 #pragma once
 
+#include "amas_allocator.hpp"
 #include "amas_window.hpp"
 
 // std lib headers
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace amas {
 
+	class AmasGeometryPool;
+	class AmasUploader;
+
 	struct SwapChainSupportDetails {
 		VkSurfaceCapabilitiesKHR capabilities;
 		std::vector<VkSurfaceFormatKHR> formats;
@@ -17,8 +22,11 @@ namespace amas {
 	struct QueueFamilyIndices {
 		uint32_t graphicsFamily;
 		uint32_t presentFamily;
+		uint32_t transferFamily;
 		bool graphicsFamilyHasValue = false;
 		bool presentFamilyHasValue = false;
+		// only set for a family without graphics support, uploads use the graphics family otherwise
+		bool transferFamilyHasValue = false;
 		bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 	};
 
@@ -45,6 +53,10 @@ namespace amas {
 		VkSurfaceKHR surface() { return surface_; }
 		VkQueue graphicsQueue() { return graphicsQueue_; }
 		VkQueue presentQueue() { return presentQueue_; }
+		VkQueue transferQueue() { return transferQueue_; }
+		AmasAllocator& getAllocator() { return *allocator; }
+		AmasUploader& getUploader() { return *uploader; }
+		AmasGeometryPool& getGeometryPool() { return *geometryPool; }
 
 		SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -58,21 +70,44 @@ namespace amas {
 			VkBufferUsageFlags usage,
 			VkMemoryPropertyFlags properties,
 			VkBuffer& buffer,
-			VkDeviceMemory& bufferMemory);
+			AmasAllocation*& bufferAllocation,
+			void* owner = nullptr);
 		VkCommandBuffer beginSingleTimeCommands();
 		void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+		void copyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 		void copyBufferToImage(
 			VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
+		void copyBufferToImage(
+			VkCommandBuffer commandBuffer,
+			VkBuffer buffer,
+			VkImage image,
+			uint32_t width,
+			uint32_t height,
+			uint32_t layerCount,
+			VkDeviceSize bufferOffset = 0);
 
 		void createImageWithInfo(
 			const VkImageCreateInfo& imageInfo,
 			VkMemoryPropertyFlags properties,
 			VkImage& image,
-			VkDeviceMemory& imageMemory);
+			AmasAllocation*& imageAllocation,
+			void* owner = nullptr);
 
 		VkPhysicalDeviceProperties properties;
 
+		// optional features, enabled in createLogicalDevice when the physical device has them
+		struct OptionalFeatures {
+			bool multiDrawIndirect = false;
+			bool drawIndirectFirstInstance = false;
+			bool drawIndirectCount = false;
+			bool textureCompressionBC = false;
+			bool textureCompressionASTC_LDR = false;
+		} optionalFeatures;
+
+		// loaded from VK_KHR_draw_indirect_count, null when optionalFeatures.drawIndirectCount is false
+		PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+
 	private:
 		void createInstance();
 		void setupDebugMessenger();
@@ -80,6 +115,9 @@ namespace amas {
 		void pickPhysicalDevice();
 		void createLogicalDevice();
 		void createCommandPool();
+		void createAllocator();
+		void createUploader();
+		void createGeometryPool();
 
 		// helper functions
 		bool isDeviceSuitable(VkPhysicalDevice device);
@@ -89,6 +127,7 @@ namespace amas {
 		void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
 		void hasGflwRequiredInstanceExtensions();
 		bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+		bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName);
 		SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
 		VkInstance instance;
@@ -96,11 +135,15 @@ namespace amas {
 		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 		AmasWindow& window;
 		VkCommandPool commandPool;
+		std::unique_ptr<AmasAllocator> allocator;
+		std::unique_ptr<AmasUploader> uploader;
+		std::unique_ptr<AmasGeometryPool> geometryPool;
 
 		VkDevice device_;
 		VkSurfaceKHR surface_;
 		VkQueue graphicsQueue_;
 		VkQueue presentQueue_;
+		VkQueue transferQueue_;
 
 		const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
 		const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
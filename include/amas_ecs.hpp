@@ -0,0 +1,185 @@
+#pragma once
+
+// std
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace amas {
+
+	// Handle to an entity. Destroyed slots are recycled with a bumped generation, so stale
+	// handles can be told apart from the entity that reuses their index.
+	struct Entity {
+		static constexpr uint32_t NULL_INDEX = std::numeric_limits<uint32_t>::max();
+
+		uint32_t index = NULL_INDEX;
+		uint32_t generation = 0;
+
+		bool operator==(const Entity& other) const = default;
+	};
+
+	class AmasComponentPoolBase {
+	public:
+		static constexpr uint32_t NULL_SLOT = std::numeric_limits<uint32_t>::max();
+
+		virtual ~AmasComponentPoolBase() = default;
+
+		virtual void remove(uint32_t entityIndex) = 0;
+
+		bool contains(uint32_t entityIndex) const {
+			return entityIndex < sparse.size() && sparse[entityIndex] != NULL_SLOT;
+		}
+		uint32_t size() const { return static_cast<uint32_t>(packedEntities.size()); }
+		// entity index of every packed component, in storage order
+		const std::vector<uint32_t>& getEntities() const { return packedEntities; }
+
+	protected:
+		std::vector<uint32_t> sparse;          // entity index -> packed slot
+		std::vector<uint32_t> packedEntities;  // packed slot -> entity index
+	};
+
+	// Sparse set: components of one type are packed back to back, removal swaps the last one into
+	// the hole. References into the pool are invalidated when a component of the same type is added.
+	template <typename T>
+	class AmasComponentPool : public AmasComponentPoolBase {
+	public:
+		template <typename... Args>
+		T& emplace(uint32_t entityIndex, Args&&... args) {
+			assert(!contains(entityIndex) && "Entity already has this component");
+			if (entityIndex >= sparse.size()) {
+				sparse.resize(entityIndex + 1, NULL_SLOT);
+			}
+			sparse[entityIndex] = size();
+			packedEntities.push_back(entityIndex);
+			components.push_back(T{ std::forward<Args>(args)... });
+			return components.back();
+		}
+
+		void remove(uint32_t entityIndex) override {
+			if (!contains(entityIndex)) return;
+
+			uint32_t slot = sparse[entityIndex];
+			uint32_t last = size() - 1;
+			if (slot != last) {
+				components[slot] = std::move(components[last]);
+				packedEntities[slot] = packedEntities[last];
+				sparse[packedEntities[slot]] = slot;
+			}
+			components.pop_back();
+			packedEntities.pop_back();
+			sparse[entityIndex] = NULL_SLOT;
+		}
+
+		T& get(uint32_t entityIndex) {
+			assert(contains(entityIndex) && "Entity does not have this component");
+			return components[sparse[entityIndex]];
+		}
+		T* tryGet(uint32_t entityIndex) { return contains(entityIndex) ? &components[sparse[entityIndex]] : nullptr; }
+
+		std::vector<T>& getComponents() { return components; }
+
+	private:
+		std::vector<T> components;
+	};
+
+	class AmasRegistry {
+	public:
+		AmasRegistry() = default;
+
+		AmasRegistry(const AmasRegistry&) = delete;
+		AmasRegistry& operator=(const AmasRegistry&) = delete;
+
+		Entity create();
+		void destroy(Entity entity);
+		bool isAlive(Entity entity) const {
+			return entity.index < generations.size() && generations[entity.index] == entity.generation;
+		}
+		// handle of the live entity currently using this index
+		Entity entityAt(uint32_t index) const { return { index, generations[index] }; }
+		uint32_t getEntityCount() const { return static_cast<uint32_t>(generations.size() - freeIndices.size()); }
+		// one past the highest entity index handed out so far
+		uint32_t getEntityCapacity() const { return static_cast<uint32_t>(generations.size()); }
+
+		template <typename T, typename... Args>
+		T& add(Entity entity, Args&&... args) {
+			assert(isAlive(entity) && "Entity has been destroyed");
+			return pool<T>().emplace(entity.index, std::forward<Args>(args)...);
+		}
+
+		template <typename T>
+		void remove(Entity entity) {
+			assert(isAlive(entity) && "Entity has been destroyed");
+			pool<T>().remove(entity.index);
+		}
+
+		template <typename T>
+		bool has(Entity entity) const {
+			auto* componentPool = findPool<T>();
+			return componentPool != nullptr && componentPool->contains(entity.index);
+		}
+
+		template <typename T>
+		T& get(Entity entity) {
+			assert(isAlive(entity) && "Entity has been destroyed");
+			return pool<T>().get(entity.index);
+		}
+
+		template <typename T>
+		T* tryGet(Entity entity) {
+			return isAlive(entity) ? pool<T>().tryGet(entity.index) : nullptr;
+		}
+
+		template <typename T>
+		AmasComponentPool<T>& pool() {
+			size_t type = componentType<T>();
+			if (type >= pools.size()) {
+				pools.resize(type + 1);
+			}
+			if (!pools[type]) {
+				pools[type] = std::make_unique<AmasComponentPool<T>>();
+			}
+			return static_cast<AmasComponentPool<T>&>(*pools[type]);
+		}
+
+		// Calls fn(entity, first&, rest&...) for every entity owning all listed components. The
+		// packed array of First is walked in order, so list the rarest component first.
+		template <typename First, typename... Rest, typename Fn>
+		void each(Fn&& fn) {
+			auto& primary = pool<First>();
+			auto visit = [&](AmasComponentPool<Rest>&... others) {
+				const auto& entities = primary.getEntities();
+				auto& components = primary.getComponents();
+				for (uint32_t slot = 0; slot < entities.size(); slot++) {
+					uint32_t index = entities[slot];
+					if ((others.contains(index) && ...)) {
+						fn(entityAt(index), components[slot], others.get(index)...);
+					}
+				}
+			};
+			visit(pool<Rest>()...);
+		}
+
+	private:
+		template <typename T>
+		static size_t componentType() {
+			static const size_t type = nextComponentType++;
+			return type;
+		}
+
+		template <typename T>
+		const AmasComponentPool<T>* findPool() const {
+			size_t type = componentType<T>();
+			return type < pools.size() ? static_cast<const AmasComponentPool<T>*>(pools[type].get()) : nullptr;
+		}
+
+		static inline size_t nextComponentType = 0;
+
+		std::vector<std::unique_ptr<AmasComponentPoolBase>> pools;
+		std::vector<uint32_t> generations;
+		std::vector<uint32_t> freeIndices;
+	};
+
+}  // namespace amas
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "amas_mapped_file.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace amas {
+
+	// Read-only contents of a file opened through AmasFileSystem: a view into a mapped pack or loose
+	// file, or the decompressed copy of a compressed pack entry. The data is aligned for any scalar.
+	class AmasFile {
+	public:
+		AmasFile() = default;
+
+		AmasFile(const AmasFile&) = delete;
+		AmasFile& operator=(const AmasFile&) = delete;
+		AmasFile(AmasFile&&) = default;
+		AmasFile& operator=(AmasFile&&) = default;
+
+		// see AmasMappedFile, no-ops on a decompressed copy
+		void prefetch(size_t offset, size_t size) const;
+		void release(size_t offset, size_t size) const;
+
+		const uint8_t* data() const { return mapping ? mapping->data() + offset : decompressed.data(); }
+		size_t size() const { return fileSize; }
+
+	private:
+		friend class AmasFileSystem;
+
+		std::shared_ptr<const AmasMappedFile> mapping{};
+		size_t offset = 0;
+		size_t fileSize = 0;
+		std::vector<uint8_t> decompressed{};
+	};
+
+	// Where the engine opens its content by relative path ("objs/Cube.obj"). Mounted packs are
+	// searched first, the latest mounted one winning, then the working directory, so a packed build
+	// opens everything from a single mapping and a development tree keeps working from loose files.
+	// Safe to use from any thread, mounting included.
+	class AmasFileSystem {
+	public:
+		// false when there is no file at packPath, throws when it is not a valid pack
+		static bool mount(const std::string& packPath);
+		static void unmountAll();
+
+		// Size and modification time of the file, those recorded for it when it comes from a pack.
+		// False when there is no such file.
+		static bool status(const std::string& path, uint64_t& size, int64_t& time);
+		static bool open(const std::string& path, AmasFile& file, AmasMappedFile::Access access = AmasMappedFile::Access::SEQUENTIAL);
+		// throws when there is no such file
+		static AmasFile open(const std::string& path, AmasMappedFile::Access access = AmasMappedFile::Access::SEQUENTIAL);
+	};
+
+}  // namespace amas
@@ -2,6 +2,9 @@
 
 #include "amas_camera.hpp"
 #include "amas_game_object.hpp"
+#include "amas_hierarchy.hpp"
+#include "amas_job_system.hpp"
+#include "amas_renderer.hpp"
 
 // lib
 #include <vulkan/vulkan.h>
@@ -30,7 +33,11 @@ namespace amas {
 		VkCommandBuffer commandBuffer;
 		AmasCamera& camera;
 		VkDescriptorSet globalDescriptorSet;
-		AmasGameObject::Map& gameObjects;
+		AmasRegistry& registry;
+		SceneBvh& sceneBvh;
+		AmasHierarchy& hierarchy;
+		AmasRenderer& renderer;
+		AmasJobSystem& jobSystem;
 	};
 
 } // namespace amas
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace amas {
+
+	// Clip planes of a view projection with [0, 1] depth. Normals point inwards and are
+	// normalized, so the plane equation gives the signed distance to a point.
+	struct AmasFrustum {
+		enum Plane { PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+
+		std::array<glm::vec4, PLANE_COUNT> planes{};
+
+		static AmasFrustum fromMatrix(const glm::mat4& viewProjection);
+
+		bool intersectsSphere(const glm::vec3& center, float radius) const;
+		bool intersectsBox(const glm::vec3& min, const glm::vec3& max) const;
+		bool containsBox(const glm::vec3& min, const glm::vec3& max) const;
+	};
+
+	// World-space bounding spheres kept as one array per component, so the frustum test walks
+	// contiguous floats and the compiler can vectorize it.
+	class AmasSphereBatch {
+	public:
+		void clear();
+		void reserve(size_t count);
+		void add(const glm::vec3& center, float radius);
+		size_t size() const { return radii.size(); }
+
+		// Writes 1 for every sphere touching the frustum and 0 for the rest, returns the visible count.
+		uint32_t cull(const AmasFrustum& frustum, std::vector<uint8_t>& visible) const;
+
+	private:
+		std::vector<float> centerX;
+		std::vector<float> centerY;
+		std::vector<float> centerZ;
+		std::vector<float> radii;
+	};
+
+}  // namespace amas
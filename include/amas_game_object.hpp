@@ -1,36 +1,88 @@
 #pragma once
 
+#include "amas_bvh.hpp"
+#include "amas_ecs.hpp"
 #include "amas_model.hpp"
 #include "amas_descriptors.hpp"
 #include "amas_texture.hpp"
+#include "amas_transform_batch.hpp"
 
 // libs
 #include <glm/gtc/matrix_transform.hpp>
 
 // std
 #include <memory>
-#include <unordered_map>
 
 namespace amas {
 	struct ComponentUbo {
 		int currentGameObjectID;
 	};
 
-	struct TransformComponent {
-		glm::vec3 translation{};
-		glm::vec3 scale{ 1.f, 1.f, 1.f };
-		glm::vec3 rotation{};
+	// Keeps its local, world and normal matrices cached. Setters only mark them dirty, the matrices
+	// are rebuilt once by update() (or on first access) and the version counts every change of the
+	// world matrix, so anything derived from the transform can tell whether it is stale.
+	// The world matrix of a parented transform is written by AmasHierarchy::propagate.
+	class TransformComponent {
+	public:
+		// local values, relative to the parent when there is one
+		const glm::vec3& getTranslation() const { return translation; }
+		const glm::vec3& getScale() const { return scale; }
+		const glm::vec3& getRotation() const { return rotation; }
+
+		void setTranslation(const glm::vec3& value) { translation = value; dirty = true; }
+		void setScale(const glm::vec3& value) { scale = value; dirty = true; }
+		void setRotation(const glm::vec3& value) { rotation = value; dirty = true; }
+		void translate(const glm::vec3& offset) { setTranslation(translation + offset); }
+		void rotate(const glm::vec3& angles) { setRotation(rotation + angles); }
 
 		// Matrix corrsponds to Translate * Ry * Rx * Rz * Scale
 		// Rotations correspond to Tait-bryan angles of Y(1), X(2), Z(3)
 		// https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
-		glm::mat4 mat4();
+		const glm::mat4& localMatrix() { update(); return local; }
+
+		// world space
+		const glm::mat4& mat4() { update(); return world; }
+		const glm::mat3& normalMatrix() { update(); return worldNormal; }
+		glm::vec3 getWorldTranslation() { return glm::vec3(mat4()[3]); }
+
+		void update() {
+			if (dirty) rebuildMatrices();
+		}
+		bool isDirty() const { return dirty; }
+		bool hasParent() const { return parented; }
+		uint32_t getVersion() const { return version; }
 
-		glm::mat3 normalMatrix();
+	private:
+		friend class AmasHierarchy;
+		friend class TransformSystem;
+
+		void rebuildMatrices();
+		// takes matrices composed elsewhere from the current translation, rotation and scale
+		void setLocalMatrices(const glm::mat4& model, const glm::mat3& normal);
+		void localChanged();
+		void updateWorld(const glm::mat4& parentMatrix, const glm::mat3& parentNormal);
+
+		glm::vec3 translation{};
+		glm::vec3 scale{ 1.f, 1.f, 1.f };
+		glm::vec3 rotation{};
+
+		glm::mat4 local{ 1.f };
+		glm::mat3 localNormal{ 1.f };
+		glm::mat4 world{ 1.f };
+		glm::mat3 worldNormal{ 1.f };
+		bool dirty = true;
+		bool parented = false;
+		bool worldDirty = false;  // parented only, the local matrix changed since the last propagation
+		uint32_t version = 0;
+	};
+
+	struct ModelComponent {
+		std::shared_ptr<AmasModel> model;
 	};
 
 	struct PointLightComponent {
 		float lightIntensity = 1.0f;
+		glm::vec3 color{ 1.f };
 	};
 
 	struct MaterialComponent {
@@ -38,48 +90,42 @@ namespace amas {
 		VkDescriptorImageInfo info{};
 	};
 
+	// leaf of the entity in its SceneBvh tree
+	struct BvhProxyComponent {
+		AmasBvh::ProxyId proxy = AmasBvh::NULL_PROXY;
+		uint32_t transformVersion = 0;  // transform the leaf was last fitted to
+	};
+
+	// Game objects are entities of an AmasRegistry, these helpers put together the usual
+	// component combinations.
 	class AmasGameObject {
 	public:
-		using id_t = unsigned int;
-		using Map = std::unordered_map<id_t, AmasGameObject>;
-
-		static AmasGameObject createGameObject() {
-			static id_t currentId = 0;
-			return AmasGameObject{ currentId++ };
-		}
-
-		void attachMaterial(std::shared_ptr<AmasTexture> AmasTexture);
-		static void setDevice(AmasDevice& device_);
-		static AmasGameObject makePointLight(float intensity = 10.0f, float radius = 0.1f, glm::vec3 color = glm::vec3(1.f));
-
-		AmasGameObject(const AmasGameObject&) = delete;
-		AmasGameObject& operator=(const AmasGameObject&) = delete;
-		AmasGameObject(AmasGameObject&&) = default;
-		AmasGameObject& operator=(AmasGameObject&&) = default;
-
-		id_t getId() { return id; }
-
-		glm::vec3 color{};
-		TransformComponent transform{};
-
-		static AmasDevice* device;
-
-		// Optional pointer components
-		std::shared_ptr<AmasModel> model{};
-		std::unique_ptr<PointLightComponent> pointLight = nullptr;
-		std::unique_ptr<MaterialComponent> material = nullptr;
+		// entity index, stays the same for the lifetime of the entity
+		using id_t = uint32_t;
+
+		// every game object has a transform
+		static Entity createGameObject(AmasRegistry& registry);
+		static Entity makePointLight(
+			AmasRegistry& registry, float intensity = 10.0f, float radius = 0.1f, glm::vec3 color = glm::vec3(1.f));
+		// replaces the texture when the entity already has a material
+		static void attachMaterial(AmasRegistry& registry, Entity entity, std::shared_ptr<AmasTexture> AmasTexture);
+
+		// world-space box of the model, or of the light's billboard for point lights
+		static AmasBvh::Box worldBounds(AmasRegistry& registry, Entity entity);
+	};
 
-		//descriptors stuff
-		//static VkDescriptorSetLayout& currentSetLayout;
+	// Spatial index over the scene. Models and point lights live in separate trees so every
+	// system only walks the objects it cares about.
+	struct SceneBvh {
+		AmasBvh models;
+		AmasBvh lights;
 
-		ComponentUbo gameObjectUBO{};
+		void insert(AmasRegistry& registry, Entity entity);
+		void remove(AmasRegistry& registry, Entity entity);
+		// refits the entity's leaf, call after changing its transform
+		void update(AmasRegistry& registry, Entity entity);
 
 	private:
-
-		AmasGameObject(id_t objId) : id{ objId } {
-			gameObjectUBO.currentGameObjectID = objId;
-		}
-
-		id_t id;
+		AmasBvh* treeFor(AmasRegistry& registry, Entity entity);
 	};
-}  // namespace amas
+}  // namespace amas
\ No newline at end of file
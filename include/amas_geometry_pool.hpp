@@ -0,0 +1,89 @@
+#pragma once
+
+#include "amas_buffer.hpp"
+#include "amas_uploader.hpp"
+
+// std
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace amas {
+
+	// Sub-allocates the vertex and index data of every mesh out of a few large device-local
+	// buffers, so meshes sharing a page can be drawn back to back without rebinding and
+	// gathered into a single indirect draw.
+	class AmasGeometryPool {
+	public:
+		// bytes of a page's vertex and of its index buffer, a quarter of an allocator block so pages
+		// share blocks instead of each taking a dedicated one
+		static constexpr VkDeviceSize PAGE_SIZE = AmasAllocator::DEFAULT_BLOCK_SIZE / 4;
+
+		struct Mesh {
+			uint32_t page = 0;
+			int32_t vertexOffset = 0;
+			uint32_t vertexCount = 0;
+			uint32_t firstIndex = 0;
+			uint32_t indexCount = 0;
+		};
+
+		AmasGeometryPool(AmasDevice& device);
+
+		AmasGeometryPool(const AmasGeometryPool&) = delete;
+		AmasGeometryPool& operator=(const AmasGeometryPool&) = delete;
+
+		// Uploads the mesh into a page holding vertices of the same stride, writeVertices fills the
+		// vertexCount * vertexStride bytes of staging memory in place. Meshes without indices get
+		// a sequential index list so every mesh can be drawn indexed.
+		Mesh allocate(
+			uint32_t vertexCount,
+			uint32_t vertexStride,
+			const std::function<void(void* staging)>& writeVertices,
+			std::span<const uint32_t> indices,
+			AmasUploader::Ticket& uploadTicket);
+		// The ranges are only reused once every frame in flight that could still draw the mesh
+		// has retired, see beginFrame.
+		void free(const Mesh& mesh);
+		// Called once the fence of the oldest frame in flight has been waited on, releases the
+		// meshes freed before that frame was recorded.
+		void beginFrame();
+
+		void bind(VkCommandBuffer commandBuffer, uint32_t page);
+
+		uint32_t getPageCount() const { return static_cast<uint32_t>(pages.size()); }
+
+	private:
+		// first-fit list of free element ranges, keyed by offset so neighbours merge on release
+		struct RangeList {
+			std::map<uint32_t, uint32_t> freeRanges;
+
+			bool allocate(uint32_t count, uint32_t& offset);
+			void release(uint32_t offset, uint32_t count);
+		};
+
+		struct Page {
+			uint32_t vertexStride;
+			std::unique_ptr<AmasBuffer> vertexBuffer;
+			std::unique_ptr<AmasBuffer> indexBuffer;
+			RangeList vertices;
+			RangeList indices;
+		};
+
+		struct PendingFree {
+			Mesh mesh;
+			uint64_t frame;  // last frame that may reference the mesh
+		};
+
+		Page& createPage(uint32_t vertexStride, uint32_t minVertexCount, uint32_t minIndexCount);
+		void release(const Mesh& mesh);
+
+		AmasDevice& amasDevice;
+		std::vector<std::unique_ptr<Page>> pages;
+		std::deque<PendingFree> pendingFrees;
+		uint64_t frameCount = 0;
+	};
+
+}  // namespace amas
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "amas_ecs.hpp"
+#include "amas_game_object.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace amas {
+
+	// the entity this one is attached to, its transform is relative to the parent's
+	struct ParentComponent {
+		Entity parent;
+	};
+
+	// Parent/child links between transforms. Every entity taking part in a hierarchy is kept in a
+	// flat array sorted by depth, so parents always come before their children and propagating
+	// world matrices is one linear pass. Only subtrees below a changed transform are recomputed.
+	class AmasHierarchy {
+	public:
+		AmasHierarchy() = default;
+
+		AmasHierarchy(const AmasHierarchy&) = delete;
+		AmasHierarchy& operator=(const AmasHierarchy&) = delete;
+
+		// A null parent detaches the entity, it then keeps its local transform as world transform.
+		void setParent(AmasRegistry& registry, Entity child, Entity parent);
+		Entity getParent(AmasRegistry& registry, Entity entity);
+
+		// Brings the world matrices of all parented transforms up to date.
+		void propagate(AmasRegistry& registry);
+
+		uint32_t getNodeCount() const { return static_cast<uint32_t>(nodes.size()); }
+		// world matrices recomputed by the last propagate
+		uint32_t getUpdatedCount() const { return updatedCount; }
+
+	private:
+		static constexpr uint32_t NO_PARENT = ~0u;
+
+		struct Node {
+			uint32_t entityIndex;
+			uint32_t parentSlot;      // slot of the parent in nodes, NO_PARENT for roots
+			uint32_t worldVersion;    // roots only, transform version seen by the last pass
+		};
+
+		bool isAncestor(AmasRegistry& registry, Entity ancestor, Entity entity);
+		void rebuild(AmasRegistry& registry);
+
+		std::vector<Node> nodes;
+		std::vector<uint8_t> changed;
+		bool structureDirty = false;
+		uint32_t updatedCount = 0;
+
+		// scratch space of rebuild, indexed by entity index
+		std::vector<uint32_t> depths;
+		std::vector<uint32_t> slots;
+	};
+
+}  // namespace amas
@@ -0,0 +1,100 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace amas {
+
+	// Number of unfinished jobs submitted against it. A job that has to wait for others waits on
+	// their counter, the waiting thread runs queued jobs in the meantime.
+	class AmasJobCounter {
+	public:
+		AmasJobCounter() = default;
+
+		AmasJobCounter(const AmasJobCounter&) = delete;
+		AmasJobCounter& operator=(const AmasJobCounter&) = delete;
+
+		bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class AmasJobSystem;
+
+		std::atomic<uint32_t> pending{ 0 };
+		// first exception thrown by one of the jobs, rethrown by AmasJobSystem::wait
+		std::mutex errorMutex;
+		std::exception_ptr error;
+	};
+
+	// Work-stealing scheduler. Every worker and the main thread own a deque, jobs submitted from
+	// a thread go to its own deque and are taken back newest first, idle threads steal the oldest
+	// jobs of the others. The main thread only runs jobs while it waits. Background jobs sit in a
+	// queue of their own that only idle workers take from, jobs submitted while one of them runs
+	// are background jobs as well.
+	class AmasJobSystem {
+	public:
+		using Job = std::function<void()>;
+		using RangeJob = std::function<void(uint32_t first, uint32_t last)>;
+
+		// workerCount 0 uses one worker per hardware thread besides the main thread
+		explicit AmasJobSystem(uint32_t workerCount = 0);
+		~AmasJobSystem();
+
+		AmasJobSystem(const AmasJobSystem&) = delete;
+		AmasJobSystem& operator=(const AmasJobSystem&) = delete;
+
+		// counter, when given, must outlive the job
+		void submit(Job job, AmasJobCounter* counter = nullptr);
+		// For long running work like decoding assets: run oldest first by idle workers only, never by
+		// a thread that waits, so it cannot end up inside a frame's wait.
+		void submitBackground(Job job, AmasJobCounter* counter = nullptr);
+		// Runs queued jobs on the calling thread until every job of the counter has finished.
+		// Background jobs are left to the workers, unless the caller is a background job itself.
+		void wait(AmasJobCounter& counter);
+
+		// Calls fn over [0, count) in ranges of at least grainSize items and returns when all of
+		// them are done, the calling thread takes part.
+		void parallelFor(uint32_t count, uint32_t grainSize, const RangeJob& fn);
+
+		// threads running jobs, the main thread included
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(queues.size()); }
+
+	private:
+		struct JobEntry {
+			Job job;
+			AmasJobCounter* counter;
+			bool background;
+		};
+
+		struct alignas(64) JobQueue {
+			std::mutex mutex;
+			std::deque<JobEntry> jobs;
+		};
+
+		void workerLoop(uint32_t queueIndex);
+		bool runOne(uint32_t queueIndex, bool background);
+		void push(JobQueue& queue, Job job, AmasJobCounter* counter, bool background);
+		bool popLocal(uint32_t queueIndex, bool allowBackground, JobEntry& entry);
+		bool steal(uint32_t queueIndex, bool allowBackground, JobEntry& entry);
+		uint32_t currentQueue() const;
+
+		std::vector<std::unique_ptr<JobQueue>> queues;  // queue 0 belongs to the thread that created the system
+		JobQueue backgroundQueue;
+		std::vector<std::thread> workers;
+
+		// sleeping workers are woken through this once jobs are queued
+		std::mutex sleepMutex;
+		std::condition_variable wakeCondition;
+		std::atomic<uint32_t> queuedCount{ 0 };
+		bool stopping = false;
+	};
+
+}  // namespace amas
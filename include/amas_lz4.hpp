@@ -0,0 +1,22 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace amas {
+
+	// Codec for the LZ4 block format, the payload of compressed pack entries. Greedy and single
+	// pass, it trades ratio for decoding at memory speed.
+	class AmasLz4 {
+	public:
+		// largest size compress can produce for size bytes
+		static size_t compressBound(size_t size) { return size + size / 255 + 16; }
+
+		static std::vector<uint8_t> compress(const uint8_t* source, size_t size);
+		// false when source is not a block decoding to exactly size bytes
+		static bool decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t size);
+	};
+
+}  // namespace amas
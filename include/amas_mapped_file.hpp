@@ -0,0 +1,55 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace amas {
+
+	// A whole file mapped read-only into memory, so loaders parse straight from the page cache and
+	// copy into staging memory without reading into a heap buffer first. The access pattern is
+	// passed on to the OS so it reads ahead or not.
+	class AmasMappedFile {
+	public:
+		enum class Access {
+			SEQUENTIAL,  // read once front to back, aggressive read-ahead
+			RANDOM,      // scattered reads, no read-ahead
+			NORMAL,      // the OS default, some read-ahead around each access
+		};
+
+		AmasMappedFile() = default;
+		// throws when the file cannot be opened or mapped
+		explicit AmasMappedFile(const std::string& filepath, Access access = Access::SEQUENTIAL);
+		~AmasMappedFile();
+
+		AmasMappedFile(const AmasMappedFile&) = delete;
+		AmasMappedFile& operator=(const AmasMappedFile&) = delete;
+		AmasMappedFile(AmasMappedFile&& other) noexcept;
+		AmasMappedFile& operator=(AmasMappedFile&& other) noexcept;
+
+		// false when the file cannot be opened or mapped, an empty file opens with no data
+		bool open(const std::string& filepath, Access access = Access::SEQUENTIAL);
+		void close();
+
+		// Starts reading the pages of the range in the background.
+		void prefetch(size_t offset, size_t size) const;
+		// The range will not be read again, its pages can leave the working set. They stay in the
+		// page cache and are read back if touched.
+		void release(size_t offset, size_t size) const;
+
+		bool isOpen() const { return opened; }
+		const uint8_t* data() const { return mapping; }
+		size_t size() const { return fileSize; }
+
+	private:
+		const uint8_t* mapping = nullptr;
+		size_t fileSize = 0;
+		bool opened = false;
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#endif
+	};
+
+}  // namespace amas
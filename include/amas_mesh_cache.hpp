@@ -0,0 +1,30 @@
+#pragma once
+
+#include "amas_model.hpp"
+
+// std
+#include <cstdint>
+#include <string>
+
+namespace amas {
+
+	// Engine side copy of an imported mesh: a header, the vertex layout it was written with, the
+	// level of detail and meshlet tables, the vertex and index blobs and the bounds. It is keyed by the size and modification time of the
+	// source file, a cache whose source changed or that was written for another vertex layout is
+	// ignored and replaced by the next import.
+	class AmasMeshCache {
+	public:
+		static constexpr uint32_t MAGIC = 0x48534d41;  // "AMSH"
+		static constexpr uint32_t VERSION = 4;
+
+		// where the cache of a source file lives, next to it
+		static std::string getCachePath(const std::string& sourcePath);
+
+		// Fills builder from the cache of sourcePath, false when there is no valid one. The vertices
+		// and indices stay in the mapped cache, see Builder::mappedFile.
+		static bool read(const std::string& sourcePath, AmasModel::Builder& builder);
+		// Best effort, a cache that cannot be written only costs the next startup another import.
+		static void write(const std::string& sourcePath, const AmasModel::Builder& builder);
+	};
+
+}  // namespace amas
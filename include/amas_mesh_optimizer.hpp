@@ -0,0 +1,53 @@
+#pragma once
+
+#include "amas_model.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace amas {
+
+	// Reorders the triangles and vertices of an indexed triangle list so the gpu transforms each
+	// vertex as few times as possible, and reads the vertex buffer front to back.
+	class AmasMeshOptimizer {
+	public:
+		// entries of the post-transform vertex cache the reordering targets and the statistics simulate
+		static constexpr uint32_t CACHE_SIZE = 16;
+
+		struct Statistics {
+			float acmr = 0.f;  // vertex shader invocations per triangle, 0.5 at best on a large grid
+			float atvr = 0.f;  // vertex shader invocations per vertex, 1 at best
+		};
+
+		// Simulates a FIFO post-transform cache of cacheSize entries over the indices.
+		static Statistics analyzeVertexCache(
+			const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+
+		// Tipsify (Sander et al. 2007): fans around the vertex whose triangles can still hit the cache,
+		// in linear time. Fills clusters, when given, with the first triangle of every run that
+		// restarted from a dead end.
+		static void optimizeVertexCache(
+			std::vector<uint32_t>& indices,
+			uint32_t vertexCount,
+			std::vector<uint32_t>* clusters = nullptr,
+			uint32_t cacheSize = CACHE_SIZE);
+
+		// Splits the clusters of optimizeVertexCache further where that costs little cache locality,
+		// then draws the clusters facing away from the mesh centre first so they occlude the rest.
+		static void optimizeOverdraw(
+			std::vector<uint32_t>& indices,
+			const std::vector<AmasModel::Vertex>& vertices,
+			const std::vector<uint32_t>& clusters,
+			uint32_t cacheSize = CACHE_SIZE);
+
+		// Renumbers the vertices in the order the indices first use them, unused ones are dropped.
+		static void optimizeVertexFetch(std::vector<AmasModel::Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		// Runs all of the above on every level of detail of the builder, overdraw included when
+		// asked for. The statistics are those of the finest level.
+		static void optimize(
+			AmasModel::Builder& builder, bool reduceOverdraw, Statistics* before = nullptr, Statistics* after = nullptr);
+	};
+
+}  // namespace amas
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "amas_model.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace amas {
+
+	// Quadric error edge collapse (Garland and Heckbert 1997) restricted to collapsing a vertex onto
+	// a neighbour, so every level keeps indexing the vertices of the original mesh. Vertices on open
+	// borders and attribute seams stay where they are.
+	class AmasMeshSimplifier {
+	public:
+		// levels of detail generated for an imported mesh, the full mesh included
+		static constexpr uint32_t MAX_LOD_COUNT = 5;
+		// a level must remove at least this share of the triangles of the one before it
+		static constexpr float MIN_LOD_REDUCTION = .2f;
+		// largest error of a level, relative to the mesh's bounding radius
+		static constexpr float MAX_LOD_ERROR = .1f;
+
+		// Collapses the cheapest edges of the triangle list until it has at most targetIndexCount
+		// indices or the next collapse would move the surface further than maxError. resultError
+		// receives the largest object-space distance any collapse made.
+		static std::vector<uint32_t> simplify(
+			const std::vector<AmasModel::Vertex>& vertices,
+			const std::vector<uint32_t>& indices,
+			size_t targetIndexCount,
+			float maxError,
+			float& resultError);
+
+		// Appends each level halving the triangle count of the previous one to builder.indices and
+		// fills builder.lods, level 0 being the mesh as it is.
+		static void generateLods(AmasModel::Builder& builder);
+	};
+
+}  // namespace amas
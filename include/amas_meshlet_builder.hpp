@@ -0,0 +1,35 @@
+#pragma once
+
+#include "amas_model.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace amas {
+
+	// Cuts the finest level of a mesh into meshlets the renderer can cull one by one, against the
+	// frustum with their spheres and, on closed meshes, against the viewpoint with their normal cones.
+	class AmasMeshletBuilder {
+	public:
+		// limits of a meshlet, those of common mesh shader implementations
+		static constexpr uint32_t MAX_VERTICES = 64;
+		static constexpr uint32_t MAX_TRIANGLES = 124;
+
+		// 1 when the triangles form a closed surface wound counter-clockwise seen from outside,
+		// -1 when wound clockwise, 0 when the surface has open borders.
+		static int surfaceOrientation(
+			const std::vector<AmasModel::Vertex>& vertices, const uint32_t* indices, uint32_t indexCount);
+
+		// Sphere and normal cone of a run of triangles. Triangles whose outward normal is their
+		// winding's when orientation is 1, the opposite one when it is -1, no cone when it is 0.
+		static AmasModel::Meshlet computeBounds(
+			const std::vector<AmasModel::Vertex>& vertices, const uint32_t* indices, uint32_t indexCount, int orientation);
+
+		// Splits the finest level of the builder into runs of consecutive triangles within the limits
+		// above, in the order the optimizer left them. Fills builder.meshlets, left empty when the
+		// level fits in a single meshlet.
+		static void build(AmasModel::Builder& builder);
+	};
+
+}  // namespace amas
@@ -2,6 +2,8 @@
 
 #include "amas_device.hpp"
 #include "amas_buffer.hpp"
+#include "amas_geometry_pool.hpp"
+#include "amas_uploader.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -10,19 +12,38 @@
 
 // std
 #include <memory>
+#include <optional>
+#include <span>
 #include <vector>
 
 namespace amas {
+	class AmasFile;
+	class AmasJobSystem;
+
 	class AmasModel {
 	public:
+		// Layout of the vertices in gpu memory. The compact ones store positions relative to the
+		// mesh bounds, octahedral normals in two int16, half-float uvs and unorm8 colors.
+		enum class VertexFormat {
+			FLOAT,             // 44 bytes, Vertex as is
+			HALF,              // 20 bytes, half-float positions
+			SNORM16,           // 20 bytes, normalized int16 positions
+			SNORM16_NO_COLOR,  // 16 bytes, SNORM16 without the color, the shader uses white
+		};
+
+		// format every mesh is uploaded in, the pipelines drawing meshes follow it
+		static constexpr VertexFormat VERTEX_FORMAT = VertexFormat::SNORM16;
+
+		// Vertices as imported and processed on the cpu, encoded into VERTEX_FORMAT on upload.
 		struct Vertex {
 			glm::vec3 position{};
 			glm::vec3 color{};
 			glm::vec3 normal{};
 			glm::vec2 uv{};
 
-			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+			static uint32_t getStride(VertexFormat format = VERTEX_FORMAT);
+			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(VertexFormat format = VERTEX_FORMAT);
+			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(VertexFormat format = VERTEX_FORMAT);
 
 			bool operator==(const Vertex& other) const {
 				return position == other.position && color == other.color && normal == other.normal &&
@@ -30,11 +51,66 @@ namespace amas {
 			}
 		};
 
+		// object-space bounds of the mesh, the sphere is centred on the box
+		struct Bounds {
+			glm::vec3 min{};
+			glm::vec3 max{};
+			glm::vec3 center{};
+			float radius = 0.f;
+		};
+
+		// Range of the model's indices drawing one level of detail, relative to the mesh's first
+		// index. error is how far, in object space, the level may stray from the full mesh.
+		struct Lod {
+			uint32_t firstIndex = 0;
+			uint32_t indexCount = 0;
+			float error = 0.f;
+		};
+
+		// Run of consecutive triangles of the finest level, small enough to be culled on its own.
+		// cone.xyz is the object-space axis the triangle normals gather around, cone.w the sine of
+		// their spread; the meshlet faces away from every viewpoint in
+		// dot(center - viewpoint, axis) >= cone.w * length(center - viewpoint) + radius.
+		// cone.w is 1 when no viewpoint qualifies.
+		struct Meshlet {
+			glm::vec4 sphere{};  // object-space center, w is radius
+			glm::vec4 cone{ 0.f, 0.f, 0.f, 1.f };
+			uint32_t firstIndex = 0;  // relative to the mesh's first index
+			uint32_t indexCount = 0;
+		};
+
+		// object-space position = offset + scale * stored position, identity for FLOAT
+		struct PositionDecode {
+			glm::vec3 offset{ 0.f };
+			glm::vec3 scale{ 1.f };
+		};
+
 		struct Builder {
 			std::vector<Vertex> vertices{};
 			std::vector<uint32_t> indices{};
-
-			void loadModel(const std::string& filepath);
+			// set when read from a mesh cache, computed from the vertices otherwise
+			std::optional<Bounds> bounds{};
+			// levels of detail stored back to back in indices, finest first, all of the indices
+			// form a single level when empty
+			std::vector<Lod> lods{};
+			// partition of the finest level, empty when the mesh was never split
+			std::vector<Meshlet> meshlets{};
+			// Set when read from a mesh cache: the vertices and indices are views into the mapped
+			// cache, staged straight from there, and the vectors above stay empty.
+			std::shared_ptr<const AmasFile> mappedFile{};
+			std::span<const Vertex> mappedVertices{};
+			std::span<const uint32_t> mappedIndices{};
+
+			// the vertices and indices wherever they live
+			std::span<const Vertex> getVertices() const { return mappedFile ? mappedVertices : std::span<const Vertex>{ vertices }; }
+			std::span<const uint32_t> getIndices() const { return mappedFile ? mappedIndices : std::span<const uint32_t>{ indices }; }
+
+			// Reads the mesh cache of filepath when it is up to date, otherwise imports the OBJ,
+			// generates its levels of detail, optimizes them for the vertex cache, overdraw and
+			// vertex fetch, splits the finest one into meshlets and writes the cache for the next run.
+			void loadModel(const std::string& filepath, AmasJobSystem* jobSystem = nullptr);
+			// With a job system the shapes of the file are deduplicated in parallel.
+			void loadObj(const std::string& filepath, AmasJobSystem* jobSystem = nullptr);
 		};
 
 		AmasModel(AmasDevice& device, const AmasModel::Builder& builder);
@@ -45,21 +121,39 @@ namespace amas {
 
 		static std::unique_ptr<AmasModel> createModelFromFile(
 			AmasDevice& device, const std::string& filepath);
+		static Bounds computeBounds(std::span<const Vertex> vertices);
+		// Packs vertices into format at destination, vertices.size() * getStride(format) bytes,
+		// positions relative to bounds. decode is what the shader needs to get the object-space
+		// position back.
+		static void encodeVertices(
+			std::span<const Vertex> vertices, const Bounds& bounds, VertexFormat format, PositionDecode& decode, void* destination);
+		// largest object-space distance between a position and its encoded copy
+		static float positionErrorBound(VertexFormat format, const PositionDecode& decode);
 
 		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer);
+		void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0, uint32_t lod = 0);
+
+		// the vertex and index data may still be in flight until this ticket completes
+		AmasUploader::Ticket getUploadTicket() const { return uploadTicket; }
+		const AmasGeometryPool::Mesh& getMesh() const { return mesh; }
+		const Bounds& getBounds() const { return bounds; }
+		const PositionDecode& getPositionDecode() const { return positionDecode; }
+		uint32_t getLodCount() const { return static_cast<uint32_t>(lods.size()); }
+		const Lod& getLod(uint32_t lod) const { return lods[lod]; }
+		float getPositionErrorBound() const { return positionErrorBound(VERTEX_FORMAT, positionDecode); }
+		uint32_t getMeshletCount() const { return static_cast<uint32_t>(meshlets.size()); }
+		const Meshlet& getMeshlet(uint32_t meshlet) const { return meshlets[meshlet]; }
 
 	private:
-		void createVertexBuffers(const std::vector<Vertex>& vertices);
-		void createIndexBuffers(const std::vector<uint32_t>& indices);
+		void createMesh(const Builder& builder);
 
 		AmasDevice& amasDevice;
 
-		std::unique_ptr<AmasBuffer> vertexBuffer;
-		uint32_t vertexCount;
-
-		bool hasIndexBuffer = false;
-		std::unique_ptr<AmasBuffer> indexBuffer;
-		uint32_t indexCount;
+		AmasGeometryPool::Mesh mesh{};
+		Bounds bounds{};
+		PositionDecode positionDecode{};
+		std::vector<Lod> lods{};
+		std::vector<Meshlet> meshlets{};
+		AmasUploader::Ticket uploadTicket = 0;
 	};
 }  // namespace amas
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "amas_mapped_file.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace amas {
+
+	// Archive of engine content in a single file: a header, a table of contents sorted by path, the
+	// path strings and the entries. Every entry starts on a page boundary, so a stored entry is read
+	// straight from the mapped pack and may be given to code wanting aligned data. An entry can be
+	// LZ4 compressed instead, it is then decoded into memory when opened.
+	class AmasPack {
+	public:
+		static constexpr uint32_t MAGIC = 0x4b415041;  // "APAK"
+		static constexpr uint32_t VERSION = 1;
+		static constexpr uint32_t ALIGNMENT = 4096;
+
+		enum class Compression : uint32_t {
+			NONE,
+			LZ4,
+		};
+
+		struct Entry {
+			std::string_view path;
+			uint64_t offset = 0;      // from the start of the pack
+			uint64_t storedSize = 0;  // in the pack
+			uint64_t size = 0;        // once decompressed
+			// modification time of the file the entry was packed from, as the loose file reports it
+			int64_t sourceTime = 0;
+			Compression compression = Compression::NONE;
+		};
+
+		// one file to pack, path is what the engine opens it by
+		struct Source {
+			std::string path;
+			std::string filepath;
+			bool compress = false;
+		};
+
+		// throws when the file is not a valid pack
+		explicit AmasPack(const std::string& filepath);
+
+		AmasPack(const AmasPack&) = delete;
+		AmasPack& operator=(const AmasPack&) = delete;
+
+		// null when the pack has no entry for path
+		const Entry* find(std::string_view path) const;
+		const std::vector<Entry>& getEntries() const { return entries; }
+		const std::shared_ptr<const AmasMappedFile>& getMapping() const { return mapping; }
+
+		// Writes the sources into a pack at filepath. A source marked compress is stored raw when
+		// LZ4 does not make it at least an eighth smaller. Throws when a source cannot be read or
+		// the pack cannot be written.
+		static void write(const std::string& filepath, std::vector<Source> sources);
+
+		// Forward slashes, no leading "./", the form the table of contents is sorted in.
+		static std::string normalizePath(std::string_view path);
+
+	private:
+		std::shared_ptr<const AmasMappedFile> mapping;
+		std::vector<Entry> entries;
+	};
+
+}  // namespace amas
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "amas_device.hpp"
+#include "amas_file_system.hpp"
 
 // std
 #include <string>
@@ -36,6 +37,7 @@ namespace amas {
 			const std::string& vertFilepath,
 			const std::string& fragFilepath,
 			const PipelineConfigInfo& configInfo);
+		AmasPipeline(AmasDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout);
 		~AmasPipeline();
 
 		AmasPipeline(const AmasPipeline&) = delete;
@@ -47,18 +49,19 @@ namespace amas {
 		static void enableAlphaBlending(PipelineConfigInfo& configInfo);
 
 	private:
-		static std::vector<char> readFile(const std::string& filepath);
-
 		void createGraphicsPipeline(
 			const std::string& vertFilepath,
 			const std::string& fragFilepath,
 			const PipelineConfigInfo& configInfo);
+		void createComputePipeline(const std::string& compFilepath, VkPipelineLayout pipelineLayout);
 
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+		void createShaderModule(const AmasFile& code, VkShaderModule* shaderModule);
 
 		AmasDevice& amasDevice;
-		VkPipeline graphicsPipeline;
-		VkShaderModule vertShaderModule;
-		VkShaderModule fragShaderModule;
+		VkPipeline pipeline;
+		VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+		VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+		VkShaderModule compShaderModule = VK_NULL_HANDLE;
 	};
 }  // namespace amas
@@ -1,18 +1,20 @@
 #pragma once
 
 #include "amas_device.hpp"
+#include "amas_job_system.hpp"
 #include "amas_swap_chain.hpp"
 #include "amas_window.hpp"
 
 // std
 #include <cassert>
+#include <functional>
 #include <memory>
 #include <vector>
 
 namespace amas {
 	class AmasRenderer {
 	public:
-		AmasRenderer(AmasWindow& window, AmasDevice& device);
+		AmasRenderer(AmasWindow& window, AmasDevice& device, AmasJobSystem& jobSystem);
 		~AmasRenderer();
 
 		AmasRenderer(const AmasRenderer&) = delete;
@@ -20,6 +22,7 @@ namespace amas {
 
 		VkRenderPass getSwapChainRenderPass() const { return amasSwapChain->getRenderPass(); }
 		float getAspectRatio() const { return amasSwapChain->extentAspectRatio(); }
+		VkExtent2D getSwapChainExtent() const { return amasSwapChain->getSwapChainExtent(); }
 		bool isFrameInProgress() const { return isFrameStarted; }
 
 		VkCommandBuffer getCurrentCommandBuffer() const {
@@ -34,19 +37,52 @@ namespace amas {
 
 		VkCommandBuffer beginFrame();
 		void endFrame();
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the draws come from recordSecondary
+		// and are executed when the render pass ends.
+		void beginSwapChainRenderPass(
+			VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+		using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, uint32_t first, uint32_t last)>;
+
+		// Splits itemCount items into contiguous ranges of at least minItemsPerBuffer and calls
+		// record for every range with a secondary command buffer of its own, on as many threads
+		// as there are ranges, through the job system. The viewport and scissor are already set in those buffers.
+		// Returns once all ranges are recorded, they execute in range order.
+		void recordSecondary(uint32_t itemCount, uint32_t minItemsPerBuffer, const RecordFunction& record);
+		uint32_t getRecordingSlotCount() const { return recordingSlotCount; }
+
 	private:
+		// one command pool per recording thread and frame in flight, reset as a whole when the
+		// frame comes around again
+		struct RecordingSlot {
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> commandBuffers;
+			uint32_t usedCount = 0;
+		};
+
+		static constexpr uint32_t MAX_RECORDING_SLOTS = 8;
+
 		void createCommandBuffers();
 		void freeCommandBuffers();
+		void createRecordingSlots();
+		void destroyRecordingSlots();
 		void recreateSwapChain();
+		void setViewportAndScissor(VkCommandBuffer commandBuffer);
+		VkCommandBuffer beginSecondaryCommandBuffer(uint32_t slot);
 
 		AmasWindow& amasWindow;
 		AmasDevice& amasDevice;
+		AmasJobSystem& jobSystem;
 		std::unique_ptr<AmasSwapChain> amasSwapChain;
 		std::vector<VkCommandBuffer> commandBuffers;
 
+		uint32_t recordingSlotCount = 1;
+		std::vector<std::vector<RecordingSlot>> recordingSlots;  // [frame][slot]
+		// recorded this frame, executed by endSwapChainRenderPass
+		std::vector<VkCommandBuffer> secondaryCommandBuffers;
+		VkSubpassContents subpassContents = VK_SUBPASS_CONTENTS_INLINE;
+
 		uint32_t currentImageIndex;
 		int currentFrameIndex{ 0 };
 		bool isFrameStarted{ false };
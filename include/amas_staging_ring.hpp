@@ -0,0 +1,55 @@
+#pragma once
+
+#include "amas_buffer.hpp"
+
+// std
+#include <deque>
+#include <memory>
+
+namespace amas {
+
+	// A persistently mapped host-visible buffer handed out as a ring of aligned slices.
+	// Every slice is tagged with the id of the work that reads it, and the space is reclaimed
+	// in order once retire() is called with an id at or past that tag.
+	class AmasStagingRing {
+	public:
+		static constexpr VkDeviceSize DEFAULT_CAPACITY = 32ull * 1024 * 1024;
+
+		struct Slice {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			void* data = nullptr;
+		};
+
+		AmasStagingRing(AmasDevice& device, VkDeviceSize capacity = DEFAULT_CAPACITY);
+
+		AmasStagingRing(const AmasStagingRing&) = delete;
+		AmasStagingRing& operator=(const AmasStagingRing&) = delete;
+
+		// returns false when the ring has no room left until older slices are retired
+		bool allocate(VkDeviceSize size, VkDeviceSize alignment, uint64_t tag, Slice& slice);
+		void retire(uint64_t completedTag);
+
+		VkDeviceSize getCapacity() const { return capacity; }
+		VkDeviceSize getUsedBytes() const { return used; }
+
+	private:
+		struct Marker {
+			uint64_t tag;
+			VkDeviceSize end;
+			VkDeviceSize bytes;
+		};
+
+		void commit(uint64_t tag, VkDeviceSize end, VkDeviceSize bytes);
+
+		std::unique_ptr<AmasBuffer> buffer;
+		VkDeviceSize capacity;
+
+		// live bytes sit in [tail, head), wrapping past the end of the buffer
+		VkDeviceSize head = 0;
+		VkDeviceSize tail = 0;
+		VkDeviceSize used = 0;
+		std::deque<Marker> markers;
+	};
+
+}  // namespace amas
@@ -71,7 +71,7 @@ namespace amas {
 		VkRenderPass renderPass;
 
 		std::vector<VkImage> depthImages;
-		std::vector<VkDeviceMemory> depthImageMemorys;
+		std::vector<AmasAllocation*> depthImageAllocations;
 		std::vector<VkImageView> depthImageViews;
 		std::vector<VkImage> swapChainImages;
 		std::vector<VkImageView> swapChainImageViews;
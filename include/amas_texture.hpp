@@ -1,12 +1,47 @@
 #pragma once
 #include <vulkan/vulkan_core.h>
 #include "amas_device.hpp"
+#include "amas_uploader.hpp"
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace amas {
+	class AmasFile;
+
 	class AmasTexture {
 	public:
+		// Image ready for upload, can be produced on any thread. Decoded to RGBA8, or the block
+		// compressed levels of a KTX2 container as they are stored.
+		struct Pixels {
+			// bytes of one mip level in the data
+			struct Level {
+				size_t offset = 0;
+				size_t size = 0;
+			};
+
+			int width = 0;
+			int height = 0;
+			VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+			// finest first, a single RGBA8 level gets the rest of its chain generated on upload
+			std::vector<Level> levels{};
+			std::unique_ptr<unsigned char, void (*)(void*)> data{ nullptr, nullptr };
+			// the container the levels are uploaded from in place, data stays null then
+			std::shared_ptr<const AmasFile> file{};
+
+			const unsigned char* getData() const;
+
+			// KTX2 containers are told apart by their identifier, anything else is decoded by stb
+			static Pixels loadFromFile(const std::string& filepath);
+			static Pixels solidColor(unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+
+			// RGBA8 copy of every level, for a device that cannot sample the block format
+			Pixels decompress() const;
+		};
+
 		AmasTexture(AmasDevice& device, const std::string& filepath);
+		// pixels in a format the device cannot sample are decompressed first
+		AmasTexture(AmasDevice& device, const Pixels& pixels);
 		AmasTexture(const AmasTexture&) = delete;
 		AmasTexture& operator=(const AmasTexture&) = delete;
 		AmasTexture(AmasTexture&&) = delete;
@@ -14,22 +49,26 @@ namespace amas {
 
 		~AmasTexture();
 
+		// whether images of format can be sampled with the filtering textures use
+		static bool supportsFormat(AmasDevice& device, VkFormat format);
+
 		VkSampler getSampler() { return sampler; }
 		VkImageView getImageView() { return imageView; }
 		VkImageLayout getImageLayout() { return imageLayout; }
 
 	private:
-		void transitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout);
-		void generateMinmaps();
+		void transitionImageLayout(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout);
+		void generateMinmaps(VkCommandBuffer commandBuffer);
 
 		int width, height, mipLevels;
 		AmasDevice& amasDevice;
 		VkImage image;
-		VkDeviceMemory imageMemory;
+		AmasAllocation* imageAllocation;
 		VkImageView imageView;
 		VkSampler sampler;
 		VkFormat imageFormat;
 		VkImageLayout imageLayout;
+		AmasUploader::Ticket uploadTicket = 0;
 
 	};
 
@@ -0,0 +1,53 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace amas {
+
+	// Translation, rotation and scale of many transforms, one array per component. compose()
+	// builds the model and normal matrices of the whole batch several objects at a time, with
+	// the widest instruction set the cpu supports.
+	class AmasTransformBatch {
+	public:
+		enum class Kernel { SCALAR, SSE2, AVX2 };
+
+		void clear();
+		void reserve(size_t count);
+		void add(const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale);
+		size_t size() const { return translationX.size(); }
+
+		// Writes size() matrices to models and normals.
+		void compose(glm::mat4* models, glm::mat3* normals) const;
+		// Only the objects in [first, last), written to the same positions of models and normals.
+		// A kernel the cpu lacks falls back to the best available one.
+		void compose(
+			size_t first, size_t last, glm::mat4* models, glm::mat3* normals, Kernel kernel = bestKernel()) const;
+
+		// Translate * Ry * Rx * Rz * Scale and its inverse transpose for a single object.
+		static void compose(
+			const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale,
+			glm::mat4& model, glm::mat3& normal);
+
+		// widest kernel this build and cpu can run
+		static Kernel bestKernel();
+
+	private:
+		std::vector<float> translationX;
+		std::vector<float> translationY;
+		std::vector<float> translationZ;
+		std::vector<float> rotationX;
+		std::vector<float> rotationY;
+		std::vector<float> rotationZ;
+		std::vector<float> scaleX;
+		std::vector<float> scaleY;
+		std::vector<float> scaleZ;
+	};
+
+}  // namespace amas
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "amas_buffer.hpp"
+#include "amas_device.hpp"
+#include "amas_staging_ring.hpp"
+
+// std
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace amas {
+
+	// Batches staging copies and other one-off transfer work into a single submission per batch
+	// instead of a vkQueueWaitIdle per asset. Every batch ends with a barrier that makes its writes
+	// visible to later draws on the same queue, so callers only need to wait on a ticket before
+	// touching the data from the host again.
+	// Source data is staged through a persistently mapped ring whose slices are reclaimed as their
+	// batch retires, uploads too large for the ring fall back to a temporary staging buffer.
+	// On devices with a dedicated transfer family the copies run there, and a short graphics-queue
+	// submission waiting on a semaphore acquires ownership of the written resources.
+	class AmasUploader {
+		struct Batch;
+
+	public:
+		using Ticket = uint64_t;
+
+		// Command buffers of the batch being recorded. Both refer to the same command buffer when
+		// the device has no dedicated transfer queue.
+		class Recorder {
+		public:
+			// copies and layout transitions the transfer queue can execute
+			VkCommandBuffer transfer() const;
+			// blits and other graphics-only work, executed after every transfer in the batch
+			VkCommandBuffer graphics() const;
+
+			// Hands a resource written through transfer() over to the graphics queue.
+			// Buffers are acquired for vertex, index, uniform and shader reads.
+			void transferOwnership(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+			void transferOwnership(
+				VkImage image,
+				const VkImageSubresourceRange& range,
+				VkImageLayout layout,
+				VkPipelineStageFlags dstStageMask,
+				VkAccessFlags dstAccessMask);
+
+		private:
+			friend class AmasUploader;
+
+			Recorder(AmasUploader& uploader, Batch& batch) : uploader{ uploader }, batch{ batch } {}
+
+			AmasUploader& uploader;
+			Batch& batch;
+		};
+
+		// a pending batch is submitted once it holds this many bytes of staging data
+		static constexpr VkDeviceSize MAX_BATCH_STAGING_BYTES = 64ull * 1024 * 1024;
+
+		AmasUploader(AmasDevice& device);
+		~AmasUploader();
+
+		AmasUploader(const AmasUploader&) = delete;
+		AmasUploader& operator=(const AmasUploader&) = delete;
+
+		// Records commands into the pending batch. The staging buffer, if any, is released once the
+		// batch has finished executing.
+		Ticket record(
+			const std::function<void(Recorder&)>& commands,
+			std::unique_ptr<AmasBuffer> staging = nullptr);
+
+		// Copies size bytes of data into staging memory and records commands that read it from
+		// srcBuffer at srcOffset.
+		Ticket stage(
+			const void* data,
+			VkDeviceSize size,
+			const std::function<void(Recorder&, VkBuffer srcBuffer, VkDeviceSize srcOffset)>& commands);
+		// Same, with the staging memory filled by write, so data produced on the fly or read from a
+		// mapped file lands there without an intermediate copy.
+		Ticket stage(
+			VkDeviceSize size,
+			const std::function<void(void* staging)>& write,
+			const std::function<void(Recorder&, VkBuffer srcBuffer, VkDeviceSize srcOffset)>& commands);
+		Ticket copyBuffer(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+		Ticket copyBuffer(
+			VkDeviceSize size, const std::function<void(void* staging)>& write, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+
+		Ticket submit();
+		bool isComplete(Ticket ticket);
+		void wait(Ticket ticket);
+		void waitIdle();
+
+		// releases staging memory and command buffers of finished batches
+		void collect();
+
+		bool hasDedicatedTransferQueue() const { return dedicatedTransfer; }
+		uint64_t getSubmissionCount() const { return submissionCount; }
+		uint64_t getStagingFallbackCount() const { return stagingFallbackCount; }
+
+	private:
+		struct Batch {
+			Ticket ticket;
+			VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+			VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			std::vector<std::unique_ptr<AmasBuffer>> stagingBuffers;
+			VkDeviceSize stagingBytes = 0;
+			bool usesStagingRing = false;
+		};
+
+		void beginBatch();
+		VkCommandBuffer beginCommandBuffer(VkCommandPool pool);
+		bool allocateStaging(VkDeviceSize size, AmasStagingRing::Slice& slice);
+		Ticket submitLocked();
+		void collectLocked();
+		VkFence acquireFence();
+		VkSemaphore acquireSemaphore();
+
+		AmasDevice& amasDevice;
+		bool dedicatedTransfer;
+		uint32_t transferFamily;
+		uint32_t graphicsFamily;
+		VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+		VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+		AmasStagingRing stagingRing;
+		VkDeviceSize stagingAlignment;
+
+		std::unique_ptr<Batch> pending;
+		std::deque<std::unique_ptr<Batch>> inFlight;
+		std::vector<VkFence> freeFences;
+		std::vector<VkSemaphore> freeSemaphores;
+
+		Ticket nextTicket = 1;
+		Ticket completedTicket = 0;
+		uint64_t submissionCount = 0;
+		uint64_t stagingFallbackCount = 0;
+		std::mutex mutex;
+	};
+
+}  // namespace amas
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "amas_asset_loader.hpp"
 #include "amas_game_object.hpp"
+#include "amas_hierarchy.hpp"
 #include "amas_device.hpp"
+#include "amas_job_system.hpp"
 #include "amas_descriptors.hpp"
 #include "amas_renderer.hpp"
 #include "amas_window.hpp"
@@ -16,6 +19,10 @@ namespace amas {
 	public:
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 600;
+		// written by amas-packer from objs and shaders
+		static constexpr const char* ASSET_PACK = "assets.apak";
+		// prints culling and level of detail counts once a second
+		static constexpr bool PRINT_FRAME_STATS = false;
 
 		App();
 		~App();
@@ -41,14 +48,21 @@ namespace amas {
 
 	private:
 		void loadGameObjects();
+		// uniform buffer at binding 0, the material images after it
+		void writeGlobalSet(VkDescriptorSet& set, AmasBuffer& buffer, bool overwrite);
 
+		// first so the workers outlive everything that hands them jobs
+		AmasJobSystem jobSystem;
 		AmasWindow amasWindow{ WIDTH, HEIGHT, "Vulkan Tutorial" };
 		AmasDevice amasDevice{ amasWindow };
-		AmasRenderer AmasRenderer{ amasWindow, amasDevice };
+		AmasRenderer AmasRenderer{ amasWindow, amasDevice, jobSystem };
+		AmasAssetLoader assetLoader{ amasDevice, jobSystem };
 
-		std::vector<std::shared_ptr<AmasTexture>> textures;
+		std::vector<AmasAssetHandle<AmasTexture>> textures;
 		std::unique_ptr<AmasDescriptorPool> globalPool{};
 		std::vector<std::unique_ptr<AmasDescriptorSetLayout>> descriptorSetLayouts;
-		AmasGameObject::Map gameObjects;
+		AmasRegistry registry;
+		SceneBvh sceneBvh;
+		AmasHierarchy hierarchy;
 	};
 }  // namespace amas
@@ -20,7 +20,7 @@ namespace amas {
 			int speedUp = GLFW_KEY_LEFT_SHIFT;
 		};
 
-		void moveInPlaneXZ(GLFWwindow* window, float dt, AmasGameObject& gameObject);
+		void moveInPlaneXZ(GLFWwindow* window, float dt, TransformComponent& transform);
 
 		KeyMappings keys{};
 		float moveSpeed{ 5.f };
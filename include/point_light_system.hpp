@@ -14,6 +14,11 @@
 namespace amas {
 	class PointLightSystem {
 	public:
+		// lights further than this from the camera are not considered for the ubo
+		static constexpr float LIGHT_GATHER_RADIUS = 100.f;
+		// fewer billboards than this are not worth a recording thread of their own
+		static constexpr uint32_t MIN_LIGHTS_PER_BUFFER = 256;
+
 		PointLightSystem(AmasDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
 		~PointLightSystem();
 
@@ -21,6 +26,7 @@ namespace amas {
 		PointLightSystem& operator=(const PointLightSystem&) = delete;
 
 		void update(FrameInfo& frameInfo, GlobalUbo& ubo);
+		// records into secondary command buffers, see AmasRenderer::recordSecondary
 		void render(FrameInfo& frameInfo);
 
 	private:
@@ -32,6 +38,8 @@ namespace amas {
 		std::unique_ptr<AmasPipeline> amasPipeline;
 		VkPipelineLayout pipelineLayout;
 
+		std::vector<uint32_t> lightQuery;
+
 		//my variables
 		std::chrono::steady_clock::time_point startTime;
 		bool firstTime{ true };
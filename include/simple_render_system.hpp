@@ -1,33 +1,146 @@
 #pragma once
 
 #include "amas_camera.hpp"
+#include "amas_descriptors.hpp"
 #include "amas_device.hpp"
 #include "amas_game_object.hpp"
 #include "amas_pipeline.hpp"
 #include "amas_frame_info.hpp"
+#include "amas_frustum.hpp"
 
 // std
+#include <array>
 #include <memory>
 #include <vector>
 
 namespace amas {
 	class SimpleRenderSystem {
 	public:
+		// fewer draw batches than this are not worth a recording thread of their own
+		static constexpr uint32_t MIN_BATCHES_PER_BUFFER = 4;
+		// screen-space error, in pixels, a level of detail may show before a finer one is drawn
+		static constexpr float DEFAULT_LOD_ERROR_PIXELS = 1.f;
+
+		enum class CullingMode {
+			NONE,
+			CPU,  // scene bvh query refined by a sphere test on the host
+			GPU,  // scene bvh query refined in a compute pass that compacts the indirect commands
+		};
+
+		// Objects drawn at full detail from split meshes are culled meshlet by meshlet, they count
+		// as visible objects and their meshlets as clusters.
+		struct CullingStats {
+			uint32_t objectCount = 0;
+			uint32_t visibleCount = 0;
+			uint32_t culledCount = 0;
+			uint32_t clusterCount = 0;
+			uint32_t visibleClusterCount = 0;
+		};
+
+		// triangles of the objects that reached the draw commands, before gpu culling
+		struct LodStats {
+			uint32_t drawnTriangles = 0;
+			uint32_t fullDetailTriangles = 0;
+		};
+
 		SimpleRenderSystem(AmasDevice& device, VkRenderPass renderPass, const std::vector<std::unique_ptr<AmasDescriptorSetLayout>>& layouts);
 		~SimpleRenderSystem();
 
 		SimpleRenderSystem(const SimpleRenderSystem&) = delete;
 		SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 
+		// Writes this frame's instances and indirect commands and records the culling dispatch.
+		// Must be called outside the render pass, before renderGameObjects.
+		void prepareGameObjects(FrameInfo& frameInfo);
+		// records into secondary command buffers, see AmasRenderer::recordSecondary
 		void renderGameObjects(FrameInfo& frameInfo, std::vector<VkDescriptorSet>& componentSets, std::vector<std::unique_ptr<AmasBuffer>>& componentUboBuffers);
 
+		// GPU culling needs drawIndirectFirstInstance and falls back to the CPU test without it
+		void setCullingMode(CullingMode mode);
+		CullingMode getCullingMode() const { return cullingMode; }
+
+		// Counters of the most recent culled frame. CPU results belong to the current frame,
+		// GPU results are read back once the frame that produced them has finished.
+		const CullingStats& getCullingStats() const { return cullingStats; }
+
+		// 0 always draws the full meshes
+		void setLodErrorThreshold(float pixels) { lodErrorThreshold = pixels; }
+		float getLodErrorThreshold() const { return lodErrorThreshold; }
+		const LodStats& getLodStats() const { return lodStats; }
+
 	private:
+		struct DrawItem {
+			AmasModel* model;
+			AmasTexture* texture;
+			uint32_t entityIndex;
+			TransformComponent* transform;
+			glm::mat4 modelMatrix;
+			uint32_t lod = 0;
+			// drawn meshlet by meshlet, its visibility starts at firstCluster in clusterVisibility
+			bool clustered = false;
+			uint32_t firstCluster = 0;
+		};
+
+		// consecutive indirect commands that read from the same geometry pool page
+		struct DrawBatch {
+			uint32_t page;
+			uint32_t firstCommand;
+			uint32_t commandCount;
+		};
+
+		void createInstanceDescriptors();
 		void createPipelineLayout(const std::vector<std::unique_ptr<AmasDescriptorSetLayout>>& layouts);
 		void createPipeline(VkRenderPass& renderPass);
+		void createCullPipeline(const std::vector<std::unique_ptr<AmasDescriptorSetLayout>>& layouts);
+		void reserveInstances(int frameIndex, uint32_t instanceCount, uint32_t cullObjectCount);
+		void readCullingStats(int frameIndex);
+		void cullOnHost(const AmasFrustum& frustum);
+		// frustum and back-face test of the meshlets of every clustered draw item
+		void cullClustersOnHost(const AmasFrustum& frustum, const AmasCamera& camera);
+		// coarsest level of every draw item whose projected error stays under the threshold
+		void selectLods(const AmasCamera& camera, float viewportHeight);
+		void recordDrawBatches(
+			int frameIndex,
+			VkCommandBuffer commandBuffer,
+			const std::array<VkDescriptorSet, 3>& descriptorSets,
+			uint32_t firstBatch,
+			uint32_t lastBatch);
 
 		AmasDevice& amasDevice;
 
 		std::unique_ptr<AmasPipeline> amasPipeline;
 		VkPipelineLayout pipelineLayout;
+
+		std::unique_ptr<AmasPipeline> cullPipeline;
+		VkPipelineLayout cullPipelineLayout;
+		CullingMode cullingMode;
+
+		// Per-frame buffers shared by the culling pass (set 1) and the vertex shader (set 2):
+		// instance transforms, the compacted visible instance indices, the bounds of every
+		// instance or meshlet of an instance, the indirect commands and the culling counters.
+		std::unique_ptr<AmasDescriptorSetLayout> instanceSetLayout;
+		std::unique_ptr<AmasDescriptorPool> instancePool;
+		std::vector<std::unique_ptr<AmasBuffer>> instanceBuffers;
+		std::vector<std::unique_ptr<AmasBuffer>> visibleBuffers;
+		std::vector<std::unique_ptr<AmasBuffer>> cullBuffers;
+		std::vector<std::unique_ptr<AmasBuffer>> indirectBuffers;
+		std::vector<std::unique_ptr<AmasBuffer>> statsBuffers;
+		std::vector<VkDescriptorSet> instanceSets;
+
+		// command count of every draw batch, read by the draw-count variant
+		std::vector<std::unique_ptr<AmasBuffer>> drawCountBuffers;
+
+		std::vector<DrawItem> drawItems;
+		std::vector<uint32_t> bvhResults;
+		AmasSphereBatch cullSpheres;
+		std::vector<uint8_t> cullVisibility;
+		std::vector<uint8_t> clusterVisibility;
+		std::vector<DrawBatch> drawBatches;
+		std::vector<uint32_t> frameObjectCounts;
+		// objects of the frame culled as meshlets, the shader only counts clusters for them
+		std::vector<uint32_t> frameClusteredCounts;
+		CullingStats cullingStats{};
+		float lodErrorThreshold = DEFAULT_LOD_ERROR_PIXELS;
+		LodStats lodStats{};
 	};
 }  // namespace amas
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "amas_frame_info.hpp"
+#include "amas_game_object.hpp"
+#include "amas_transform_batch.hpp"
+
+// std
+#include <vector>
+
+namespace amas {
+	// Rebuilds the matrices of every transform that changed since the last frame, propagates them
+	// down the hierarchy and refits the scene bvh leaves of the moved entities. Static entities
+	// only cost a flag check.
+	class TransformSystem {
+	public:
+		// dirty transforms composed per job
+		static constexpr uint32_t COMPOSE_GRAIN_SIZE = 2048;
+
+		void update(FrameInfo& frameInfo);
+
+		// transforms rebuilt by the last update
+		uint32_t getUpdatedCount() const { return updatedCount; }
+
+	private:
+		uint32_t updatedCount = 0;
+
+		AmasTransformBatch batch;
+		std::vector<TransformComponent*> pending;
+		std::vector<glm::mat4> models;
+		std::vector<glm::mat3> normals;
+	};
+}  // namespace amas
@@ -1,6 +1,9 @@
 C:\VulkanSDK\1.3.296.0\Bin\glslc.exe simple_shader.vert -o simple_shader.vert.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslc.exe -DOCTAHEDRAL_NORMAL simple_shader.vert -o simple_shader_compact.vert.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslc.exe -DOCTAHEDRAL_NORMAL -DNO_COLOR simple_shader.vert -o simple_shader_compact_no_color.vert.spv
 C:\VulkanSDK\1.3.296.0\Bin\glslc.exe simple_shader.frag -o simple_shader.frag.spv
 C:\VulkanSDK\1.3.296.0\Bin\glslc.exe point_light.vert -o point_light.vert.spv
 C:\VulkanSDK\1.3.296.0\Bin\glslc.exe point_light.frag -o point_light.frag.spv
+C:\VulkanSDK\1.3.296.0\Bin\glslc.exe cull.comp -o cull.comp.spv
 
 pause
\ No newline at end of file
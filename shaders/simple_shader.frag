@@ -24,11 +24,6 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 
 layout (set = 0, binding = 1) uniform sampler2D image;
 
-layout (push_constant) uniform Push {
-	mat4 modelMatrix;
-	mat4 normalMatrix;
-} push;
-
 void main() {
 	vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
 	vec3 specularLight = vec3(0.0);
@@ -1,8 +1,16 @@
 #version 450
 
+// Compiled once per AmasModel::VertexFormat, see compile.bat. OCTAHEDRAL_NORMAL selects the compact
+// formats, whose positions are relative to the mesh bounds, NO_COLOR the one without a color.
 layout (location = 0) in vec3 position;
+#ifndef NO_COLOR
 layout (location = 1) in vec3 color;
+#endif
+#ifdef OCTAHEDRAL_NORMAL
+layout (location = 2) in vec2 normal;
+#else
 layout (location = 2) in vec3 normal;
+#endif
 layout (location = 3) in vec2 uv;
 
 layout (location = 0) out vec3 fragColor;
@@ -24,16 +32,47 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
     int activeLightsCount;
 } ubo;
 
-layout (push_constant) uniform Push {
+struct InstanceData {
 	mat4 modelMatrix;
 	mat4 normalMatrix;
-} push;
+	vec4 positionOffset; // object space = offset + scale * position, w unused
+	vec4 positionScale;
+};
+
+layout(set = 2, binding = 0) readonly buffer InstanceBuffer {
+	InstanceData instances[];
+} instanceBuffer;
+
+// indices of the instances that survived culling, compacted per draw command
+layout(set = 2, binding = 1) readonly buffer VisibleBuffer {
+	uint indices[];
+} visibleBuffer;
+
+#ifdef OCTAHEDRAL_NORMAL
+// inverse of octEncode in amas_model.cpp
+vec3 octDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return n;
+}
+#endif
 
 void main() {
-	vec4 worldPosition = push.modelMatrix * vec4(position, 1.0);
+	InstanceData instance = instanceBuffer.instances[visibleBuffer.indices[gl_InstanceIndex]];
+	vec3 objectPosition = instance.positionOffset.xyz + instance.positionScale.xyz * position;
+	vec4 worldPosition = instance.modelMatrix * vec4(objectPosition, 1.0);
 	gl_Position = ubo.projection * ubo.view * worldPosition;
-	fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+#ifdef OCTAHEDRAL_NORMAL
+	fragNormalWorld = normalize(mat3(instance.normalMatrix) * octDecode(normal));
+#else
+	fragNormalWorld = normalize(mat3(instance.normalMatrix) * normal);
+#endif
 	fragPosWorld = worldPosition.xyz;
+#ifdef NO_COLOR
+	fragColor = vec3(1.0);
+#else
 	fragColor = color;
+#endif
 	fragUV = uv;
 }
\ No newline at end of file
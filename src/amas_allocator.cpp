@@ -0,0 +1,628 @@
+/*
+ * Device memory sub-allocator
+ *
+ * Each memory type gets a pool of large VkDeviceMemory blocks. Ranges inside a block are handed out
+ * with a two-level segregated fit (TLSF) free list, so allocation and free are O(1) and neighbouring
+ * free ranges are coalesced immediately.
+ */
+
+#include "../include/amas_allocator.hpp"
+
+// std
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <stdexcept>
+
+namespace amas {
+
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	static VkDeviceSize alignDown(VkDeviceSize value, VkDeviceSize alignment) {
+		return value & ~(alignment - 1);
+	}
+
+	// *************** Memory Block *********************
+
+	class AmasMemoryBlock {
+	public:
+		static constexpr uint32_t NIL = ~0u;
+
+		struct Node {
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+			uint32_t prevPhysical = NIL;
+			uint32_t nextPhysical = NIL;
+			uint32_t prevFree = NIL;
+			uint32_t nextFree = NIL;
+			bool free = true;
+			AmasAllocation* owner = nullptr;
+		};
+
+		AmasMemoryBlock(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, bool dedicated)
+			: memory{ memory }, size{ size }, memoryTypeIndex{ memoryTypeIndex }, dedicated{ dedicated } {
+			for (auto& heads : freeHeads) {
+				heads.fill(NIL);
+			}
+			firstNode = newNode();
+			nodes[firstNode].size = size;
+			insertFree(firstNode);
+		}
+
+		// smallest free range the search in allocate accepts for allocSize at alignment
+		static VkDeviceSize searchSize(VkDeviceSize allocSize, VkDeviceSize alignment) {
+			return roundUpForSearch(allocSize + alignment - 1);
+		}
+
+		uint32_t allocate(VkDeviceSize allocSize, VkDeviceSize alignment, AmasAllocation* owner) {
+			uint32_t fl, sl;
+			mapping(searchSize(allocSize, alignment), fl, sl);
+			uint32_t index = findFree(fl, sl);
+			if (index == NIL) {
+				return NIL;
+			}
+			removeFree(index);
+
+			VkDeviceSize padding = alignUp(nodes[index].offset, alignment) - nodes[index].offset;
+			if (padding > 0) {
+				uint32_t front = newNode();
+				nodes[front].offset = nodes[index].offset;
+				nodes[front].size = padding;
+				nodes[front].prevPhysical = nodes[index].prevPhysical;
+				nodes[front].nextPhysical = index;
+				if (nodes[index].prevPhysical != NIL) {
+					nodes[nodes[index].prevPhysical].nextPhysical = front;
+				}
+				else {
+					firstNode = front;
+				}
+				nodes[index].prevPhysical = front;
+				nodes[index].offset += padding;
+				nodes[index].size -= padding;
+				insertFree(front);
+			}
+
+			if (nodes[index].size - allocSize >= MIN_SPLIT_SIZE) {
+				uint32_t back = newNode();
+				nodes[back].offset = nodes[index].offset + allocSize;
+				nodes[back].size = nodes[index].size - allocSize;
+				nodes[back].prevPhysical = index;
+				nodes[back].nextPhysical = nodes[index].nextPhysical;
+				if (nodes[index].nextPhysical != NIL) {
+					nodes[nodes[index].nextPhysical].prevPhysical = back;
+				}
+				nodes[index].nextPhysical = back;
+				nodes[index].size = allocSize;
+				insertFree(back);
+			}
+
+			nodes[index].free = false;
+			nodes[index].owner = owner;
+			usedBytes += nodes[index].size;
+			allocationCount++;
+			return index;
+		}
+
+		// A dedicated block holds a single allocation at offset 0, which suits any alignment, so it
+		// is sized to the allocation and skips the search.
+		uint32_t allocateWhole(AmasAllocation* owner) {
+			if (allocationCount > 0) {
+				return NIL;
+			}
+			uint32_t index = firstNode;
+			removeFree(index);
+			nodes[index].free = false;
+			nodes[index].owner = owner;
+			usedBytes += nodes[index].size;
+			allocationCount++;
+			return index;
+		}
+
+		void free(uint32_t index) {
+			assert(!nodes[index].free && "Freeing a range that is already free");
+			usedBytes -= nodes[index].size;
+			allocationCount--;
+			nodes[index].free = true;
+			nodes[index].owner = nullptr;
+
+			uint32_t next = nodes[index].nextPhysical;
+			if (next != NIL && nodes[next].free) {
+				removeFree(next);
+				absorbNext(index);
+			}
+
+			uint32_t prev = nodes[index].prevPhysical;
+			if (prev != NIL && nodes[prev].free) {
+				removeFree(prev);
+				absorbNext(prev);
+				index = prev;
+			}
+
+			insertFree(index);
+		}
+
+		const Node& node(uint32_t index) const { return nodes[index]; }
+		uint32_t getFirstNode() const { return firstNode; }
+		bool empty() const { return allocationCount == 0; }
+
+		VkDeviceMemory memory;
+		VkDeviceSize size;
+		uint32_t memoryTypeIndex;
+		bool dedicated;
+
+		void* mapped = nullptr;
+		uint32_t mapCount = 0;
+		uint32_t allocationCount = 0;
+		VkDeviceSize usedBytes = 0;
+
+	private:
+		// 16 second level lists per power of two, ranges below 256 bytes share the first level
+		static constexpr uint32_t SL_LOG2 = 4;
+		static constexpr uint32_t SL_COUNT = 1u << SL_LOG2;
+		static constexpr uint32_t SMALL_LOG2 = 8;
+		static constexpr uint32_t FL_COUNT = 64 - SMALL_LOG2 + 1;
+		static constexpr VkDeviceSize MIN_SPLIT_SIZE = 16;
+
+		static uint32_t log2Floor(VkDeviceSize value) { return static_cast<uint32_t>(std::bit_width(value)) - 1; }
+
+		static void mapping(VkDeviceSize value, uint32_t& fl, uint32_t& sl) {
+			if (value < (1ull << SMALL_LOG2)) {
+				fl = 0;
+				sl = static_cast<uint32_t>(value >> (SMALL_LOG2 - SL_LOG2));
+			}
+			else {
+				uint32_t f = log2Floor(value);
+				fl = f - SMALL_LOG2 + 1;
+				sl = static_cast<uint32_t>(value >> (f - SL_LOG2)) ^ SL_COUNT;
+			}
+		}
+
+		// rounds up so every range in the resulting list is large enough
+		static VkDeviceSize roundUpForSearch(VkDeviceSize value) {
+			if (value < (1ull << SMALL_LOG2)) {
+				return value + (1ull << (SMALL_LOG2 - SL_LOG2)) - 1;
+			}
+			return value + (1ull << (log2Floor(value) - SL_LOG2)) - 1;
+		}
+
+		uint32_t findFree(uint32_t fl, uint32_t sl) const {
+			if (fl >= FL_COUNT) {
+				return NIL;
+			}
+			uint32_t slMap = slBitmaps[fl] & (~0u << sl);
+			if (slMap == 0) {
+				uint64_t flMap = flBitmap & (~0ull << (fl + 1));
+				if (flMap == 0) {
+					return NIL;
+				}
+				fl = static_cast<uint32_t>(std::countr_zero(flMap));
+				slMap = slBitmaps[fl];
+			}
+			sl = static_cast<uint32_t>(std::countr_zero(slMap));
+			return freeHeads[fl][sl];
+		}
+
+		void insertFree(uint32_t index) {
+			uint32_t fl, sl;
+			mapping(nodes[index].size, fl, sl);
+			nodes[index].prevFree = NIL;
+			nodes[index].nextFree = freeHeads[fl][sl];
+			if (freeHeads[fl][sl] != NIL) {
+				nodes[freeHeads[fl][sl]].prevFree = index;
+			}
+			freeHeads[fl][sl] = index;
+			flBitmap |= 1ull << fl;
+			slBitmaps[fl] |= 1u << sl;
+		}
+
+		void removeFree(uint32_t index) {
+			uint32_t fl, sl;
+			mapping(nodes[index].size, fl, sl);
+			Node& n = nodes[index];
+			if (n.prevFree != NIL) {
+				nodes[n.prevFree].nextFree = n.nextFree;
+			}
+			else {
+				freeHeads[fl][sl] = n.nextFree;
+			}
+			if (n.nextFree != NIL) {
+				nodes[n.nextFree].prevFree = n.prevFree;
+			}
+			n.prevFree = n.nextFree = NIL;
+
+			if (freeHeads[fl][sl] == NIL) {
+				slBitmaps[fl] &= ~(1u << sl);
+				if (slBitmaps[fl] == 0) {
+					flBitmap &= ~(1ull << fl);
+				}
+			}
+		}
+
+		void absorbNext(uint32_t index) {
+			uint32_t next = nodes[index].nextPhysical;
+			nodes[index].size += nodes[next].size;
+			nodes[index].nextPhysical = nodes[next].nextPhysical;
+			if (nodes[next].nextPhysical != NIL) {
+				nodes[nodes[next].nextPhysical].prevPhysical = index;
+			}
+			releaseNode(next);
+		}
+
+		uint32_t newNode() {
+			if (!unusedNodes.empty()) {
+				uint32_t index = unusedNodes.back();
+				unusedNodes.pop_back();
+				nodes[index] = Node{};
+				return index;
+			}
+			nodes.emplace_back();
+			return static_cast<uint32_t>(nodes.size() - 1);
+		}
+
+		void releaseNode(uint32_t index) { unusedNodes.push_back(index); }
+
+		std::vector<Node> nodes;
+		std::vector<uint32_t> unusedNodes;
+		uint32_t firstNode = NIL;
+
+		uint64_t flBitmap = 0;
+		std::array<uint32_t, FL_COUNT> slBitmaps{};
+		std::array<std::array<uint32_t, SL_COUNT>, FL_COUNT> freeHeads;
+	};
+
+	// *************** Allocator *********************
+
+	float AmasAllocator::Stats::fragmentation() const {
+		VkDeviceSize freeBytes = bytesReserved - bytesUsed;
+		if (freeBytes == 0) {
+			return 0.f;
+		}
+		return 1.f - static_cast<float>(largestFreeRange) / static_cast<float>(freeBytes);
+	}
+
+	AmasAllocator::AmasAllocator(
+		VkDevice device,
+		VkPhysicalDevice physicalDevice,
+		VkDeviceSize preferredBlockSize)
+		: device{ device }, preferredBlockSize{ preferredBlockSize } {
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		bufferImageGranularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+		nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+		maxMemoryAllocationCount = properties.limits.maxMemoryAllocationCount;
+	}
+
+	AmasAllocator::~AmasAllocator() {
+		for (auto& pool : pools) {
+			for (auto& block : pool.blocks) {
+				assert(block->empty() && "Destroying allocator with live allocations");
+				if (block->mapped) {
+					vkUnmapMemory(device, block->memory);
+				}
+				vkFreeMemory(device, block->memory, nullptr);
+			}
+		}
+	}
+
+	AmasAllocator::Pool& AmasAllocator::poolFor(uint32_t memoryTypeIndex, bool linear) {
+		// with a granularity of 1 buffers and optimal images can share pages safely
+		bool separate = bufferImageGranularity > 1 && !linear;
+		return pools[memoryTypeIndex * 2 + (separate ? 1 : 0)];
+	}
+
+	VkDeviceSize AmasAllocator::blockSizeFor(uint32_t memoryTypeIndex) const {
+		uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+		VkDeviceSize heapSize = memoryProperties.memoryHeaps[heapIndex].size;
+
+		// small heaps (integrated GPUs, BAR memory) get proportionally smaller blocks
+		if (heapSize <= 1024ull * 1024 * 1024) {
+			return std::min(preferredBlockSize, alignUp(heapSize / 8, 32));
+		}
+		return preferredBlockSize;
+	}
+
+	AmasMemoryBlock* AmasAllocator::createBlock(uint32_t memoryTypeIndex, VkDeviceSize minSize, bool dedicated) {
+		if (deviceMemoryCount >= maxMemoryAllocationCount) {
+			throw std::runtime_error("exceeded maxMemoryAllocationCount!");
+		}
+
+		VkDeviceSize blockSize = dedicated ? minSize : std::max(blockSizeFor(memoryTypeIndex), minSize);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+		// retry with smaller blocks before giving up, the heap may just be too full for a whole one
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		while (true) {
+			allocInfo.allocationSize = blockSize;
+			if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) == VK_SUCCESS) {
+				break;
+			}
+			if (blockSize / 2 < minSize) {
+				throw std::runtime_error("failed to allocate device memory block!");
+			}
+			blockSize /= 2;
+		}
+
+		deviceMemoryCount++;
+		return new AmasMemoryBlock(memory, blockSize, memoryTypeIndex, dedicated);
+	}
+
+	void AmasAllocator::destroyBlock(Pool& pool, AmasMemoryBlock* block) {
+		if (block->mapped) {
+			vkUnmapMemory(device, block->memory);
+		}
+		vkFreeMemory(device, block->memory, nullptr);
+		deviceMemoryCount--;
+
+		pool.blocks.erase(std::find_if(pool.blocks.begin(), pool.blocks.end(), [block](const auto& b) {
+			return b.get() == block;
+		}));
+	}
+
+	AmasAllocation* AmasAllocator::allocate(
+		const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, bool linear) {
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+		VkDeviceSize size = requirements.size;
+
+		// keep non-coherent ranges atom aligned so flushes never touch a neighbour
+		VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+		if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+			alignment = std::max(alignment, nonCoherentAtomSize);
+			size = alignUp(size, nonCoherentAtomSize);
+		}
+
+		auto allocation = std::make_unique<AmasAllocation>();
+		allocation->size = requirements.size;
+		allocation->memoryTypeIndex = memoryTypeIndex;
+		allocation->linear = linear;
+		allocation->alignment = alignment;
+
+		Pool& pool = poolFor(memoryTypeIndex, linear);
+		AmasMemoryBlock* block = nullptr;
+		uint32_t node = AmasMemoryBlock::NIL;
+
+		if (size > blockSizeFor(memoryTypeIndex) / 2) {
+			block = createBlock(memoryTypeIndex, size, true);
+			pool.blocks.emplace_back(block);
+			node = block->allocateWhole(allocation.get());
+		}
+		else {
+			for (auto& candidate : pool.blocks) {
+				if (candidate->dedicated) continue;
+				node = candidate->allocate(size, alignment, allocation.get());
+				if (node != AmasMemoryBlock::NIL) {
+					block = candidate.get();
+					break;
+				}
+			}
+			if (block == nullptr) {
+				// large enough for the search even when the heap only has room for a smaller block
+				block = createBlock(memoryTypeIndex, AmasMemoryBlock::searchSize(size, alignment), false);
+				pool.blocks.emplace_back(block);
+				node = block->allocate(size, alignment, allocation.get());
+			}
+		}
+		if (node == AmasMemoryBlock::NIL) {
+			throw std::runtime_error("fresh memory block could not satisfy allocation!");
+		}
+
+		allocation->block = block;
+		allocation->node = node;
+		allocation->memory = block->memory;
+		allocation->offset = block->node(node).offset;
+		return allocation.release();
+	}
+
+	void AmasAllocator::free(AmasAllocation* allocation) {
+		if (allocation == nullptr) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		AmasMemoryBlock* block = allocation->block;
+		assert(allocation->mapCount == 0 && "Freeing an allocation that is still mapped");
+		block->free(allocation->node);
+
+		if (block->empty()) {
+			Pool& pool = poolFor(allocation->memoryTypeIndex, allocation->linear);
+
+			// keep a single empty block around so streaming does not thrash vkAllocateMemory
+			bool keep = !block->dedicated &&
+				std::none_of(pool.blocks.begin(), pool.blocks.end(), [block](const auto& b) {
+					return b.get() != block && !b->dedicated && b->empty();
+				});
+			if (!keep) {
+				destroyBlock(pool, block);
+			}
+		}
+
+		delete allocation;
+	}
+
+	VkResult AmasAllocator::map(AmasAllocation* allocation, void** data) {
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		// blocks are mapped whole and stay mapped while any allocation in them is
+		AmasMemoryBlock* block = allocation->block;
+		if (block->mapCount == 0) {
+			VkResult result = vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+			if (result != VK_SUCCESS) {
+				return result;
+			}
+		}
+		block->mapCount++;
+		allocation->mapCount++;
+		*data = static_cast<char*>(block->mapped) + allocation->offset;
+		return VK_SUCCESS;
+	}
+
+	void AmasAllocator::unmap(AmasAllocation* allocation) {
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		assert(allocation->mapCount > 0 && "Unmapping an allocation that is not mapped");
+		AmasMemoryBlock* block = allocation->block;
+		allocation->mapCount--;
+		if (--block->mapCount == 0) {
+			vkUnmapMemory(device, block->memory);
+			block->mapped = nullptr;
+		}
+	}
+
+	VkMappedMemoryRange AmasAllocator::mappedRange(
+		const AmasAllocation* allocation, VkDeviceSize size, VkDeviceSize offset) const {
+		if (size == VK_WHOLE_SIZE) {
+			size = allocation->size - offset;
+		}
+
+		VkDeviceSize begin = alignDown(allocation->offset + offset, nonCoherentAtomSize);
+		VkDeviceSize end = std::min(
+			alignUp(allocation->offset + offset + size, nonCoherentAtomSize),
+			allocation->block->size);
+
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = allocation->memory;
+		range.offset = begin;
+		range.size = end - begin;
+		return range;
+	}
+
+	VkResult AmasAllocator::flush(const AmasAllocation* allocation, VkDeviceSize size, VkDeviceSize offset) {
+		VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+		return vkFlushMappedMemoryRanges(device, 1, &range);
+	}
+
+	VkResult AmasAllocator::invalidate(const AmasAllocation* allocation, VkDeviceSize size, VkDeviceSize offset) {
+		VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+		return vkInvalidateMappedMemoryRanges(device, 1, &range);
+	}
+
+	std::vector<AmasAllocator::DefragmentationMove> AmasAllocator::beginDefragmentation(
+		uint32_t memoryTypeIndex, uint32_t maxMoves) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		std::vector<DefragmentationMove> moves;
+
+		for (uint32_t kind = 0; kind < 2; kind++) {
+			Pool& pool = pools[memoryTypeIndex * 2 + kind];
+
+			// empty out the least used block by moving its ranges into the others
+			AmasMemoryBlock* source = nullptr;
+			for (auto& block : pool.blocks) {
+				if (block->dedicated || block->empty()) continue;
+				if (source == nullptr || block->usedBytes < source->usedBytes) {
+					source = block.get();
+				}
+			}
+			if (source == nullptr) continue;
+
+			for (uint32_t i = source->getFirstNode(); i != AmasMemoryBlock::NIL; i = source->node(i).nextPhysical) {
+				if (moves.size() >= maxMoves) break;
+
+				const auto& node = source->node(i);
+				if (node.free || node.owner->mapCount > 0 || node.owner->userData == nullptr) continue;
+
+				for (auto& block : pool.blocks) {
+					if (block.get() == source || block->dedicated) continue;
+					uint32_t dstNode = block->allocate(node.size, node.owner->alignment, node.owner);
+					if (dstNode == AmasMemoryBlock::NIL) continue;
+
+					DefragmentationMove move{};
+					move.allocation = node.owner;
+					move.dstMemory = block->memory;
+					move.dstOffset = block->node(dstNode).offset;
+					move.dstBlock = block.get();
+					move.dstNode = dstNode;
+					moves.push_back(move);
+					break;
+				}
+			}
+		}
+		return moves;
+	}
+
+	void AmasAllocator::endDefragmentation(const std::vector<DefragmentationMove>& moves) {
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		for (auto& move : moves) {
+			AmasAllocation* allocation = move.allocation;
+			AmasMemoryBlock* source = allocation->block;
+			source->free(allocation->node);
+
+			allocation->block = move.dstBlock;
+			allocation->node = move.dstNode;
+			allocation->memory = move.dstMemory;
+			allocation->offset = move.dstOffset;
+
+			if (source->empty()) {
+				destroyBlock(poolFor(allocation->memoryTypeIndex, allocation->linear), source);
+			}
+		}
+	}
+
+	void AmasAllocator::cancelDefragmentation(const std::vector<DefragmentationMove>& moves) {
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		// the allocations stay where they are, only the reserved destinations are released
+		for (auto& move : moves) {
+			move.dstBlock->free(move.dstNode);
+		}
+	}
+
+	void AmasAllocator::accumulateStats(const Pool& pool, Stats& stats) const {
+		for (auto& block : pool.blocks) {
+			stats.blockCount++;
+			if (block->dedicated) {
+				stats.dedicatedBlockCount++;
+			}
+			stats.allocationCount += block->allocationCount;
+			stats.bytesReserved += block->size;
+			stats.bytesUsed += block->usedBytes;
+
+			for (uint32_t i = block->getFirstNode(); i != AmasMemoryBlock::NIL; i = block->node(i).nextPhysical) {
+				const auto& node = block->node(i);
+				if (!node.free) continue;
+				stats.freeRangeCount++;
+				stats.largestFreeRange = std::max(stats.largestFreeRange, node.size);
+			}
+		}
+	}
+
+	AmasAllocator::Stats AmasAllocator::getStats() const {
+		std::lock_guard<std::mutex> lock{ mutex };
+		Stats stats{};
+		for (auto& pool : pools) {
+			accumulateStats(pool, stats);
+		}
+		return stats;
+	}
+
+	AmasAllocator::Stats AmasAllocator::getStats(uint32_t memoryTypeIndex) const {
+		std::lock_guard<std::mutex> lock{ mutex };
+		Stats stats{};
+		accumulateStats(pools[memoryTypeIndex * 2], stats);
+		accumulateStats(pools[memoryTypeIndex * 2 + 1], stats);
+		return stats;
+	}
+
+	void AmasAllocator::printStats(std::ostream& out) const {
+		constexpr double MiB = 1024.0 * 1024.0;
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			Stats stats = getStats(i);
+			if (stats.blockCount == 0) continue;
+			out << "memory type " << i << ": "
+				<< stats.blockCount << " blocks (" << stats.dedicatedBlockCount << " dedicated), "
+				<< stats.allocationCount << " allocations, "
+				<< stats.bytesUsed / MiB << " / " << stats.bytesReserved / MiB << " MiB used, "
+				<< "fragmentation " << stats.fragmentation() << "\n";
+		}
+	}
+
+}  // namespace amas
@@ -0,0 +1,180 @@
+#include "../include/amas_asset_loader.hpp"
+#include "../include/amas_block_compression.hpp"
+
+// std
+#include <exception>
+#include <utility>
+
+namespace amas {
+
+	// unit cube shown in place of models that are still loading
+	static AmasModel::Builder placeholderCube() {
+		const glm::vec3 normals[6] = {
+			{ 1.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f },
+			{ 0.f, -1.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 0.f, -1.f } };
+
+		AmasModel::Builder builder{};
+		for (const auto& normal : normals) {
+			// two axes spanning the face, ordered so the corners wind the same way on every face
+			const glm::vec3 tangent = glm::abs(normal.y) > .5f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+			const glm::vec3 bitangent = glm::cross(normal, tangent);
+			const uint32_t first = static_cast<uint32_t>(builder.vertices.size());
+			const glm::vec2 corners[4] = { { -1.f, -1.f }, { 1.f, -1.f }, { 1.f, 1.f }, { -1.f, 1.f } };
+			for (const auto& corner : corners) {
+				AmasModel::Vertex vertex{};
+				vertex.position = .5f * (normal + corner.x * tangent + corner.y * bitangent);
+				vertex.color = glm::vec3(.5f);
+				vertex.normal = normal;
+				vertex.uv = corner * .5f + .5f;
+				builder.vertices.push_back(vertex);
+			}
+			for (uint32_t index : { 0u, 1u, 2u, 0u, 2u, 3u }) {
+				builder.indices.push_back(first + index);
+			}
+		}
+		return builder;
+	}
+
+	AmasAssetLoader::AmasAssetLoader(AmasDevice& device, AmasJobSystem& jobSystem)
+		: amasDevice{ device }, jobSystem{ jobSystem } {
+		placeholderModel = std::make_shared<AmasModel>(amasDevice, placeholderCube());
+		placeholderTexture = std::make_shared<AmasTexture>(amasDevice, AmasTexture::Pixels::solidColor(255, 255, 255, 255));
+	}
+
+	AmasAssetLoader::~AmasAssetLoader() {
+		// the decode jobs write into this loader
+		try {
+			jobSystem.wait(decodeJobs);
+		}
+		catch (...) {
+		}
+	}
+
+	void AmasAssetLoader::decodeAsync(std::function<std::function<void()>()> decode) {
+		pendingCount++;
+		// a whole file is parsed or decoded, kept out of the frame's waits
+		jobSystem.submitBackground(
+			[this, decode = std::move(decode)] {
+				std::function<void()> finish;
+				try {
+					finish = decode();
+				}
+				catch (...) {
+					// reported on the main thread, the same way a synchronous load would fail
+					finish = [error = std::current_exception()] { std::rethrow_exception(error); };
+				}
+				std::lock_guard<std::mutex> lock{ decodedMutex };
+				decoded.push_back(std::move(finish));
+			},
+			&decodeJobs);
+	}
+
+	AmasAssetHandle<AmasModel> AmasAssetLoader::loadModel(const std::string& filepath) {
+		auto handle = std::make_shared<AmasAsset<AmasModel>>(filepath);
+		decodeAsync([this, handle]() -> std::function<void()> {
+			auto builder = std::make_shared<AmasModel::Builder>();
+			builder->loadModel(handle->getPath(), &jobSystem);
+			return [this, handle, builder] {
+				handle->asset = std::make_shared<AmasModel>(amasDevice, *builder);
+				handle->ready.store(true, std::memory_order_release);
+			};
+		});
+		return handle;
+	}
+
+	AmasAssetHandle<AmasTexture> AmasAssetLoader::loadTexture(const std::string& filepath) {
+		auto handle = std::make_shared<AmasAsset<AmasTexture>>(filepath);
+		decodeAsync([this, handle]() -> std::function<void()> {
+			auto pixels = std::make_shared<AmasTexture::Pixels>(AmasTexture::Pixels::loadFromFile(handle->getPath()));
+			// a block format the device cannot sample is decoded here rather than on the main thread
+			if (!AmasTexture::supportsFormat(amasDevice, pixels->format) && AmasBlockCompression::canDecompress(pixels->format)) {
+				*pixels = pixels->decompress();
+			}
+			return [this, handle, pixels] {
+				handle->asset = std::make_shared<AmasTexture>(amasDevice, *pixels);
+				handle->ready.store(true, std::memory_order_release);
+			};
+		});
+		return handle;
+	}
+
+	void AmasAssetLoader::assignModel(AmasRegistry& registry, Entity entity, const AmasAssetHandle<AmasModel>& model) {
+		const auto& current = model->isReady() ? model->get() : placeholderModel;
+		if (auto* component = registry.tryGet<ModelComponent>(entity)) {
+			component->model = current;
+		}
+		else {
+			registry.add<ModelComponent>(entity, current);
+		}
+		if (!model->isReady()) {
+			modelAssignments.push_back({ entity, model });
+		}
+	}
+
+	void AmasAssetLoader::assignTexture(AmasRegistry& registry, Entity entity, const AmasAssetHandle<AmasTexture>& texture) {
+		AmasGameObject::attachMaterial(registry, entity, texture->isReady() ? texture->get() : placeholderTexture);
+		if (!texture->isReady()) {
+			textureAssignments.push_back({ entity, texture });
+		}
+	}
+
+	bool AmasAssetLoader::update(AmasRegistry& registry, SceneBvh& sceneBvh) {
+		std::vector<std::function<void()>> finished;
+		{
+			std::lock_guard<std::mutex> lock{ decodedMutex };
+			finished.swap(decoded);
+		}
+		if (finished.empty()) {
+			return false;
+		}
+		// a failed load must not keep the others from becoming ready
+		std::exception_ptr error;
+		for (auto& finish : finished) {
+			pendingCount--;
+			try {
+				finish();
+			}
+			catch (...) {
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		}
+
+		for (size_t i = 0; i < modelAssignments.size();) {
+			auto& assignment = modelAssignments[i];
+			if (!assignment.asset->isReady()) {
+				i++;
+				continue;
+			}
+			if (auto* component = registry.tryGet<ModelComponent>(assignment.entity)) {
+				component->model = assignment.asset->get();
+				// the real bounds replace the placeholder's
+				sceneBvh.update(registry, assignment.entity);
+			}
+			assignment = std::move(modelAssignments.back());
+			modelAssignments.pop_back();
+		}
+
+		bool materialsChanged = false;
+		for (size_t i = 0; i < textureAssignments.size();) {
+			auto& assignment = textureAssignments[i];
+			if (!assignment.asset->isReady()) {
+				i++;
+				continue;
+			}
+			if (registry.isAlive(assignment.entity)) {
+				AmasGameObject::attachMaterial(registry, assignment.entity, assignment.asset->get());
+				materialsChanged = true;
+			}
+			assignment = std::move(textureAssignments.back());
+			textureAssignments.pop_back();
+		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+		return materialsChanged;
+	}
+
+}  // namespace amas
@@ -0,0 +1,371 @@
+#include "../include/amas_block_compression.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace amas {
+
+	namespace {
+
+		struct Rgba {
+			uint8_t r, g, b, a;
+		};
+
+		// 5:6:5 widened to 8 bits by repeating the high bits
+		Rgba unpack565(uint16_t color) {
+			const uint8_t r = (color >> 11) & 31;
+			const uint8_t g = (color >> 5) & 63;
+			const uint8_t b = color & 31;
+			return { static_cast<uint8_t>(r << 3 | r >> 2), static_cast<uint8_t>(g << 2 | g >> 4),
+				static_cast<uint8_t>(b << 3 | b >> 2), 255 };
+		}
+
+		Rgba mix(const Rgba& a, const Rgba& b, int weightA, int weightB, int total) {
+			return { static_cast<uint8_t>((a.r * weightA + b.r * weightB) / total),
+				static_cast<uint8_t>((a.g * weightA + b.g * weightB) / total),
+				static_cast<uint8_t>((a.b * weightA + b.b * weightB) / total), 255 };
+		}
+
+		// the color half of BC1 and BC3, BC3 always interpolates four colors
+		void decodeColorBlock(const uint8_t* block, bool allowTransparent, Rgba texels[16]) {
+			const uint16_t c0 = static_cast<uint16_t>(block[0] | block[1] << 8);
+			const uint16_t c1 = static_cast<uint16_t>(block[2] | block[3] << 8);
+			Rgba palette[4]{ unpack565(c0), unpack565(c1) };
+			if (c0 > c1 || !allowTransparent) {
+				palette[2] = mix(palette[0], palette[1], 2, 1, 3);
+				palette[3] = mix(palette[0], palette[1], 1, 2, 3);
+			} else {
+				palette[2] = mix(palette[0], palette[1], 1, 1, 2);
+				palette[3] = { 0, 0, 0, 0 };
+			}
+			uint32_t indices;
+			std::memcpy(&indices, block + 4, sizeof(indices));
+			for (int i = 0; i < 16; i++) {
+				texels[i] = palette[(indices >> (2 * i)) & 3];
+			}
+		}
+
+		void decodeAlphaBlock(const uint8_t* block, Rgba texels[16]) {
+			const int a0 = block[0];
+			const int a1 = block[1];
+			uint8_t palette[8]{ static_cast<uint8_t>(a0), static_cast<uint8_t>(a1) };
+			if (a0 > a1) {
+				for (int i = 1; i < 7; i++) palette[i + 1] = static_cast<uint8_t>(((7 - i) * a0 + i * a1) / 7);
+			} else {
+				for (int i = 1; i < 5; i++) palette[i + 1] = static_cast<uint8_t>(((5 - i) * a0 + i * a1) / 5);
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+			uint64_t indices = 0;
+			for (int i = 0; i < 6; i++) indices |= uint64_t{ block[2 + i] } << (8 * i);
+			for (int i = 0; i < 16; i++) {
+				texels[i].a = palette[(indices >> (3 * i)) & 7];
+			}
+		}
+
+		// BC7, see the BPTC section of the Khronos Data Format Specification
+
+		struct Bc7Mode {
+			int subsets;
+			int partitionBits;
+			int rotationBits;
+			int indexSelectionBits;
+			int colorBits;
+			int alphaBits;
+			int endpointPBits;
+			int sharedPBits;
+			int indexBits;
+			int secondaryIndexBits;
+		};
+
+		constexpr Bc7Mode BC7_MODES[8]{
+			{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+			{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+			{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+			{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+			{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+			{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+			{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+			{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+		};
+
+		// subset of texel i is bit i
+		constexpr uint16_t BC7_PARTITIONS_2[64]{
+			0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+			0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+			0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+			0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+			0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+			0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+			0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+			0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+		};
+
+		// subset of texel i is bits 2i and 2i + 1
+		constexpr uint32_t BC7_PARTITIONS_3[64]{
+			0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+			0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+			0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+			0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+			0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+			0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+			0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+			0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254,
+		};
+
+		// texels whose index drops its top bit, besides texel 0
+		constexpr uint8_t BC7_ANCHORS_2[64]{
+			15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+			15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+			15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+			6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15,
+		};
+		constexpr uint8_t BC7_ANCHORS_3_SECOND[64]{
+			3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+			3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+			8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+			3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3,
+		};
+		constexpr uint8_t BC7_ANCHORS_3_THIRD[64]{
+			15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+			15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+			15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+			15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8,
+		};
+
+		constexpr uint8_t BC7_WEIGHTS_2[4]{ 0, 21, 43, 64 };
+		constexpr uint8_t BC7_WEIGHTS_3[8]{ 0, 9, 18, 27, 37, 46, 55, 64 };
+		constexpr uint8_t BC7_WEIGHTS_4[16]{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		class BitReader {
+		public:
+			explicit BitReader(const uint8_t* block) : block{ block } {}
+
+			uint32_t read(int count) {
+				uint32_t value = 0;
+				for (int i = 0; i < count; i++, position++) {
+					value |= ((block[position >> 3] >> (position & 7)) & 1u) << i;
+				}
+				return value;
+			}
+
+		private:
+			const uint8_t* block;
+			int position = 0;
+		};
+
+		uint8_t interpolate(uint8_t e0, uint8_t e1, int indexBits, uint32_t index) {
+			const int weight = indexBits == 2 ? BC7_WEIGHTS_2[index] : indexBits == 3 ? BC7_WEIGHTS_3[index] : BC7_WEIGHTS_4[index];
+			return static_cast<uint8_t>(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+		}
+
+		void decodeBc7Block(const uint8_t* block, Rgba texels[16]) {
+			int modeIndex = 0;
+			while (modeIndex < 8 && !(block[0] & (1 << modeIndex))) modeIndex++;
+			if (modeIndex == 8) {
+				// reserved mode, decodes to transparent black
+				std::fill(texels, texels + 16, Rgba{ 0, 0, 0, 0 });
+				return;
+			}
+			const Bc7Mode& mode = BC7_MODES[modeIndex];
+
+			BitReader bits{ block };
+			bits.read(modeIndex + 1);
+			const uint32_t partition = bits.read(mode.partitionBits);
+			const uint32_t rotation = bits.read(mode.rotationBits);
+			const uint32_t indexSelection = bits.read(mode.indexSelectionBits);
+
+			const int endpointCount = mode.subsets * 2;
+			uint8_t endpoints[6][4]{};
+			for (int channel = 0; channel < 3; channel++) {
+				for (int e = 0; e < endpointCount; e++) endpoints[e][channel] = static_cast<uint8_t>(bits.read(mode.colorBits));
+			}
+			for (int e = 0; e < endpointCount && mode.alphaBits > 0; e++) {
+				endpoints[e][3] = static_cast<uint8_t>(bits.read(mode.alphaBits));
+			}
+
+			// p-bits extend every channel of their endpoint by one low bit
+			int colorBits = mode.colorBits;
+			int alphaBits = mode.alphaBits;
+			if (mode.endpointPBits || mode.sharedPBits) {
+				uint32_t pBits[6]{};
+				for (int e = 0; e < endpointCount; e++) {
+					pBits[e] = mode.endpointPBits ? bits.read(1) : (e % 2 == 0 ? bits.read(1) : pBits[e - 1]);
+				}
+				for (int e = 0; e < endpointCount; e++) {
+					for (int channel = 0; channel < 4; channel++) {
+						endpoints[e][channel] = static_cast<uint8_t>(endpoints[e][channel] << 1 | pBits[e]);
+					}
+				}
+				colorBits++;
+				if (alphaBits > 0) alphaBits++;
+			}
+			for (int e = 0; e < endpointCount; e++) {
+				for (int channel = 0; channel < 4; channel++) {
+					const int channelBits = channel < 3 ? colorBits : alphaBits;
+					if (channelBits == 0) {
+						endpoints[e][channel] = 255;
+						continue;
+					}
+					const uint32_t value = static_cast<uint32_t>(endpoints[e][channel]) << (8 - channelBits);
+					endpoints[e][channel] = static_cast<uint8_t>(value | value >> channelBits);
+				}
+			}
+
+			auto subsetOf = [&](int texel) -> uint32_t {
+				if (mode.subsets == 2) return (BC7_PARTITIONS_2[partition] >> texel) & 1;
+				if (mode.subsets == 3) return (BC7_PARTITIONS_3[partition] >> (2 * texel)) & 3;
+				return 0;
+			};
+			auto isAnchor = [&](int texel) {
+				if (texel == 0) return true;
+				if (mode.subsets == 2) return texel == BC7_ANCHORS_2[partition];
+				if (mode.subsets == 3) return texel == BC7_ANCHORS_3_SECOND[partition] || texel == BC7_ANCHORS_3_THIRD[partition];
+				return false;
+			};
+
+			uint32_t indices[16];
+			uint32_t secondaryIndices[16]{};
+			for (int i = 0; i < 16; i++) indices[i] = bits.read(mode.indexBits - (isAnchor(i) ? 1 : 0));
+			for (int i = 0; i < 16 && mode.secondaryIndexBits > 0; i++) {
+				secondaryIndices[i] = bits.read(mode.secondaryIndexBits - (i == 0 ? 1 : 0));
+			}
+
+			for (int i = 0; i < 16; i++) {
+				const uint8_t* e0 = endpoints[2 * subsetOf(i)];
+				const uint8_t* e1 = endpoints[2 * subsetOf(i) + 1];
+				int colorIndexBits = mode.indexBits;
+				int alphaIndexBits = mode.indexBits;
+				uint32_t colorIndex = indices[i];
+				uint32_t alphaIndex = indices[i];
+				if (mode.secondaryIndexBits > 0) {
+					alphaIndexBits = mode.secondaryIndexBits;
+					alphaIndex = secondaryIndices[i];
+					if (indexSelection) {
+						std::swap(colorIndexBits, alphaIndexBits);
+						std::swap(colorIndex, alphaIndex);
+					}
+				}
+
+				Rgba texel{
+					interpolate(e0[0], e1[0], colorIndexBits, colorIndex),
+					interpolate(e0[1], e1[1], colorIndexBits, colorIndex),
+					interpolate(e0[2], e1[2], colorIndexBits, colorIndex),
+					interpolate(e0[3], e1[3], alphaIndexBits, alphaIndex),
+				};
+				if (rotation == 1) std::swap(texel.a, texel.r);
+				if (rotation == 2) std::swap(texel.a, texel.g);
+				if (rotation == 3) std::swap(texel.a, texel.b);
+				texels[i] = texel;
+			}
+		}
+
+	}  // namespace
+
+	bool AmasBlockCompression::getFormatInfo(VkFormat format, FormatInfo& info) {
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			info = { 1, 1, 4 };
+			return true;
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+			info = { 4, 4, 8 };
+			return true;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+			info = { 4, 4, 16 };
+			return true;
+		case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+			info = { 6, 6, 16 };
+			return true;
+		case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+			info = { 8, 8, 16 };
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	uint64_t AmasBlockCompression::levelSize(const FormatInfo& info, uint32_t width, uint32_t height) {
+		const uint64_t blocksWide = (width + info.blockWidth - 1) / info.blockWidth;
+		const uint64_t blocksHigh = (height + info.blockHeight - 1) / info.blockHeight;
+		return blocksWide * blocksHigh * info.blockSize;
+	}
+
+	bool AmasBlockCompression::canDecompress(VkFormat format) {
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	VkFormat AmasBlockCompression::decompressedFormat(VkFormat format) {
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return VK_FORMAT_R8G8B8A8_SRGB;
+		default:
+			return VK_FORMAT_R8G8B8A8_UNORM;
+		}
+	}
+
+	void AmasBlockCompression::decompress(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba) {
+		FormatInfo info{};
+		getFormatInfo(format, info);
+		const bool rgbOnly = format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+
+		Rgba texels[16];
+		for (uint32_t by = 0; by < height; by += 4) {
+			for (uint32_t bx = 0; bx < width; bx += 4, blocks += info.blockSize) {
+				switch (format) {
+				case VK_FORMAT_BC3_UNORM_BLOCK:
+				case VK_FORMAT_BC3_SRGB_BLOCK:
+					decodeColorBlock(blocks + 8, false, texels);
+					decodeAlphaBlock(blocks, texels);
+					break;
+				case VK_FORMAT_BC7_UNORM_BLOCK:
+				case VK_FORMAT_BC7_SRGB_BLOCK:
+					decodeBc7Block(blocks, texels);
+					break;
+				default:
+					decodeColorBlock(blocks, true, texels);
+					// the transparent texels of a color-only block read as opaque black
+					if (rgbOnly) {
+						for (auto& texel : texels) texel.a = 255;
+					}
+					break;
+				}
+
+				// blocks along the right and bottom edges reach past the level
+				for (uint32_t y = 0; y < 4 && by + y < height; y++) {
+					for (uint32_t x = 0; x < 4 && bx + x < width; x++) {
+						std::memcpy(rgba + ((by + y) * size_t{ width } + bx + x) * 4, &texels[y * 4 + x], 4);
+					}
+				}
+			}
+		}
+	}
+
+}  // namespace amas
@@ -43,27 +43,33 @@ namespace amas {
 		memoryPropertyFlags{ memoryPropertyFlags } {
 		alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
 		bufferSize = alignmentSize * instanceCount;
-		device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+		device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, allocation, this);
 	}
 
 	AmasBuffer::~AmasBuffer() {
 		unmap();
 		vkDestroyBuffer(amasDevice.device(), buffer, nullptr);
-		vkFreeMemory(amasDevice.device(), memory, nullptr);
+		amasDevice.getAllocator().free(allocation);
 	}
 
 	/**
-	 * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
+	 * Map this buffer. If successful, mapped points to the buffer at offset.
+	 *
+	 * @note The allocator keeps the whole backing block mapped, so the rest of the buffer is
+	 * mapped as well
 	 *
-	 * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
-	 * buffer range.
 	 * @param offset (Optional) Byte offset from beginning
 	 *
 	 * @return VkResult of the buffer mapping call
 	 */
-	VkResult AmasBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
-		assert(buffer && memory && "Called map on buffer before create");
-		return vkMapMemory(amasDevice.device(), memory, offset, size, 0, &mapped);
+	VkResult AmasBuffer::map(VkDeviceSize offset) {
+		assert(buffer && allocation && "Called map on buffer before create");
+		void* data = nullptr;
+		VkResult result = amasDevice.getAllocator().map(allocation, &data);
+		if (result == VK_SUCCESS) {
+			mapped = static_cast<char*>(data) + offset;
+		}
+		return result;
 	}
 
 	/**
@@ -73,7 +79,7 @@ namespace amas {
 	 */
 	void AmasBuffer::unmap() {
 		if (mapped) {
-			vkUnmapMemory(amasDevice.device(), memory);
+			amasDevice.getAllocator().unmap(allocation);
 			mapped = nullptr;
 		}
 	}
@@ -112,12 +118,7 @@ namespace amas {
 	 * @return VkResult of the flush call
 	 */
 	VkResult AmasBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
-		return vkFlushMappedMemoryRanges(amasDevice.device(), 1, &mappedRange);
+		return amasDevice.getAllocator().flush(allocation, size, offset);
 	}
 
 	/**
@@ -132,12 +133,7 @@ namespace amas {
 	 * @return VkResult of the invalidate call
 	 */
 	VkResult AmasBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
-		return vkInvalidateMappedMemoryRanges(amasDevice.device(), 1, &mappedRange);
+		return amasDevice.getAllocator().invalidate(allocation, size, offset);
 	}
 
 	/**
@@ -0,0 +1,437 @@
+#include "../include/amas_bvh.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace amas {
+
+	bool AmasBvh::Box::contains(const Box& other) const {
+		return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+	}
+
+	bool AmasBvh::Box::overlaps(const Box& other) const {
+		return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::greaterThanEqual(max, other.min));
+	}
+
+	float AmasBvh::Box::surfaceArea() const {
+		glm::vec3 d = max - min;
+		return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	AmasBvh::Box AmasBvh::Box::merge(const Box& a, const Box& b) {
+		return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+	}
+
+	static bool sphereOverlapsBox(const glm::vec3& center, float radius, const AmasBvh::Box& box) {
+		glm::vec3 offset = center - glm::clamp(center, box.min, box.max);
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+
+	// slab test, distance is where the ray enters the box (0 when it starts inside)
+	static bool rayEntersBox(
+		const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, const AmasBvh::Box& box, float& distance) {
+		glm::vec3 t1 = (box.min - origin) * invDirection;
+		glm::vec3 t2 = (box.max - origin) * invDirection;
+		glm::vec3 tNear = glm::min(t1, t2);
+		glm::vec3 tFar = glm::max(t1, t2);
+		float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		distance = enter;
+		return enter <= exit;
+	}
+
+	AmasBvh::ProxyId AmasBvh::allocateNode() {
+		if (freeList == NULL_PROXY) {
+			nodes.emplace_back();
+			return static_cast<ProxyId>(nodes.size() - 1);
+		}
+
+		ProxyId node = freeList;
+		freeList = nodes[node].parent;
+		nodes[node] = Node{};
+		return node;
+	}
+
+	void AmasBvh::freeNode(ProxyId node) {
+		nodes[node] = Node{};
+		nodes[node].parent = freeList;
+		freeList = node;
+	}
+
+	AmasBvh::ProxyId AmasBvh::insert(const Box& box, uint32_t objectId) {
+		ProxyId leaf = allocateNode();
+		auto& node = nodes[leaf];
+		node.tightBox = box;
+		node.box = { box.min - glm::vec3(FAT_MARGIN), box.max + glm::vec3(FAT_MARGIN) };
+		node.height = 0;
+		node.objectId = objectId;
+
+		insertLeaf(leaf);
+		proxyCount++;
+		return leaf;
+	}
+
+	void AmasBvh::remove(ProxyId proxy) {
+		assert(proxy >= 0 && static_cast<size_t>(proxy) < nodes.size() && nodes[proxy].isLeaf() && "Invalid bvh proxy");
+		removeLeaf(proxy);
+		freeNode(proxy);
+		proxyCount--;
+	}
+
+	bool AmasBvh::move(ProxyId proxy, const Box& box) {
+		assert(proxy >= 0 && static_cast<size_t>(proxy) < nodes.size() && nodes[proxy].isLeaf() && "Invalid bvh proxy");
+		nodes[proxy].tightBox = box;
+		if (nodes[proxy].box.contains(box)) {
+			return false;
+		}
+
+		removeLeaf(proxy);
+		nodes[proxy].box = { box.min - glm::vec3(FAT_MARGIN), box.max + glm::vec3(FAT_MARGIN) };
+		insertLeaf(proxy);
+		return true;
+	}
+
+	void AmasBvh::insertLeaf(ProxyId leaf) {
+		if (root == NULL_PROXY) {
+			root = leaf;
+			nodes[root].parent = NULL_PROXY;
+			return;
+		}
+
+		// Walk down towards the cheapest sibling by surface area: pairing with the current node
+		// costs its merged area, descending costs the growth of every ancestor on the way.
+		const Box leafBox = nodes[leaf].box;
+		ProxyId index = root;
+		while (!nodes[index].isLeaf()) {
+			const auto& node = nodes[index];
+			float area = node.box.surfaceArea();
+			float combinedArea = Box::merge(node.box, leafBox).surfaceArea();
+
+			float cost = 2.f * combinedArea;
+			float inheritanceCost = 2.f * (combinedArea - area);
+
+			auto descendCost = [&](ProxyId child) {
+				const auto& childBox = nodes[child].box;
+				float mergedArea = Box::merge(childBox, leafBox).surfaceArea();
+				if (nodes[child].isLeaf()) {
+					return mergedArea + inheritanceCost;
+				}
+				return mergedArea - childBox.surfaceArea() + inheritanceCost;
+			};
+			float leftCost = descendCost(node.left);
+			float rightCost = descendCost(node.right);
+
+			if (cost < leftCost && cost < rightCost) {
+				break;
+			}
+			index = leftCost < rightCost ? node.left : node.right;
+		}
+
+		ProxyId sibling = index;
+		ProxyId oldParent = nodes[sibling].parent;
+		ProxyId newParent = allocateNode();
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].box = Box::merge(leafBox, nodes[sibling].box);
+		nodes[newParent].height = nodes[sibling].height + 1;
+		nodes[newParent].left = sibling;
+		nodes[newParent].right = leaf;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+
+		if (oldParent == NULL_PROXY) {
+			root = newParent;
+		}
+		else if (nodes[oldParent].left == sibling) {
+			nodes[oldParent].left = newParent;
+		}
+		else {
+			nodes[oldParent].right = newParent;
+		}
+
+		refitAncestors(nodes[leaf].parent);
+	}
+
+	void AmasBvh::removeLeaf(ProxyId leaf) {
+		if (leaf == root) {
+			root = NULL_PROXY;
+			return;
+		}
+
+		ProxyId parent = nodes[leaf].parent;
+		ProxyId grandParent = nodes[parent].parent;
+		ProxyId sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+		// the sibling takes the parent's place
+		nodes[sibling].parent = grandParent;
+		freeNode(parent);
+		if (grandParent == NULL_PROXY) {
+			root = sibling;
+			return;
+		}
+
+		if (nodes[grandParent].left == parent) {
+			nodes[grandParent].left = sibling;
+		}
+		else {
+			nodes[grandParent].right = sibling;
+		}
+		refitAncestors(grandParent);
+	}
+
+	void AmasBvh::refitAncestors(ProxyId node) {
+		while (node != NULL_PROXY) {
+			node = balance(node);
+
+			auto& current = nodes[node];
+			const auto& left = nodes[current.left];
+			const auto& right = nodes[current.right];
+			current.height = 1 + std::max(left.height, right.height);
+			current.box = Box::merge(left.box, right.box);
+
+			node = current.parent;
+		}
+	}
+
+	AmasBvh::ProxyId AmasBvh::balance(ProxyId iA) {
+		// When the child heights of a differ by more than one, the taller child takes a's place and
+		// a adopts the shorter of that child's two subtrees.
+		Node& a = nodes[iA];
+		if (a.isLeaf() || a.height < 2) {
+			return iA;
+		}
+
+		ProxyId iB = a.left;
+		ProxyId iC = a.right;
+		Node& b = nodes[iB];
+		Node& c = nodes[iC];
+		int heightDifference = c.height - b.height;
+
+		auto replaceChild = [&](ProxyId parent, ProxyId oldChild, ProxyId newChild) {
+			if (parent == NULL_PROXY) {
+				root = newChild;
+			}
+			else if (nodes[parent].left == oldChild) {
+				nodes[parent].left = newChild;
+			}
+			else {
+				nodes[parent].right = newChild;
+			}
+		};
+
+		if (heightDifference > 1) {
+			ProxyId iF = c.left;
+			ProxyId iG = c.right;
+			Node& f = nodes[iF];
+			Node& g = nodes[iG];
+
+			c.left = iA;
+			c.parent = a.parent;
+			a.parent = iC;
+			replaceChild(c.parent, iA, iC);
+
+			if (f.height > g.height) {
+				c.right = iF;
+				a.right = iG;
+				g.parent = iA;
+				a.box = Box::merge(b.box, g.box);
+				c.box = Box::merge(a.box, f.box);
+				a.height = 1 + std::max(b.height, g.height);
+				c.height = 1 + std::max(a.height, f.height);
+			}
+			else {
+				c.right = iG;
+				a.right = iF;
+				f.parent = iA;
+				a.box = Box::merge(b.box, f.box);
+				c.box = Box::merge(a.box, g.box);
+				a.height = 1 + std::max(b.height, f.height);
+				c.height = 1 + std::max(a.height, g.height);
+			}
+			return iC;
+		}
+
+		if (heightDifference < -1) {
+			ProxyId iD = b.left;
+			ProxyId iE = b.right;
+			Node& d = nodes[iD];
+			Node& e = nodes[iE];
+
+			b.left = iA;
+			b.parent = a.parent;
+			a.parent = iB;
+			replaceChild(b.parent, iA, iB);
+
+			if (d.height > e.height) {
+				b.right = iD;
+				a.left = iE;
+				e.parent = iA;
+				a.box = Box::merge(c.box, e.box);
+				b.box = Box::merge(a.box, d.box);
+				a.height = 1 + std::max(c.height, e.height);
+				b.height = 1 + std::max(a.height, d.height);
+			}
+			else {
+				b.right = iE;
+				a.left = iD;
+				d.parent = iA;
+				a.box = Box::merge(c.box, d.box);
+				b.box = Box::merge(a.box, e.box);
+				a.height = 1 + std::max(c.height, d.height);
+				b.height = 1 + std::max(a.height, e.height);
+			}
+			return iB;
+		}
+
+		return iA;
+	}
+
+	void AmasBvh::collectLeaves(ProxyId node, std::vector<uint32_t>& result) const {
+		const auto& current = nodes[node];
+		if (current.isLeaf()) {
+			result.push_back(current.objectId);
+			return;
+		}
+		collectLeaves(current.left, result);
+		collectLeaves(current.right, result);
+	}
+
+	void AmasBvh::queryFrustum(const AmasFrustum& frustum, std::vector<uint32_t>& result) const {
+		if (root == NULL_PROXY) {
+			return;
+		}
+
+		queryStack.clear();
+		queryStack.push_back(root);
+		while (!queryStack.empty()) {
+			const auto& node = nodes[queryStack.back()];
+			ProxyId index = queryStack.back();
+			queryStack.pop_back();
+
+			if (!frustum.intersectsBox(node.box.min, node.box.max)) {
+				continue;
+			}
+			if (node.isLeaf()) {
+				if (frustum.intersectsBox(node.tightBox.min, node.tightBox.max)) {
+					result.push_back(node.objectId);
+				}
+				continue;
+			}
+			// everything below a fully enclosed node is visible, skip the remaining plane tests
+			if (frustum.containsBox(node.box.min, node.box.max)) {
+				collectLeaves(index, result);
+				continue;
+			}
+			queryStack.push_back(node.left);
+			queryStack.push_back(node.right);
+		}
+	}
+
+	void AmasBvh::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const {
+		if (root == NULL_PROXY) {
+			return;
+		}
+
+		queryStack.clear();
+		queryStack.push_back(root);
+		while (!queryStack.empty()) {
+			const auto& node = nodes[queryStack.back()];
+			queryStack.pop_back();
+
+			if (!sphereOverlapsBox(center, radius, node.box)) {
+				continue;
+			}
+			if (node.isLeaf()) {
+				if (sphereOverlapsBox(center, radius, node.tightBox)) {
+					result.push_back(node.objectId);
+				}
+				continue;
+			}
+			queryStack.push_back(node.left);
+			queryStack.push_back(node.right);
+		}
+	}
+
+	void AmasBvh::queryBox(const Box& box, std::vector<uint32_t>& result) const {
+		if (root == NULL_PROXY) {
+			return;
+		}
+
+		queryStack.clear();
+		queryStack.push_back(root);
+		while (!queryStack.empty()) {
+			const auto& node = nodes[queryStack.back()];
+			queryStack.pop_back();
+
+			if (!node.box.overlaps(box)) {
+				continue;
+			}
+			if (node.isLeaf()) {
+				if (node.tightBox.overlaps(box)) {
+					result.push_back(node.objectId);
+				}
+				continue;
+			}
+			queryStack.push_back(node.left);
+			queryStack.push_back(node.right);
+		}
+	}
+
+	bool AmasBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const {
+		if (root == NULL_PROXY) {
+			return false;
+		}
+
+		const glm::vec3 invDirection = 1.f / direction;
+		float closest = maxDistance;
+		bool found = false;
+
+		queryStack.clear();
+		queryStack.push_back(root);
+		while (!queryStack.empty()) {
+			const auto& node = nodes[queryStack.back()];
+			queryStack.pop_back();
+
+			float distance;
+			if (!rayEntersBox(origin, invDirection, closest, node.box, distance)) {
+				continue;
+			}
+			if (node.isLeaf()) {
+				if (rayEntersBox(origin, invDirection, closest, node.tightBox, distance) &&
+					(!found || distance < closest)) {
+					closest = distance;
+					hit = { node.objectId, distance };
+					found = true;
+				}
+				continue;
+			}
+
+			// visit the nearer child first so it can shrink the search distance for the other
+			float leftDistance = std::numeric_limits<float>::max();
+			float rightDistance = std::numeric_limits<float>::max();
+			bool leftHit = rayEntersBox(origin, invDirection, closest, nodes[node.left].box, leftDistance);
+			bool rightHit = rayEntersBox(origin, invDirection, closest, nodes[node.right].box, rightDistance);
+			ProxyId left = node.left;
+			ProxyId right = node.right;
+			if (leftHit && rightHit) {
+				if (leftDistance < rightDistance) {
+					queryStack.push_back(right);
+					queryStack.push_back(left);
+				}
+				else {
+					queryStack.push_back(left);
+					queryStack.push_back(right);
+				}
+			}
+			else if (leftHit) {
+				queryStack.push_back(left);
+			}
+			else if (rightHit) {
+				queryStack.push_back(right);
+			}
+		}
+		return found;
+	}
+
+}  // namespace amas
@@ -1,4 +1,6 @@
 #include "../include/amas_device.hpp"
+#include "../include/amas_geometry_pool.hpp"
+#include "../include/amas_uploader.hpp"
 
 // std headers
 #include <cstring>
@@ -55,9 +57,15 @@ namespace amas {
 		pickPhysicalDevice();
 		createLogicalDevice();
 		createCommandPool();
+		createAllocator();
+		createUploader();
+		createGeometryPool();
 	}
 
 	AmasDevice::~AmasDevice() {
+		uploader.reset();
+		geometryPool.reset();
+		allocator.reset();
 		vkDestroyCommandPool(device_, commandPool, nullptr);
 		vkDestroyDevice(device_, nullptr);
 
@@ -140,6 +148,9 @@ namespace amas {
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+		if (indices.transferFamilyHasValue) {
+			uniqueQueueFamilies.insert(indices.transferFamily);
+		}
 
 		float queuePriority = 1.0f;
 		for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -151,8 +162,25 @@ namespace amas {
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
 		VkPhysicalDeviceFeatures deviceFeatures = {};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+		deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+		optionalFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+		optionalFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+		deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+		deviceFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+		optionalFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+		optionalFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR == VK_TRUE;
+
+		std::vector<const char*> enabledExtensions = deviceExtensions;
+		if (isDeviceExtensionAvailable(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+			enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+			optionalFeatures.drawIndirectCount = true;
+		}
 
 		VkDeviceCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -161,8 +189,8 @@ namespace amas {
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
 		createInfo.pEnabledFeatures = &deviceFeatures;
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 		// might not really be necessary anymore because device specific validation layers
 		// have been deprecated
@@ -180,6 +208,22 @@ namespace amas {
 
 		vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
 		vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+		if (optionalFeatures.drawIndirectCount) {
+			cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+				vkGetDeviceProcAddr(device_, "vkCmdDrawIndexedIndirectCountKHR"));
+			optionalFeatures.drawIndirectCount = cmdDrawIndexedIndirectCount != nullptr;
+		}
+
+		// without a dedicated family uploads share the graphics queue
+		if (indices.transferFamilyHasValue) {
+			vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+			std::cout << "transfer queue family: " << indices.transferFamily << std::endl;
+		}
+		else {
+			transferQueue_ = graphicsQueue_;
+			std::cout << "transfer queue family: shared with graphics" << std::endl;
+		}
 	}
 
 	void AmasDevice::createCommandPool() {
@@ -196,6 +240,14 @@ namespace amas {
 		}
 	}
 
+	void AmasDevice::createAllocator() {
+		allocator = std::make_unique<AmasAllocator>(device_, physicalDevice);
+	}
+
+	void AmasDevice::createUploader() { uploader = std::make_unique<AmasUploader>(*this); }
+
+	void AmasDevice::createGeometryPool() { geometryPool = std::make_unique<AmasGeometryPool>(*this); }
+
 	void AmasDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
 
 	bool AmasDevice::isDeviceSuitable(VkPhysicalDevice device) {
@@ -319,6 +371,25 @@ namespace amas {
 		return requiredExtensions.empty();
 	}
 
+	bool AmasDevice::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName) {
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(
+			device,
+			nullptr,
+			&extensionCount,
+			availableExtensions.data());
+
+		for (const auto& extension : availableExtensions) {
+			if (strcmp(extension.extensionName, extensionName) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
 	QueueFamilyIndices AmasDevice::findQueueFamilies(VkPhysicalDevice device) {
 		QueueFamilyIndices indices;
 
@@ -347,6 +418,22 @@ namespace amas {
 			i++;
 		}
 
+		// a transfer-only family runs copies on the DMA engines, prefer one without compute as well
+		for (uint32_t family = 0; family < queueFamilyCount; family++) {
+			VkQueueFlags flags = queueFamilies[family].queueFlags;
+			if (queueFamilies[family].queueCount == 0 || !(flags & VK_QUEUE_TRANSFER_BIT) ||
+				(flags & VK_QUEUE_GRAPHICS_BIT)) {
+				continue;
+			}
+			if (!indices.transferFamilyHasValue || !(flags & VK_QUEUE_COMPUTE_BIT)) {
+				indices.transferFamily = family;
+				indices.transferFamilyHasValue = true;
+			}
+			if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+				break;
+			}
+		}
+
 		return indices;
 	}
 
@@ -411,7 +498,8 @@ namespace amas {
 		VkBufferUsageFlags usage,
 		VkMemoryPropertyFlags properties,
 		VkBuffer& buffer,
-		VkDeviceMemory& bufferMemory) {
+		AmasAllocation*& bufferAllocation,
+		void* owner) {
 		VkBufferCreateInfo bufferInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		bufferInfo.size = size;
@@ -425,16 +513,26 @@ namespace amas {
 		VkMemoryRequirements memRequirements;
 		vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate vertex buffer memory!");
+		try {
+			bufferAllocation = allocator->allocate(
+				memRequirements,
+				findMemoryType(memRequirements.memoryTypeBits, properties),
+				true);
 		}
+		catch (...) {
+			vkDestroyBuffer(device_, buffer, nullptr);
+			buffer = VK_NULL_HANDLE;
+			throw;
+		}
+		bufferAllocation->userData = owner;
 
-		vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+		if (vkBindBufferMemory(device_, buffer, bufferAllocation->memory, bufferAllocation->offset) != VK_SUCCESS) {
+			allocator->free(bufferAllocation);
+			bufferAllocation = nullptr;
+			vkDestroyBuffer(device_, buffer, nullptr);
+			buffer = VK_NULL_HANDLE;
+			throw std::runtime_error("failed to bind vertex buffer memory!");
+		}
 	}
 
 	VkCommandBuffer AmasDevice::beginSingleTimeCommands() {
@@ -471,22 +569,36 @@ namespace amas {
 
 	void AmasDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
 		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		copyBuffer(commandBuffer, srcBuffer, dstBuffer, size);
+		endSingleTimeCommands(commandBuffer);
+	}
 
+	void AmasDevice::copyBuffer(
+		VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
 		VkBufferCopy copyRegion{};
 		copyRegion.srcOffset = 0;  // Optional
 		copyRegion.dstOffset = 0;  // Optional
 		copyRegion.size = size;
 		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-		endSingleTimeCommands(commandBuffer);
 	}
 
 	void AmasDevice::copyBufferToImage(
 		VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) {
 		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		copyBufferToImage(commandBuffer, buffer, image, width, height, layerCount);
+		endSingleTimeCommands(commandBuffer);
+	}
 
+	void AmasDevice::copyBufferToImage(
+		VkCommandBuffer commandBuffer,
+		VkBuffer buffer,
+		VkImage image,
+		uint32_t width,
+		uint32_t height,
+		uint32_t layerCount,
+		VkDeviceSize bufferOffset) {
 		VkBufferImageCopy region{};
-		region.bufferOffset = 0;
+		region.bufferOffset = bufferOffset;
 		region.bufferRowLength = 0;
 		region.bufferImageHeight = 0;
 
@@ -505,14 +617,14 @@ namespace amas {
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1,
 			&region);
-		endSingleTimeCommands(commandBuffer);
 	}
 
 	void AmasDevice::createImageWithInfo(
 		const VkImageCreateInfo& imageInfo,
 		VkMemoryPropertyFlags properties,
 		VkImage& image,
-		VkDeviceMemory& imageMemory) {
+		AmasAllocation*& imageAllocation,
+		void* owner) {
 		if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create image!");
 		}
@@ -520,16 +632,24 @@ namespace amas {
 		VkMemoryRequirements memRequirements;
 		vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate image memory!");
+		try {
+			imageAllocation = allocator->allocate(
+				memRequirements,
+				findMemoryType(memRequirements.memoryTypeBits, properties),
+				imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
+		}
+		catch (...) {
+			vkDestroyImage(device_, image, nullptr);
+			image = VK_NULL_HANDLE;
+			throw;
 		}
+		imageAllocation->userData = owner;
 
-		if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+		if (vkBindImageMemory(device_, image, imageAllocation->memory, imageAllocation->offset) != VK_SUCCESS) {
+			allocator->free(imageAllocation);
+			imageAllocation = nullptr;
+			vkDestroyImage(device_, image, nullptr);
+			image = VK_NULL_HANDLE;
 			throw std::runtime_error("failed to bind image memory!");
 		}
 	}
@@ -0,0 +1,27 @@
+#include "../include/amas_ecs.hpp"
+
+namespace amas {
+
+	Entity AmasRegistry::create() {
+		if (!freeIndices.empty()) {
+			uint32_t index = freeIndices.back();
+			freeIndices.pop_back();
+			return { index, generations[index] };
+		}
+
+		generations.push_back(0);
+		return { static_cast<uint32_t>(generations.size() - 1), 0 };
+	}
+
+	void AmasRegistry::destroy(Entity entity) {
+		assert(isAlive(entity) && "Entity has been destroyed");
+		for (auto& componentPool : pools) {
+			if (componentPool) {
+				componentPool->remove(entity.index);
+			}
+		}
+		generations[entity.index]++;
+		freeIndices.push_back(entity.index);
+	}
+
+}  // namespace amas
@@ -0,0 +1,115 @@
+#include "../include/amas_file_system.hpp"
+#include "../include/amas_lz4.hpp"
+#include "../include/amas_pack.hpp"
+
+// std
+#include <algorithm>
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <system_error>
+
+namespace amas {
+
+	namespace {
+
+		std::shared_mutex mountMutex{};
+		// latest mounted last
+		std::vector<std::shared_ptr<const AmasPack>> mountedPacks{};
+
+		// the pack the path resolves to and its entry, null when it is not packed
+		std::shared_ptr<const AmasPack> findEntry(const std::string& path, const AmasPack::Entry*& entry) {
+			const std::string normalized = AmasPack::normalizePath(path);
+			std::shared_lock lock{ mountMutex };
+			for (auto it = mountedPacks.rbegin(); it != mountedPacks.rend(); ++it) {
+				entry = (*it)->find(normalized);
+				if (entry != nullptr) return *it;
+			}
+			return nullptr;
+		}
+
+	}  // namespace
+
+	void AmasFile::prefetch(size_t offset, size_t size) const {
+		if (mapping && offset < fileSize) mapping->prefetch(this->offset + offset, std::min(size, fileSize - offset));
+	}
+
+	void AmasFile::release(size_t offset, size_t size) const {
+		if (mapping && offset < fileSize) mapping->release(this->offset + offset, std::min(size, fileSize - offset));
+	}
+
+	bool AmasFileSystem::mount(const std::string& packPath) {
+		std::error_code error;
+		if (!std::filesystem::is_regular_file(packPath, error)) return false;
+
+		auto pack = std::make_shared<const AmasPack>(packPath);
+		std::unique_lock lock{ mountMutex };
+		mountedPacks.push_back(std::move(pack));
+		return true;
+	}
+
+	void AmasFileSystem::unmountAll() {
+		// files already opened keep their pack mapped
+		std::unique_lock lock{ mountMutex };
+		mountedPacks.clear();
+	}
+
+	bool AmasFileSystem::status(const std::string& path, uint64_t& size, int64_t& time) {
+		const AmasPack::Entry* entry = nullptr;
+		if (findEntry(path, entry)) {
+			size = entry->size;
+			time = entry->sourceTime;
+			return true;
+		}
+
+		std::error_code error;
+		size = std::filesystem::file_size(path, error);
+		if (error) return false;
+		auto writeTime = std::filesystem::last_write_time(path, error);
+		if (error) return false;
+		time = static_cast<int64_t>(writeTime.time_since_epoch().count());
+		return true;
+	}
+
+	bool AmasFileSystem::open(const std::string& path, AmasFile& file, AmasMappedFile::Access access) {
+		file = AmasFile{};
+		const AmasPack::Entry* entry = nullptr;
+		std::shared_ptr<const AmasPack> pack = findEntry(path, entry);
+		if (!pack) {
+			auto mapping = std::make_shared<AmasMappedFile>();
+			if (!mapping->open(path, access)) return false;
+			file.fileSize = mapping->size();
+			file.mapping = std::move(mapping);
+			return true;
+		}
+
+		file.fileSize = static_cast<size_t>(entry->size);
+		if (entry->compression == AmasPack::Compression::LZ4) {
+			pack->getMapping()->prefetch(entry->offset, entry->storedSize);
+			file.decompressed.resize(file.fileSize);
+			if (!AmasLz4::decompress(
+				pack->getMapping()->data() + entry->offset, entry->storedSize, file.decompressed.data(), file.fileSize)) {
+				throw std::runtime_error("corrupt pack entry: " + path);
+			}
+			// the compressed pages are not read again
+			pack->getMapping()->release(entry->offset, entry->storedSize);
+			return true;
+		}
+
+		// the pack as a whole is not read ahead, a sequential read asks for its range
+		file.mapping = pack->getMapping();
+		file.offset = static_cast<size_t>(entry->offset);
+		if (access == AmasMappedFile::Access::SEQUENTIAL) file.prefetch(0, file.fileSize);
+		return true;
+	}
+
+	AmasFile AmasFileSystem::open(const std::string& path, AmasMappedFile::Access access) {
+		AmasFile file{};
+		if (!open(path, file, access)) {
+			throw std::runtime_error("failed to open file: " + path);
+		}
+		return file;
+	}
+
+}  // namespace amas
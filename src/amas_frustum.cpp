@@ -0,0 +1,108 @@
+#include "../include/amas_frustum.hpp"
+
+namespace amas {
+
+	AmasFrustum AmasFrustum::fromMatrix(const glm::mat4& viewProjection) {
+		// glm is column major, the transpose hands us the rows of the clip transform
+		const glm::mat4 m = glm::transpose(viewProjection);
+
+		AmasFrustum frustum{};
+		frustum.planes[PLANE_LEFT] = m[3] + m[0];
+		frustum.planes[PLANE_RIGHT] = m[3] - m[0];
+		frustum.planes[PLANE_BOTTOM] = m[3] + m[1];
+		frustum.planes[PLANE_TOP] = m[3] - m[1];
+		frustum.planes[PLANE_NEAR] = m[2];
+		frustum.planes[PLANE_FAR] = m[3] - m[2];
+		for (auto& plane : frustum.planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+	}
+
+	bool AmasFrustum::intersectsSphere(const glm::vec3& center, float radius) const {
+		for (const auto& plane : planes) {
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool AmasFrustum::intersectsBox(const glm::vec3& min, const glm::vec3& max) const {
+		for (const auto& plane : planes) {
+			// the corner furthest along the plane normal decides whether the whole box is outside
+			glm::vec3 positive{
+				plane.x >= 0.f ? max.x : min.x,
+				plane.y >= 0.f ? max.y : min.y,
+				plane.z >= 0.f ? max.z : min.z };
+			if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool AmasFrustum::containsBox(const glm::vec3& min, const glm::vec3& max) const {
+		for (const auto& plane : planes) {
+			// the corner least along the plane normal has to be inside as well
+			glm::vec3 negative{
+				plane.x >= 0.f ? min.x : max.x,
+				plane.y >= 0.f ? min.y : max.y,
+				plane.z >= 0.f ? min.z : max.z };
+			if (glm::dot(glm::vec3(plane), negative) + plane.w < 0.f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void AmasSphereBatch::clear() {
+		centerX.clear();
+		centerY.clear();
+		centerZ.clear();
+		radii.clear();
+	}
+
+	void AmasSphereBatch::reserve(size_t count) {
+		centerX.reserve(count);
+		centerY.reserve(count);
+		centerZ.reserve(count);
+		radii.reserve(count);
+	}
+
+	void AmasSphereBatch::add(const glm::vec3& center, float radius) {
+		centerX.push_back(center.x);
+		centerY.push_back(center.y);
+		centerZ.push_back(center.z);
+		radii.push_back(radius);
+	}
+
+	uint32_t AmasSphereBatch::cull(const AmasFrustum& frustum, std::vector<uint8_t>& visible) const {
+		const size_t count = radii.size();
+		visible.assign(count, 1);
+
+		const float* x = centerX.data();
+		const float* y = centerY.data();
+		const float* z = centerZ.data();
+		const float* r = radii.data();
+		uint8_t* out = visible.data();
+
+		// one plane at a time over the whole batch keeps the inner loop branch free
+		for (const auto& plane : frustum.planes) {
+			const float nx = plane.x;
+			const float ny = plane.y;
+			const float nz = plane.z;
+			const float d = plane.w;
+			for (size_t i = 0; i < count; i++) {
+				out[i] &= static_cast<uint8_t>(nx * x[i] + ny * y[i] + nz * z[i] + d + r[i] >= 0.f);
+			}
+		}
+
+		uint32_t visibleCount = 0;
+		for (size_t i = 0; i < count; i++) {
+			visibleCount += out[i];
+		}
+		return visibleCount;
+	}
+
+}  // namespace amas
@@ -1,86 +1,111 @@
 #include "../include/amas_game_object.hpp"
 
+// std
+#include <cassert>
+
 namespace amas {
 
-	AmasDevice* AmasGameObject::device = nullptr;
-
-	glm::mat4 TransformComponent::mat4() {
-		const float c3 = glm::cos(rotation.z);
-		const float s3 = glm::sin(rotation.z);
-		const float c2 = glm::cos(rotation.x);
-		const float s2 = glm::sin(rotation.x);
-		const float c1 = glm::cos(rotation.y);
-		const float s1 = glm::sin(rotation.y);
-		return glm::mat4{
-			{
-				scale.x * (c1 * c3 + s1 * s2 * s3),
-				scale.x * (c2 * s3),
-				scale.x * (c1 * s2 * s3 - c3 * s1),
-				0.0f,
-			},
-			{
-				scale.y * (c3 * s1 * s2 - c1 * s3),
-				scale.y * (c2 * c3),
-				scale.y * (c1 * c3 * s2 + s1 * s3),
-				0.0f,
-			},
-			{
-				scale.z * (c2 * s1),
-				scale.z * (-s2),
-				scale.z * (c1 * c2),
-				0.0f,
-			},
-			{translation.x, translation.y, translation.z, 1.0f} };
+	void TransformComponent::rebuildMatrices() {
+		AmasTransformBatch::compose(translation, rotation, scale, local, localNormal);
+		localChanged();
+	}
+
+	void TransformComponent::setLocalMatrices(const glm::mat4& model, const glm::mat3& normal) {
+		local = model;
+		localNormal = normal;
+		localChanged();
+	}
+
+	void TransformComponent::localChanged() {
+		dirty = false;
+		if (parented) {
+			worldDirty = true;
+			return;
+		}
+		world = local;
+		worldNormal = localNormal;
+		version++;
+	}
+
+	void TransformComponent::updateWorld(const glm::mat4& parentMatrix, const glm::mat3& parentNormal) {
+		update();
+		// the inverse transpose of a product is the product of the inverse transposes
+		world = parentMatrix * local;
+		worldNormal = parentNormal * localNormal;
+		worldDirty = false;
+		version++;
 	}
 
-	glm::mat3 TransformComponent::normalMatrix() {
-		const float c3 = glm::cos(rotation.z);
-		const float s3 = glm::sin(rotation.z);
-		const float c2 = glm::cos(rotation.x);
-		const float s2 = glm::sin(rotation.x);
-		const float c1 = glm::cos(rotation.y);
-		const float s1 = glm::sin(rotation.y);
-		const glm::vec3 invScale = 1.0f / scale;
-
-		return glm::mat3{
-			{
-				invScale.x * (c1 * c3 + s1 * s2 * s3),
-				invScale.x * (c2 * s3),
-				invScale.x * (c1 * s2 * s3 - c3 * s1),
-			},
-			{
-				invScale.y * (c3 * s1 * s2 - c1 * s3),
-				invScale.y * (c2 * c3),
-				invScale.y * (c1 * c3 * s2 + s1 * s3),
-			},
-			{
-				invScale.z * (c2 * s1),
-				invScale.z * (-s2),
-				invScale.z * (c1 * c2),
-			},
-		};
+	Entity AmasGameObject::createGameObject(AmasRegistry& registry) {
+		Entity entity = registry.create();
+		registry.add<TransformComponent>(entity);
+		return entity;
 	}
 
+	Entity AmasGameObject::makePointLight(AmasRegistry& registry, float intensity, float radius, glm::vec3 color) {
+		Entity entity = createGameObject(registry);
+		registry.get<TransformComponent>(entity).setScale({ radius, 1.f, 1.f });
+		registry.add<PointLightComponent>(entity, intensity, color);
+		return entity;
+	}
+
+	AmasBvh::Box AmasGameObject::worldBounds(AmasRegistry& registry, Entity entity) {
+		auto& transform = registry.get<TransformComponent>(entity);
+		auto* modelComponent = registry.tryGet<ModelComponent>(entity);
+		if (modelComponent == nullptr || modelComponent->model == nullptr) {
+			glm::vec3 position = transform.getWorldTranslation();
+			glm::vec3 extent{ transform.getScale().x };
+			return { position - extent, position + extent };
+		}
+
+		// the box of the rotated and scaled local box, half extents go through the absolute matrix
+		const auto& bounds = modelComponent->model->getBounds();
+		const glm::mat4 modelMatrix = transform.mat4();
+		const glm::vec3 center{ modelMatrix * glm::vec4((bounds.min + bounds.max) * .5f, 1.f) };
+		const glm::vec3 halfExtent = (bounds.max - bounds.min) * .5f;
+		const glm::mat3 absolute{
+			glm::abs(glm::vec3(modelMatrix[0])),
+			glm::abs(glm::vec3(modelMatrix[1])),
+			glm::abs(glm::vec3(modelMatrix[2])) };
+		const glm::vec3 extent = absolute * halfExtent;
+		return { center - extent, center + extent };
+	}
+
+	void AmasGameObject::attachMaterial(AmasRegistry& registry, Entity entity, std::shared_ptr<AmasTexture> AmasTexture) {
+		auto* existing = registry.tryGet<MaterialComponent>(entity);
+		auto& material = existing != nullptr ? *existing : registry.add<MaterialComponent>(entity);
+		material.AmasTexture = AmasTexture;
+		material.info.imageLayout = AmasTexture->getImageLayout();
+		material.info.imageView = AmasTexture->getImageView();
+		material.info.sampler = AmasTexture->getSampler();
+	}
+
+	AmasBvh* SceneBvh::treeFor(AmasRegistry& registry, Entity entity) {
+		if (registry.has<PointLightComponent>(entity)) return &lights;
+		if (registry.has<ModelComponent>(entity)) return &models;
+		return nullptr;
+	}
 
-	void AmasGameObject::setDevice(AmasDevice& device_) {
-		device = &device_;
+	void SceneBvh::insert(AmasRegistry& registry, Entity entity) {
+		assert(!registry.has<BvhProxyComponent>(entity) && "Entity is already in the scene bvh");
+		if (auto* tree = treeFor(registry, entity)) {
+			AmasBvh::ProxyId proxy = tree->insert(AmasGameObject::worldBounds(registry, entity), entity.index);
+			registry.add<BvhProxyComponent>(entity, proxy, registry.get<TransformComponent>(entity).getVersion());
+		}
 	}
 
-	AmasGameObject AmasGameObject::makePointLight(float intensity, float radius, glm::vec3 color) {
-		AmasGameObject pointLight = AmasGameObject::createGameObject();
-		pointLight.color = color;
-		pointLight.transform.scale.x = radius;
-		pointLight.pointLight = std::make_unique<PointLightComponent>();
-		pointLight.pointLight->lightIntensity = intensity;
-		return pointLight;
+	void SceneBvh::remove(AmasRegistry& registry, Entity entity) {
+		auto* bvhProxy = registry.tryGet<BvhProxyComponent>(entity);
+		if (bvhProxy == nullptr) return;
+		treeFor(registry, entity)->remove(bvhProxy->proxy);
+		registry.remove<BvhProxyComponent>(entity);
 	}
 
-	void AmasGameObject::attachMaterial(std::shared_ptr<AmasTexture> AmasTexture) {
-		material = std::make_unique<MaterialComponent>();
-		material->AmasTexture = AmasTexture;
-		material->info.imageLayout = AmasTexture->getImageLayout();
-		material->info.imageView = AmasTexture->getImageView();
-		material->info.sampler = AmasTexture->getSampler();
+	void SceneBvh::update(AmasRegistry& registry, Entity entity) {
+		auto* bvhProxy = registry.tryGet<BvhProxyComponent>(entity);
+		if (bvhProxy == nullptr) return;
+		treeFor(registry, entity)->move(bvhProxy->proxy, AmasGameObject::worldBounds(registry, entity));
+		bvhProxy->transformVersion = registry.get<TransformComponent>(entity).getVersion();
 	}
 
 }  // namespace amas
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "../include/amas_geometry_pool.hpp"
+#include "../include/amas_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+namespace amas {
+
+	bool AmasGeometryPool::RangeList::allocate(uint32_t count, uint32_t& offset) {
+		for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+			if (it->second < count) continue;
+
+			offset = it->first;
+			uint32_t remaining = it->second - count;
+			freeRanges.erase(it);
+			if (remaining > 0) {
+				freeRanges.emplace(offset + count, remaining);
+			}
+			return true;
+		}
+		return false;
+	}
+
+	void AmasGeometryPool::RangeList::release(uint32_t offset, uint32_t count) {
+		auto next = freeRanges.lower_bound(offset);
+		if (next != freeRanges.end() && offset + count == next->first) {
+			count += next->second;
+			next = freeRanges.erase(next);
+		}
+		if (next != freeRanges.begin()) {
+			auto prev = std::prev(next);
+			if (prev->first + prev->second == offset) {
+				prev->second += count;
+				return;
+			}
+		}
+		freeRanges.emplace(offset, count);
+	}
+
+	AmasGeometryPool::AmasGeometryPool(AmasDevice& device) : amasDevice{ device } {}
+
+	AmasGeometryPool::Page& AmasGeometryPool::createPage(
+		uint32_t vertexStride, uint32_t minVertexCount, uint32_t minIndexCount) {
+		auto page = std::make_unique<Page>();
+		page->vertexStride = vertexStride;
+
+		uint32_t vertexCapacity = std::max(static_cast<uint32_t>(PAGE_SIZE / vertexStride), minVertexCount);
+		uint32_t indexCapacity = std::max(static_cast<uint32_t>(PAGE_SIZE / sizeof(uint32_t)), minIndexCount);
+
+		page->vertexBuffer = std::make_unique<AmasBuffer>(
+			amasDevice,
+			vertexStride,
+			vertexCapacity,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		page->indexBuffer = std::make_unique<AmasBuffer>(
+			amasDevice,
+			sizeof(uint32_t),
+			indexCapacity,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		page->vertices.release(0, vertexCapacity);
+		page->indices.release(0, indexCapacity);
+
+		pages.push_back(std::move(page));
+		return *pages.back();
+	}
+
+	AmasGeometryPool::Mesh AmasGeometryPool::allocate(
+		uint32_t vertexCount,
+		uint32_t vertexStride,
+		const std::function<void(void*)>& writeVertices,
+		std::span<const uint32_t> indices,
+		AmasUploader::Ticket& uploadTicket) {
+		assert(vertexCount > 0 && "Cannot allocate an empty mesh");
+
+		std::vector<uint32_t> sequentialIndices;
+		std::span<const uint32_t> meshIndices = indices;
+		if (indices.empty()) {
+			sequentialIndices.resize(vertexCount);
+			std::iota(sequentialIndices.begin(), sequentialIndices.end(), 0u);
+			meshIndices = sequentialIndices;
+		}
+		uint32_t indexCount = static_cast<uint32_t>(meshIndices.size());
+
+		Mesh mesh{};
+		mesh.vertexCount = vertexCount;
+		mesh.indexCount = indexCount;
+
+		Page* page = nullptr;
+		uint32_t vertexOffset = 0;
+		for (uint32_t i = 0; i < pages.size() && page == nullptr; i++) {
+			auto& candidate = *pages[i];
+			if (candidate.vertexStride != vertexStride) continue;
+			if (!candidate.vertices.allocate(vertexCount, vertexOffset)) continue;
+			if (!candidate.indices.allocate(indexCount, mesh.firstIndex)) {
+				candidate.vertices.release(vertexOffset, vertexCount);
+				continue;
+			}
+			page = &candidate;
+			mesh.page = i;
+		}
+
+		if (page == nullptr) {
+			page = &createPage(vertexStride, vertexCount, indexCount);
+			mesh.page = static_cast<uint32_t>(pages.size() - 1);
+			page->vertices.allocate(vertexCount, vertexOffset);
+			page->indices.allocate(indexCount, mesh.firstIndex);
+		}
+		mesh.vertexOffset = static_cast<int32_t>(vertexOffset);
+
+		auto& uploader = amasDevice.getUploader();
+		uploader.copyBuffer(
+			static_cast<VkDeviceSize>(vertexCount) * vertexStride,
+			writeVertices,
+			page->vertexBuffer->getBuffer(),
+			static_cast<VkDeviceSize>(vertexOffset) * vertexStride);
+		uploadTicket = uploader.copyBuffer(
+			meshIndices.data(),
+			static_cast<VkDeviceSize>(indexCount) * sizeof(uint32_t),
+			page->indexBuffer->getBuffer(),
+			static_cast<VkDeviceSize>(mesh.firstIndex) * sizeof(uint32_t));
+
+		return mesh;
+	}
+
+	void AmasGeometryPool::free(const Mesh& mesh) {
+		assert(mesh.page < pages.size() && "Mesh does not belong to this pool");
+		// draws of the current or an earlier frame may still read the ranges on the graphics queue,
+		// a copy on the transfer queue into them would not be ordered after those reads
+		pendingFrees.push_back({ mesh, frameCount });
+	}
+
+	void AmasGeometryPool::beginFrame() {
+		frameCount++;
+		while (!pendingFrees.empty() &&
+			pendingFrees.front().frame + AmasSwapChain::MAX_FRAMES_IN_FLIGHT <= frameCount) {
+			release(pendingFrees.front().mesh);
+			pendingFrees.pop_front();
+		}
+	}
+
+	void AmasGeometryPool::release(const Mesh& mesh) {
+		auto& page = *pages[mesh.page];
+		page.vertices.release(static_cast<uint32_t>(mesh.vertexOffset), mesh.vertexCount);
+		page.indices.release(mesh.firstIndex, mesh.indexCount);
+	}
+
+	void AmasGeometryPool::bind(VkCommandBuffer commandBuffer, uint32_t page) {
+		VkBuffer buffers[] = { pages[page]->vertexBuffer->getBuffer() };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, pages[page]->indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	}
+
+}  // namespace amas
@@ -0,0 +1,163 @@
+#include "../include/amas_hierarchy.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace amas {
+
+	void AmasHierarchy::setParent(AmasRegistry& registry, Entity child, Entity parent) {
+		auto& transform = registry.get<TransformComponent>(child);
+		structureDirty = true;
+
+		if (!registry.isAlive(parent)) {
+			if (!registry.has<ParentComponent>(child)) return;
+			registry.remove<ParentComponent>(child);
+			// world = local again, done by the next rebuild of the matrices
+			transform.parented = false;
+			transform.dirty = true;
+			return;
+		}
+
+		if (child == parent || isAncestor(registry, child, parent)) {
+			throw std::runtime_error("cannot parent an entity to itself or one of its descendants!");
+		}
+		if (auto* link = registry.tryGet<ParentComponent>(child)) {
+			link->parent = parent;
+		} else {
+			registry.add<ParentComponent>(child, parent);
+		}
+		transform.parented = true;
+		transform.worldDirty = true;
+	}
+
+	Entity AmasHierarchy::getParent(AmasRegistry& registry, Entity entity) {
+		auto* link = registry.tryGet<ParentComponent>(entity);
+		return link != nullptr ? link->parent : Entity{};
+	}
+
+	bool AmasHierarchy::isAncestor(AmasRegistry& registry, Entity ancestor, Entity entity) {
+		for (auto* link = registry.tryGet<ParentComponent>(entity); link != nullptr;
+			link = registry.tryGet<ParentComponent>(link->parent)) {
+			if (link->parent == ancestor) return true;
+		}
+		return false;
+	}
+
+	void AmasHierarchy::propagate(AmasRegistry& registry) {
+		auto& parents = registry.pool<ParentComponent>();
+		auto& transforms = registry.pool<TransformComponent>();
+
+		// destroying an entity drops its links without telling us, so check that the links still
+		// match the nodes: one compact pass over the parent components
+		if (!structureDirty) {
+			uint32_t childCount = 0;
+			for (const auto& node : nodes) {
+				childCount += node.parentSlot != NO_PARENT;
+			}
+			structureDirty = parents.size() != childCount;
+			for (const auto& link : parents.getComponents()) {
+				if (structureDirty) break;
+				structureDirty = !registry.isAlive(link.parent);
+			}
+		}
+
+		bool force = structureDirty;
+		if (structureDirty) {
+			rebuild(registry);
+		}
+
+		updatedCount = 0;
+		for (uint32_t slot = 0; slot < nodes.size(); slot++) {
+			auto& node = nodes[slot];
+			auto& transform = transforms.get(node.entityIndex);
+			transform.update();
+
+			if (node.parentSlot == NO_PARENT) {
+				changed[slot] = force || transform.getVersion() != node.worldVersion;
+				node.worldVersion = transform.getVersion();
+				continue;
+			}
+
+			// parents come first, so their world matrices are final by now
+			if (force || transform.worldDirty || changed[node.parentSlot]) {
+				auto& parent = transforms.get(nodes[node.parentSlot].entityIndex);
+				transform.updateWorld(parent.world, parent.worldNormal);
+				changed[slot] = 1;
+				updatedCount++;
+			} else {
+				changed[slot] = 0;
+			}
+		}
+	}
+
+	void AmasHierarchy::rebuild(AmasRegistry& registry) {
+		static constexpr uint32_t UNVISITED = ~0u;
+
+		auto& parents = registry.pool<ParentComponent>();
+		auto& transforms = registry.pool<TransformComponent>();
+		structureDirty = false;
+
+		// children of destroyed entities become roots
+		std::vector<uint32_t> orphans;
+		const auto& linked = parents.getEntities();
+		for (uint32_t slot = 0; slot < linked.size(); slot++) {
+			if (!registry.isAlive(parents.getComponents()[slot].parent)) {
+				orphans.push_back(linked[slot]);
+			}
+		}
+		for (uint32_t index : orphans) {
+			parents.remove(index);
+			auto& transform = transforms.get(index);
+			transform.parented = false;
+			transform.dirty = true;
+		}
+
+		// depth of every linked entity and of the roots above them, each chain is walked once
+		const uint32_t capacity = registry.getEntityCapacity();
+		depths.assign(capacity, UNVISITED);
+		std::vector<uint32_t> chain;
+		uint32_t maxDepth = 0;
+		for (uint32_t index : parents.getEntities()) {
+			uint32_t current = index;
+			while (depths[current] == UNVISITED) {
+				chain.push_back(current);
+				auto* link = parents.tryGet(current);
+				if (link == nullptr) break;
+				current = link->parent.index;
+			}
+			// the walk stopped either below a known depth or on a root, which is then the last entry
+			uint32_t depth = depths[current] == UNVISITED ? 0 : depths[current] + 1;
+			while (!chain.empty()) {
+				depths[chain.back()] = depth++;
+				chain.pop_back();
+			}
+			maxDepth = std::max(maxDepth, depth - 1);
+		}
+
+		// counting sort by depth
+		std::vector<uint32_t> offsets(maxDepth + 2, 0);
+		for (uint32_t index = 0; index < capacity; index++) {
+			if (depths[index] != UNVISITED) offsets[depths[index] + 1]++;
+		}
+		for (uint32_t depth = 1; depth < offsets.size(); depth++) {
+			offsets[depth] += offsets[depth - 1];
+		}
+
+		nodes.resize(offsets.back());
+		slots.assign(capacity, NO_PARENT);
+		for (uint32_t index = 0; index < capacity; index++) {
+			if (depths[index] == UNVISITED) continue;
+			uint32_t slot = offsets[depths[index]]++;
+			nodes[slot] = { index, NO_PARENT, 0 };
+			slots[index] = slot;
+		}
+		for (auto& node : nodes) {
+			if (auto* link = parents.tryGet(node.entityIndex)) {
+				node.parentSlot = slots[link->parent.index];
+			}
+		}
+		changed.assign(nodes.size(), 0);
+	}
+
+}  // namespace amas
@@ -0,0 +1,228 @@
+#include "../include/amas_job_system.hpp"
+
+// std
+#include <algorithm>
+#include <iterator>
+
+namespace amas {
+
+	namespace {
+		// lets a thread find its own queue, threads the system did not start use queue 0
+		thread_local const AmasJobSystem* currentSystem = nullptr;
+		thread_local uint32_t currentQueueIndex = 0;
+		// set while the thread runs a background job, whatever it submits or waits for belongs to it
+		thread_local bool runningBackground = false;
+
+		// the newest (fromBack) or oldest job of the queue the caller is allowed to run
+		template <typename Entry>
+		bool takeEntry(std::deque<Entry>& jobs, bool fromBack, bool allowBackground, Entry& entry) {
+			if (fromBack) {
+				for (auto it = jobs.rbegin(); it != jobs.rend(); ++it) {
+					if (allowBackground || !it->background) {
+						entry = std::move(*it);
+						jobs.erase(std::next(it).base());
+						return true;
+					}
+				}
+				return false;
+			}
+			for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+				if (allowBackground || !it->background) {
+					entry = std::move(*it);
+					jobs.erase(it);
+					return true;
+				}
+			}
+			return false;
+		}
+	}  // namespace
+
+	AmasJobSystem::AmasJobSystem(uint32_t workerCount) {
+		if (workerCount == 0) {
+			workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		}
+
+		queues.resize(workerCount + 1);
+		for (auto& queue : queues) {
+			queue = std::make_unique<JobQueue>();
+		}
+		workers.reserve(workerCount);
+		for (uint32_t i = 1; i <= workerCount; i++) {
+			workers.emplace_back(&AmasJobSystem::workerLoop, this, i);
+		}
+	}
+
+	AmasJobSystem::~AmasJobSystem() {
+		{
+			std::lock_guard<std::mutex> lock{ sleepMutex };
+			stopping = true;
+		}
+		wakeCondition.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	uint32_t AmasJobSystem::currentQueue() const {
+		return currentSystem == this ? currentQueueIndex : 0;
+	}
+
+	void AmasJobSystem::submit(Job job, AmasJobCounter* counter) {
+		push(*queues[currentQueue()], std::move(job), counter, runningBackground && currentSystem == this);
+	}
+
+	void AmasJobSystem::submitBackground(Job job, AmasJobCounter* counter) {
+		push(backgroundQueue, std::move(job), counter, true);
+	}
+
+	void AmasJobSystem::push(JobQueue& queue, Job job, AmasJobCounter* counter, bool background) {
+		if (counter != nullptr) {
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ queue.mutex };
+			queue.jobs.push_back({ std::move(job), counter, background });
+		}
+
+		// taking the lock orders the count against a worker that is about to go to sleep
+		{
+			std::lock_guard<std::mutex> lock{ sleepMutex };
+			queuedCount.fetch_add(1, std::memory_order_relaxed);
+		}
+		wakeCondition.notify_one();
+	}
+
+	void AmasJobSystem::wait(AmasJobCounter& counter) {
+		const uint32_t queueIndex = currentQueue();
+		while (!counter.isDone()) {
+			if (!runOne(queueIndex, false)) {
+				std::this_thread::yield();
+			}
+		}
+
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock{ counter.errorMutex };
+			std::swap(error, counter.error);
+		}
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	void AmasJobSystem::parallelFor(uint32_t count, uint32_t grainSize, const RangeJob& fn) {
+		if (count == 0) {
+			return;
+		}
+
+		// a few ranges per thread leave room for stealing when some ranges run longer than others
+		grainSize = std::max(grainSize, 1u);
+		const uint32_t rangeCount = std::min((count + grainSize - 1) / grainSize, getThreadCount() * 4);
+		if (rangeCount <= 1) {
+			fn(0, count);
+			return;
+		}
+
+		auto rangeBegin = [&](uint32_t range) {
+			return static_cast<uint32_t>(uint64_t{ count } * range / rangeCount);
+		};
+
+		AmasJobCounter counter;
+		for (uint32_t range = 1; range < rangeCount; range++) {
+			const uint32_t first = rangeBegin(range);
+			const uint32_t last = rangeBegin(range + 1);
+			submit([&fn, first, last] { fn(first, last); }, &counter);
+		}
+		// the jobs reference fn, they have to finish even if the first range fails
+		std::exception_ptr error;
+		try {
+			fn(0, rangeBegin(1));
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		wait(counter);
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	void AmasJobSystem::workerLoop(uint32_t queueIndex) {
+		currentSystem = this;
+		currentQueueIndex = queueIndex;
+
+		while (true) {
+			if (runOne(queueIndex, true)) {
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock{ sleepMutex };
+			wakeCondition.wait(lock, [&] { return stopping || queuedCount.load(std::memory_order_relaxed) > 0; });
+			if (stopping && queuedCount.load(std::memory_order_relaxed) == 0) {
+				return;
+			}
+		}
+	}
+
+	bool AmasJobSystem::runOne(uint32_t queueIndex, bool background) {
+		// a waiting thread only runs background jobs when it waits on behalf of one
+		const bool allowBackground = background || runningBackground;
+		JobEntry entry;
+		if (!popLocal(queueIndex, allowBackground, entry) && !steal(queueIndex, allowBackground, entry)) {
+			if (!background) {
+				return false;
+			}
+			std::lock_guard<std::mutex> lock{ backgroundQueue.mutex };
+			if (backgroundQueue.jobs.empty()) {
+				return false;
+			}
+			entry = std::move(backgroundQueue.jobs.front());
+			backgroundQueue.jobs.pop_front();
+		}
+		queuedCount.fetch_sub(1, std::memory_order_relaxed);
+
+		const bool wasBackground = runningBackground;
+		runningBackground = entry.background;
+		try {
+			entry.job();
+		}
+		catch (...) {
+			runningBackground = wasBackground;
+			if (entry.counter == nullptr) {
+				throw;
+			}
+			std::lock_guard<std::mutex> lock{ entry.counter->errorMutex };
+			if (!entry.counter->error) {
+				entry.counter->error = std::current_exception();
+			}
+		}
+		runningBackground = wasBackground;
+
+		if (entry.counter != nullptr) {
+			entry.counter->pending.fetch_sub(1, std::memory_order_release);
+		}
+		return true;
+	}
+
+	bool AmasJobSystem::popLocal(uint32_t queueIndex, bool allowBackground, JobEntry& entry) {
+		auto& queue = *queues[queueIndex];
+		std::lock_guard<std::mutex> lock{ queue.mutex };
+		// newest first, its data is most likely still in cache
+		return takeEntry(queue.jobs, true, allowBackground, entry);
+	}
+
+	bool AmasJobSystem::steal(uint32_t queueIndex, bool allowBackground, JobEntry& entry) {
+		const uint32_t queueCount = static_cast<uint32_t>(queues.size());
+		for (uint32_t offset = 1; offset < queueCount; offset++) {
+			auto& queue = *queues[(queueIndex + offset) % queueCount];
+			std::lock_guard<std::mutex> lock{ queue.mutex };
+			// oldest first, usually the largest piece of work left in that queue
+			if (takeEntry(queue.jobs, false, allowBackground, entry)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+}  // namespace amas
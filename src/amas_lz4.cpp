@@ -0,0 +1,134 @@
+#include "../include/amas_lz4.hpp"
+
+// std
+#include <cstring>
+
+namespace amas {
+
+	namespace {
+
+		constexpr size_t MIN_MATCH = 4;
+		// the block ends with literals, no match may start in the last 12 bytes or reach the last 5
+		constexpr size_t MATCH_START_LIMIT = 12;
+		constexpr size_t LAST_LITERALS = 5;
+		constexpr size_t MAX_OFFSET = 65535;
+		constexpr uint32_t HASH_BITS = 16;
+
+		uint32_t read32(const uint8_t* p) {
+			uint32_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		uint32_t hash(uint32_t sequence) {
+			return (sequence * 2654435761u) >> (32 - HASH_BITS);
+		}
+
+		// lengths from 15 on continue in bytes of 255 and a last one below
+		void writeLength(std::vector<uint8_t>& out, size_t length) {
+			for (; length >= 255; length -= 255) out.push_back(255);
+			out.push_back(static_cast<uint8_t>(length));
+		}
+
+		bool readLength(const uint8_t*& ip, const uint8_t* end, size_t& length) {
+			uint8_t byte;
+			do {
+				if (ip == end) return false;
+				byte = *ip++;
+				length += byte;
+			} while (byte == 255);
+			return true;
+		}
+
+		void writeSequence(
+			std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength) {
+			const size_t extraMatch = matchLength - MIN_MATCH;
+			out.push_back(static_cast<uint8_t>(
+				(literalCount < 15 ? literalCount : 15) << 4 | (extraMatch < 15 ? extraMatch : 15)));
+			if (literalCount >= 15) writeLength(out, literalCount - 15);
+			out.insert(out.end(), literals, literals + literalCount);
+			out.push_back(static_cast<uint8_t>(offset));
+			out.push_back(static_cast<uint8_t>(offset >> 8));
+			if (extraMatch >= 15) writeLength(out, extraMatch - 15);
+		}
+
+	}  // namespace
+
+	std::vector<uint8_t> AmasLz4::compress(const uint8_t* source, size_t size) {
+		std::vector<uint8_t> out{};
+		out.reserve(compressBound(size));
+
+		size_t anchor = 0;
+		if (size > MATCH_START_LIMIT) {
+			// position + 1 of the last sequence seen with each hash, 0 for none
+			std::vector<uint32_t> table(size_t{ 1 } << HASH_BITS, 0);
+			const size_t matchLimit = size - LAST_LITERALS;
+			size_t ip = 0;
+			while (ip < size - MATCH_START_LIMIT) {
+				const uint32_t sequence = read32(source + ip);
+				uint32_t& slot = table[hash(sequence)];
+				const size_t candidate = slot;
+				slot = static_cast<uint32_t>(ip + 1);
+				if (candidate == 0 || ip - (candidate - 1) > MAX_OFFSET || read32(source + candidate - 1) != sequence) {
+					// skip faster through data that does not compress
+					ip += 1 + ((ip - anchor) >> 6);
+					continue;
+				}
+
+				const size_t match = candidate - 1;
+				size_t length = MIN_MATCH;
+				while (ip + length < matchLimit && source[match + length] == source[ip + length]) length++;
+				writeSequence(out, source + anchor, ip - anchor, ip - match, length);
+				ip += length;
+				anchor = ip;
+			}
+		}
+
+		// the last sequence is literals only
+		const size_t literalCount = size - anchor;
+		out.push_back(static_cast<uint8_t>((literalCount < 15 ? literalCount : 15) << 4));
+		if (literalCount >= 15) writeLength(out, literalCount - 15);
+		out.insert(out.end(), source + anchor, source + size);
+		return out;
+	}
+
+	bool AmasLz4::decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t size) {
+		const uint8_t* ip = source;
+		const uint8_t* const end = source + sourceSize;
+		uint8_t* op = destination;
+		uint8_t* const outEnd = destination + size;
+
+		while (ip < end) {
+			const uint8_t token = *ip++;
+
+			size_t literalCount = token >> 4;
+			if (literalCount == 15 && !readLength(ip, end, literalCount)) return false;
+			if (literalCount > static_cast<size_t>(end - ip) || literalCount > static_cast<size_t>(outEnd - op)) return false;
+			std::memcpy(op, ip, literalCount);
+			ip += literalCount;
+			op += literalCount;
+			if (ip == end) break;
+
+			if (end - ip < 2) return false;
+			const size_t offset = ip[0] | size_t{ ip[1] } << 8;
+			ip += 2;
+			if (offset == 0 || offset > static_cast<size_t>(op - destination)) return false;
+
+			size_t matchLength = token & 15;
+			if (matchLength == 15 && !readLength(ip, end, matchLength)) return false;
+			matchLength += MIN_MATCH;
+			if (matchLength > static_cast<size_t>(outEnd - op)) return false;
+
+			// an offset shorter than the match repeats bytes this copy writes, they go one by one
+			const uint8_t* match = op - offset;
+			if (offset >= matchLength) {
+				std::memcpy(op, match, matchLength);
+				op += matchLength;
+			} else {
+				for (size_t i = 0; i < matchLength; i++) *op++ = match[i];
+			}
+		}
+		return op == outEnd;
+	}
+
+}  // namespace amas
@@ -0,0 +1,175 @@
+#include "../include/amas_mapped_file.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace amas {
+
+	namespace {
+
+#ifndef _WIN32
+		// madvise wants a page aligned start, the range is widened to whole pages
+		void advise(const uint8_t* mapping, size_t fileSize, size_t offset, size_t size, int advice) {
+			if (mapping == nullptr || offset >= fileSize) return;
+			static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			size = std::min(size, fileSize - offset);
+			const size_t begin = offset / pageSize * pageSize;
+			madvise(const_cast<uint8_t*>(mapping) + begin, offset + size - begin, advice);
+		}
+#endif
+
+	}  // namespace
+
+	AmasMappedFile::AmasMappedFile(const std::string& filepath, Access access) {
+		if (!open(filepath, access)) {
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+	}
+
+	AmasMappedFile::~AmasMappedFile() {
+		close();
+	}
+
+	AmasMappedFile::AmasMappedFile(AmasMappedFile&& other) noexcept {
+		*this = std::move(other);
+	}
+
+	AmasMappedFile& AmasMappedFile::operator=(AmasMappedFile&& other) noexcept {
+		if (this != &other) {
+			close();
+			mapping = std::exchange(other.mapping, nullptr);
+			fileSize = std::exchange(other.fileSize, 0);
+			opened = std::exchange(other.opened, false);
+#ifdef _WIN32
+			fileHandle = std::exchange(other.fileHandle, nullptr);
+			mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#endif
+		}
+		return *this;
+	}
+
+#ifdef _WIN32
+	bool AmasMappedFile::open(const std::string& filepath, Access access) {
+		close();
+
+		const DWORD flags = access == Access::SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN
+			: access == Access::RANDOM ? FILE_FLAG_RANDOM_ACCESS
+			: 0;
+		HANDLE file = CreateFileA(
+			filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | flags, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(file, &size)) {
+			CloseHandle(file);
+			return false;
+		}
+		fileHandle = file;
+		fileSize = static_cast<size_t>(size.QuadPart);
+		opened = true;
+		// a mapping of an empty file cannot be created
+		if (fileSize == 0) return true;
+
+		mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle != nullptr) {
+			mapping = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+		}
+		if (mapping == nullptr) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void AmasMappedFile::close() {
+		if (mapping != nullptr) UnmapViewOfFile(mapping);
+		if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+		if (fileHandle != nullptr) CloseHandle(fileHandle);
+		mapping = nullptr;
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+		fileSize = 0;
+		opened = false;
+	}
+
+	void AmasMappedFile::prefetch(size_t offset, size_t size) const {
+		if (mapping == nullptr || offset >= fileSize) return;
+		WIN32_MEMORY_RANGE_ENTRY range{};
+		range.VirtualAddress = const_cast<uint8_t*>(mapping) + offset;
+		range.NumberOfBytes = std::min(size, fileSize - offset);
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+
+	void AmasMappedFile::release(size_t offset, size_t size) const {
+		if (mapping == nullptr || offset >= fileSize) return;
+		// unlocking pages that were never locked drops them from the working set
+		VirtualUnlock(const_cast<uint8_t*>(mapping) + offset, std::min(size, fileSize - offset));
+	}
+#else
+	bool AmasMappedFile::open(const std::string& filepath, Access access) {
+		close();
+
+		const int file = ::open(filepath.c_str(), O_RDONLY);
+		if (file < 0) return false;
+
+		struct stat status {};
+		if (fstat(file, &status) != 0) {
+			::close(file);
+			return false;
+		}
+		fileSize = static_cast<size_t>(status.st_size);
+		opened = true;
+		if (fileSize > 0) {
+			void* view = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, file, 0);
+			mapping = view == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(view);
+		}
+		// the mapping keeps its own reference to the file
+		::close(file);
+		if (fileSize > 0 && mapping == nullptr) {
+			close();
+			return false;
+		}
+
+		if (access != Access::NORMAL) {
+			advise(mapping, fileSize, 0, fileSize, access == Access::SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+		}
+		return true;
+	}
+
+	void AmasMappedFile::close() {
+		if (mapping != nullptr) munmap(const_cast<uint8_t*>(mapping), fileSize);
+		mapping = nullptr;
+		fileSize = 0;
+		opened = false;
+	}
+
+	void AmasMappedFile::prefetch(size_t offset, size_t size) const {
+		advise(mapping, fileSize, offset, size, MADV_WILLNEED);
+	}
+
+	void AmasMappedFile::release(size_t offset, size_t size) const {
+		// only whole pages inside the range, a page shared with data still to be read stays
+		if (mapping == nullptr || offset >= fileSize) return;
+		static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		const size_t end = offset + std::min(size, fileSize - offset);
+		const size_t begin = (offset + pageSize - 1) / pageSize * pageSize;
+		const size_t alignedEnd = end == fileSize ? end : end / pageSize * pageSize;
+		if (alignedEnd <= begin) return;
+		madvise(const_cast<uint8_t*>(mapping) + begin, alignedEnd - begin, MADV_DONTNEED);
+	}
+#endif
+
+}  // namespace amas
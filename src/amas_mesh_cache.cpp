@@ -0,0 +1,165 @@
+#include "../include/amas_mesh_cache.hpp"
+#include "../include/amas_file_system.hpp"
+
+// std
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace amas {
+
+	namespace {
+
+		// distinguishes the temporary files of writers importing the same source at once
+		std::atomic<uint32_t> tempFileCounter{ 0 };
+
+		struct FileHeader {
+			uint32_t magic;
+			uint32_t version;
+			// size and modification time of the source the cache was imported from
+			uint64_t sourceSize;
+			int64_t sourceTime;
+			uint32_t vertexStride;
+			uint32_t attributeCount;
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			uint32_t lodCount;
+			uint32_t meshletCount;
+			float boundsMin[3];
+			float boundsMax[3];
+			float boundsCenter[3];
+			float boundsRadius;
+		};
+
+		// one entry of the vertex layout descriptor following the header
+		struct FileAttribute {
+			uint32_t location;
+			uint32_t format;
+			uint32_t offset;
+		};
+
+		// the cache holds the cpu side vertices, the gpu format is applied on upload
+		std::vector<FileAttribute> vertexLayout() {
+			std::vector<FileAttribute> layout{};
+			for (const auto& attribute : AmasModel::Vertex::getAttributeDescriptions(AmasModel::VertexFormat::FLOAT)) {
+				layout.push_back({ attribute.location, static_cast<uint32_t>(attribute.format), attribute.offset });
+			}
+			return layout;
+		}
+
+	}  // namespace
+
+	std::string AmasMeshCache::getCachePath(const std::string& sourcePath) {
+		return sourcePath + ".amesh";
+	}
+
+	bool AmasMeshCache::read(const std::string& sourcePath, AmasModel::Builder& builder) {
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		// a packed source reports the size and time it was packed with, so a packed cache stays valid
+		if (!AmasFileSystem::status(sourcePath, sourceSize, sourceTime)) return false;
+
+		auto file = std::make_shared<AmasFile>();
+		if (!AmasFileSystem::open(getCachePath(sourcePath), *file)) return false;
+		const uint8_t* data = file->data();
+		const uint64_t cacheSize = file->size();
+		if (cacheSize < sizeof(FileHeader)) return false;
+
+		FileHeader header{};
+		std::memcpy(&header, data, sizeof(header));
+		if (header.magic != MAGIC || header.version != VERSION ||
+			header.sourceSize != sourceSize || header.sourceTime != sourceTime) {
+			return false;
+		}
+
+		const std::vector<FileAttribute> layout = vertexLayout();
+		const uint64_t layoutSize = layout.size() * sizeof(FileAttribute);
+		if (header.vertexStride != sizeof(AmasModel::Vertex) || header.attributeCount != layout.size() ||
+			cacheSize < sizeof(FileHeader) + layoutSize ||
+			std::memcmp(data + sizeof(FileHeader), layout.data(), layoutSize) != 0) {
+			return false;
+		}
+
+		// a truncated cache is caught here rather than by views sized from garbage counts
+		const uint64_t lodOffset = sizeof(FileHeader) + layoutSize;
+		const uint64_t meshletOffset = lodOffset + uint64_t{ header.lodCount } * sizeof(AmasModel::Lod);
+		const uint64_t vertexOffset = meshletOffset + uint64_t{ header.meshletCount } * sizeof(AmasModel::Meshlet);
+		const uint64_t indexOffset = vertexOffset + uint64_t{ header.vertexCount } * sizeof(AmasModel::Vertex);
+		const uint64_t expectedSize = indexOffset + uint64_t{ header.indexCount } * sizeof(uint32_t);
+		if (cacheSize != expectedSize) return false;
+
+		// the small tables are copied out, the vertices and indices are staged from the mapping
+		builder.lods.resize(header.lodCount);
+		builder.meshlets.resize(header.meshletCount);
+		std::memcpy(builder.lods.data(), data + lodOffset, builder.lods.size() * sizeof(AmasModel::Lod));
+		std::memcpy(builder.meshlets.data(), data + meshletOffset, builder.meshlets.size() * sizeof(AmasModel::Meshlet));
+		builder.vertices.clear();
+		builder.indices.clear();
+		builder.mappedVertices = { reinterpret_cast<const AmasModel::Vertex*>(data + vertexOffset), header.vertexCount };
+		builder.mappedIndices = { reinterpret_cast<const uint32_t*>(data + indexOffset), header.indexCount };
+		file->prefetch(vertexOffset, expectedSize - vertexOffset);
+		builder.mappedFile = std::move(file);
+
+		AmasModel::Bounds bounds{};
+		std::memcpy(&bounds.min, header.boundsMin, sizeof(header.boundsMin));
+		std::memcpy(&bounds.max, header.boundsMax, sizeof(header.boundsMax));
+		std::memcpy(&bounds.center, header.boundsCenter, sizeof(header.boundsCenter));
+		bounds.radius = header.boundsRadius;
+		builder.bounds = bounds;
+		return true;
+	}
+
+	void AmasMeshCache::write(const std::string& sourcePath, const AmasModel::Builder& builder) {
+		FileHeader header{};
+		if (!AmasFileSystem::status(sourcePath, header.sourceSize, header.sourceTime)) return;
+
+		const AmasModel::Bounds bounds = builder.bounds ? *builder.bounds : AmasModel::computeBounds(builder.vertices);
+		const std::vector<FileAttribute> layout = vertexLayout();
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.vertexStride = sizeof(AmasModel::Vertex);
+		header.attributeCount = static_cast<uint32_t>(layout.size());
+		header.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+		header.indexCount = static_cast<uint32_t>(builder.indices.size());
+		header.lodCount = static_cast<uint32_t>(builder.lods.size());
+		header.meshletCount = static_cast<uint32_t>(builder.meshlets.size());
+		std::memcpy(header.boundsMin, &bounds.min, sizeof(header.boundsMin));
+		std::memcpy(header.boundsMax, &bounds.max, sizeof(header.boundsMax));
+		std::memcpy(header.boundsCenter, &bounds.center, sizeof(header.boundsCenter));
+		header.boundsRadius = bounds.radius;
+
+		// written aside and renamed into place, so a reader never sees half a cache. Every writer gets
+		// a temporary file of its own, two imports of the same source would interleave in a shared one.
+		const std::string cachePath = getCachePath(sourcePath);
+		const std::string tempPath = cachePath + "." +
+			std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + "." +
+			std::to_string(tempFileCounter.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+		{
+			std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(layout.data()), layout.size() * sizeof(FileAttribute));
+			file.write(reinterpret_cast<const char*>(builder.lods.data()), builder.lods.size() * sizeof(AmasModel::Lod));
+			file.write(reinterpret_cast<const char*>(builder.meshlets.data()), builder.meshlets.size() * sizeof(AmasModel::Meshlet));
+			file.write(reinterpret_cast<const char*>(builder.vertices.data()), builder.vertices.size() * sizeof(AmasModel::Vertex));
+			file.write(reinterpret_cast<const char*>(builder.indices.data()), builder.indices.size() * sizeof(uint32_t));
+			if (!file) {
+				file.close();
+				std::error_code error;
+				std::filesystem::remove(tempPath, error);
+				return;
+			}
+		}
+		std::error_code error;
+		std::filesystem::rename(tempPath, cachePath, error);
+		if (error) {
+			std::filesystem::remove(tempPath, error);
+		}
+	}
+
+}  // namespace amas
@@ -0,0 +1,290 @@
+#include "../include/amas_mesh_optimizer.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <numeric>
+
+namespace amas {
+
+	namespace {
+
+		constexpr uint32_t NO_VERTEX = std::numeric_limits<uint32_t>::max();
+
+		// cache time stamps only grow, a vertex is cached while fewer than cacheSize vertices were
+		// cached after it, so resetting the cache is a jump of the clock
+		struct VertexCache {
+			VertexCache(uint32_t vertexCount, uint32_t cacheSize)
+				: cachedAt(vertexCount, 0), time{ cacheSize + 1 }, cacheSize{ cacheSize } {}
+
+			bool contains(uint32_t vertex) const { return time - cachedAt[vertex] <= cacheSize; }
+			// true on a miss
+			bool access(uint32_t vertex) {
+				if (contains(vertex)) return false;
+				cachedAt[vertex] = time++;
+				return true;
+			}
+			void reset() { time += cacheSize + 1; }
+
+			std::vector<uint32_t> cachedAt;
+			uint32_t time;
+			uint32_t cacheSize;
+		};
+
+		glm::vec3 triangleCross(const std::vector<AmasModel::Vertex>& vertices, const uint32_t* triangle) {
+			const glm::vec3& a = vertices[triangle[0]].position;
+			return glm::cross(vertices[triangle[1]].position - a, vertices[triangle[2]].position - a);
+		}
+
+		glm::vec3 triangleCentroid(const std::vector<AmasModel::Vertex>& vertices, const uint32_t* triangle) {
+			return (vertices[triangle[0]].position + vertices[triangle[1]].position + vertices[triangle[2]].position) / 3.f;
+		}
+
+	}  // namespace
+
+	AmasMeshOptimizer::Statistics AmasMeshOptimizer::analyzeVertexCache(
+		const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize) {
+		Statistics statistics{};
+		if (indices.size() < 3 || vertexCount == 0) return statistics;
+
+		VertexCache cache{ vertexCount, cacheSize };
+		std::vector<bool> used(vertexCount, false);
+		uint32_t misses = 0;
+		uint32_t usedCount = 0;
+		for (uint32_t vertex : indices) {
+			misses += cache.access(vertex) ? 1 : 0;
+			if (!used[vertex]) {
+				used[vertex] = true;
+				usedCount++;
+			}
+		}
+
+		statistics.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+		statistics.atvr = static_cast<float>(misses) / static_cast<float>(usedCount);
+		return statistics;
+	}
+
+	void AmasMeshOptimizer::optimizeVertexCache(
+		std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>* clusters, uint32_t cacheSize) {
+		assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+		if (clusters != nullptr) clusters->clear();
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		if (triangleCount == 0) return;
+
+		// triangles around every vertex, and how many of them are still to be emitted
+		std::vector<uint32_t> liveCount(vertexCount, 0);
+		for (uint32_t vertex : indices) {
+			liveCount[vertex]++;
+		}
+		std::vector<uint32_t> offsets(vertexCount + 1, 0);
+		std::partial_sum(liveCount.begin(), liveCount.end(), offsets.begin() + 1);
+		std::vector<uint32_t> adjacency(indices.size());
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (uint32_t i = 0; i < indices.size(); i++) {
+			adjacency[fill[indices[i]]++] = i / 3;
+		}
+
+		VertexCache cache{ vertexCount, cacheSize };
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnds{};
+		std::vector<uint32_t> candidates{};
+		std::vector<uint32_t> result{};
+		result.reserve(indices.size());
+		uint32_t scanCursor = 0;
+
+		// recently used vertices with triangles left first, then the first such vertex in index order
+		auto skipDeadEnd = [&]() -> uint32_t {
+			while (!deadEnds.empty()) {
+				uint32_t vertex = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveCount[vertex] > 0) return vertex;
+			}
+			for (; scanCursor < vertexCount; scanCursor++) {
+				if (liveCount[scanCursor] > 0) return scanCursor++;
+			}
+			return NO_VERTEX;
+		};
+
+		uint32_t fan = skipDeadEnd();
+		if (clusters != nullptr) clusters->push_back(0);
+		while (fan != NO_VERTEX) {
+			candidates.clear();
+			for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; a++) {
+				uint32_t triangle = adjacency[a];
+				if (emitted[triangle]) continue;
+				emitted[triangle] = true;
+				for (uint32_t k = 0; k < 3; k++) {
+					uint32_t vertex = indices[3 * triangle + k];
+					result.push_back(vertex);
+					deadEnds.push_back(vertex);
+					candidates.push_back(vertex);
+					liveCount[vertex]--;
+					cache.access(vertex);
+				}
+			}
+
+			// the oldest candidate that stays cached while its remaining triangles are emitted,
+			// any candidate with triangles left otherwise
+			uint32_t next = NO_VERTEX;
+			int64_t bestPriority = -1;
+			for (uint32_t vertex : candidates) {
+				if (liveCount[vertex] == 0) continue;
+				int64_t priority = 0;
+				const uint32_t age = cache.time - cache.cachedAt[vertex];
+				if (age + 2 * liveCount[vertex] <= cacheSize) {
+					priority = age;
+				}
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					next = vertex;
+				}
+			}
+			if (next == NO_VERTEX) {
+				next = skipDeadEnd();
+				if (next != NO_VERTEX && clusters != nullptr) {
+					clusters->push_back(static_cast<uint32_t>(result.size() / 3));
+				}
+			}
+			fan = next;
+		}
+
+		indices.swap(result);
+	}
+
+	void AmasMeshOptimizer::optimizeOverdraw(
+		std::vector<uint32_t>& indices,
+		const std::vector<AmasModel::Vertex>& vertices,
+		const std::vector<uint32_t>& clusters,
+		uint32_t cacheSize) {
+		// a cluster is cut once its own miss ratio is within this factor of the whole run's
+		static constexpr float SPLIT_THRESHOLD = 1.05f;
+
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		if (triangleCount == 0) return;
+		const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+		std::vector<uint32_t> hardStarts = clusters.empty() ? std::vector<uint32_t>{ 0 } : clusters;
+		hardStarts.push_back(triangleCount);
+
+		std::vector<uint32_t> starts{};
+		VertexCache cache{ vertexCount, cacheSize };
+		for (size_t c = 0; c + 1 < hardStarts.size(); c++) {
+			const uint32_t begin = hardStarts[c];
+			const uint32_t end = hardStarts[c + 1];
+
+			cache.reset();
+			uint32_t misses = 0;
+			for (uint32_t i = 3 * begin; i < 3 * end; i++) {
+				misses += cache.access(indices[i]) ? 1 : 0;
+			}
+			const float runAcmr = static_cast<float>(misses) / static_cast<float>(end - begin);
+
+			cache.reset();
+			starts.push_back(begin);
+			uint32_t start = begin;
+			misses = 0;
+			for (uint32_t triangle = begin; triangle < end; triangle++) {
+				for (uint32_t k = 0; k < 3; k++) {
+					misses += cache.access(indices[3 * triangle + k]) ? 1 : 0;
+				}
+				const uint32_t size = triangle - start + 1;
+				if (triangle + 1 < end && static_cast<float>(misses) <= SPLIT_THRESHOLD * runAcmr * size) {
+					start = triangle + 1;
+					starts.push_back(start);
+					misses = 0;
+					cache.reset();
+				}
+			}
+		}
+		starts.push_back(triangleCount);
+
+		// area weighted, the centre of the surface rather than of the vertex cloud
+		glm::vec3 meshCentroid{ 0.f };
+		float meshArea = 0.f;
+		for (uint32_t triangle = 0; triangle < triangleCount; triangle++) {
+			const float area = glm::length(triangleCross(vertices, &indices[3 * triangle]));
+			meshCentroid += area * triangleCentroid(vertices, &indices[3 * triangle]);
+			meshArea += area;
+		}
+		if (meshArea > 0.f) meshCentroid /= meshArea;
+
+		// clusters whose average normal points away from the centre are in front of the rest
+		const uint32_t clusterCount = static_cast<uint32_t>(starts.size() - 1);
+		std::vector<float> facing(clusterCount, 0.f);
+		for (uint32_t c = 0; c < clusterCount; c++) {
+			glm::vec3 normal{ 0.f };
+			glm::vec3 centroid{ 0.f };
+			float area = 0.f;
+			for (uint32_t triangle = starts[c]; triangle < starts[c + 1]; triangle++) {
+				const glm::vec3 cross = triangleCross(vertices, &indices[3 * triangle]);
+				const float triangleArea = glm::length(cross);
+				normal += cross;
+				centroid += triangleArea * triangleCentroid(vertices, &indices[3 * triangle]);
+				area += triangleArea;
+			}
+			const float normalLength = glm::length(normal);
+			if (area > 0.f && normalLength > 0.f) {
+				facing[c] = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+			}
+		}
+
+		std::vector<uint32_t> order(clusterCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return facing[a] > facing[b]; });
+
+		std::vector<uint32_t> result{};
+		result.reserve(indices.size());
+		for (uint32_t c : order) {
+			result.insert(result.end(), indices.begin() + 3 * starts[c], indices.begin() + 3 * starts[c + 1]);
+		}
+		indices.swap(result);
+	}
+
+	void AmasMeshOptimizer::optimizeVertexFetch(std::vector<AmasModel::Vertex>& vertices, std::vector<uint32_t>& indices) {
+		std::vector<uint32_t> remap(vertices.size(), NO_VERTEX);
+		std::vector<AmasModel::Vertex> result{};
+		result.reserve(vertices.size());
+		for (uint32_t& index : indices) {
+			if (remap[index] == NO_VERTEX) {
+				remap[index] = static_cast<uint32_t>(result.size());
+				result.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices.swap(result);
+	}
+
+	void AmasMeshOptimizer::optimize(
+		AmasModel::Builder& builder, bool reduceOverdraw, Statistics* before, Statistics* after) {
+		const uint32_t vertexCount = static_cast<uint32_t>(builder.vertices.size());
+		std::vector<AmasModel::Lod> lods = builder.lods;
+		if (lods.empty()) {
+			lods.push_back({ 0, static_cast<uint32_t>(builder.indices.size()), 0.f });
+		}
+
+		// the statistics are those of the finest level
+		auto levelIndices = [&](const AmasModel::Lod& lod) {
+			auto first = builder.indices.begin() + lod.firstIndex;
+			return std::vector<uint32_t>(first, first + lod.indexCount);
+		};
+		if (before != nullptr) *before = analyzeVertexCache(levelIndices(lods[0]), vertexCount);
+
+		// every level is reordered on its own, they all index the same vertices
+		std::vector<uint32_t> clusters{};
+		for (const auto& lod : lods) {
+			std::vector<uint32_t> indices = levelIndices(lod);
+			optimizeVertexCache(indices, vertexCount, reduceOverdraw ? &clusters : nullptr);
+			if (reduceOverdraw) {
+				optimizeOverdraw(indices, builder.vertices, clusters);
+			}
+			std::copy(indices.begin(), indices.end(), builder.indices.begin() + lod.firstIndex);
+		}
+		optimizeVertexFetch(builder.vertices, builder.indices);
+
+		if (after != nullptr) {
+			*after = analyzeVertexCache(levelIndices(lods[0]), static_cast<uint32_t>(builder.vertices.size()));
+		}
+	}
+
+}  // namespace amas
@@ -0,0 +1,286 @@
+#include "../include/amas_mesh_simplifier.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace amas {
+
+	namespace {
+
+		constexpr uint32_t NO_VERTEX = std::numeric_limits<uint32_t>::max();
+
+		// Sum of squared distances to a set of planes, each weighted by the area of its triangle.
+		// Divided by the total weight it gives a mean squared distance.
+		struct Quadric {
+			double a2 = 0, b2 = 0, c2 = 0, ab = 0, ac = 0, bc = 0, ad = 0, bd = 0, cd = 0, d2 = 0;
+			double weight = 0;
+
+			static Quadric fromPlane(const glm::dvec3& n, double d, double weight) {
+				Quadric q{};
+				q.a2 = weight * n.x * n.x;
+				q.b2 = weight * n.y * n.y;
+				q.c2 = weight * n.z * n.z;
+				q.ab = weight * n.x * n.y;
+				q.ac = weight * n.x * n.z;
+				q.bc = weight * n.y * n.z;
+				q.ad = weight * n.x * d;
+				q.bd = weight * n.y * d;
+				q.cd = weight * n.z * d;
+				q.d2 = weight * d * d;
+				q.weight = weight;
+				return q;
+			}
+
+			Quadric& operator+=(const Quadric& other) {
+				a2 += other.a2; b2 += other.b2; c2 += other.c2;
+				ab += other.ab; ac += other.ac; bc += other.bc;
+				ad += other.ad; bd += other.bd; cd += other.cd;
+				d2 += other.d2;
+				weight += other.weight;
+				return *this;
+			}
+
+			double error(const glm::vec3& p) const {
+				const double x = p.x, y = p.y, z = p.z;
+				const double sum = a2 * x * x + b2 * y * y + c2 * z * z +
+					2 * (ab * x * y + ac * x * z + bc * y * z) + 2 * (ad * x + bd * y + cd * z) + d2;
+				return weight > 0 ? glm::max(sum, 0.0) / weight : 0.0;
+			}
+		};
+
+		struct PositionKey {
+			uint32_t x, y, z;
+			bool operator==(const PositionKey& other) const = default;
+		};
+
+		struct PositionKeyHash {
+			size_t operator()(const PositionKey& key) const {
+				uint64_t h = key.x * 0x9e3779b97f4a7c15ull;
+				h ^= key.y * 0xc2b2ae3d27d4eb4full;
+				h ^= key.z * 0x165667b19e3779f9ull;
+				return static_cast<size_t>(h ^ (h >> 29));
+			}
+		};
+
+		struct Collapse {
+			uint32_t from;  // welded vertices
+			uint32_t to;
+			float error;
+		};
+
+	}  // namespace
+
+	std::vector<uint32_t> AmasMeshSimplifier::simplify(
+		const std::vector<AmasModel::Vertex>& vertices,
+		const std::vector<uint32_t>& indices,
+		size_t targetIndexCount,
+		float maxError,
+		float& resultError) {
+		assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+		resultError = 0.f;
+		std::vector<uint32_t> result = indices;
+		const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+		if (result.size() <= targetIndexCount || vertexCount == 0) return result;
+
+		// vertices sharing a position are one vertex of the topology, split only by their attributes
+		std::vector<uint32_t> welded(vertexCount);
+		std::vector<uint32_t> weldedCount(vertexCount, 0);
+		{
+			std::unordered_map<PositionKey, uint32_t, PositionKeyHash> firstAt{};
+			firstAt.reserve(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				PositionKey key{};
+				std::memcpy(&key, &vertices[v].position, sizeof(key));
+				welded[v] = firstAt.try_emplace(key, v).first->second;
+				weldedCount[welded[v]]++;
+			}
+		}
+
+		// A vertex split by a seam or on an open border cannot move without tearing the mesh, it
+		// can only receive collapses.
+		std::vector<bool> locked(vertexCount, false);
+		{
+			std::unordered_set<uint64_t> edges{};
+			edges.reserve(result.size());
+			auto edgeKey = [](uint32_t a, uint32_t b) { return (uint64_t{ a } << 32) | b; };
+			for (size_t i = 0; i < result.size(); i += 3) {
+				for (int k = 0; k < 3; k++) {
+					edges.insert(edgeKey(welded[result[i + k]], welded[result[i + (k + 1) % 3]]));
+				}
+			}
+			for (size_t i = 0; i < result.size(); i += 3) {
+				for (int k = 0; k < 3; k++) {
+					const uint32_t a = welded[result[i + k]];
+					const uint32_t b = welded[result[i + (k + 1) % 3]];
+					if (edges.count(edgeKey(b, a)) == 0) {
+						locked[a] = locked[b] = true;
+					}
+				}
+			}
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				if (weldedCount[welded[v]] > 1) locked[welded[v]] = true;
+			}
+		}
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i < result.size(); i += 3) {
+			const glm::dvec3 p0 = vertices[result[i]].position;
+			const glm::dvec3 p1 = vertices[result[i + 1]].position;
+			const glm::dvec3 p2 = vertices[result[i + 2]].position;
+			glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const double length = glm::length(normal);
+			if (length <= 0.0) continue;
+			normal /= length;
+			const Quadric plane = Quadric::fromPlane(normal, -glm::dot(normal, p0), length * .5);
+			for (int k = 0; k < 3; k++) {
+				quadrics[welded[result[i + k]]] += plane;
+			}
+		}
+
+		const float maxSquaredError = maxError * maxError;
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+		std::vector<uint32_t> adjacency{};
+		std::vector<Collapse> collapses{};
+		std::vector<bool> touched(vertexCount);
+		std::vector<uint32_t> collapseTo(vertexCount, NO_VERTEX);
+		bool errorLimitReached = false;
+
+		while (result.size() > targetIndexCount && !errorLimitReached) {
+			const uint32_t triangleCount = static_cast<uint32_t>(result.size() / 3);
+
+			// triangles around every welded vertex
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (uint32_t vertex : result) {
+				adjacencyOffsets[welded[vertex] + 1]++;
+			}
+			std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+			adjacency.resize(result.size());
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32_t i = 0; i < result.size(); i++) {
+				adjacency[fill[welded[result[i]]]++] = i / 3;
+			}
+
+			collapses.clear();
+			for (uint32_t i = 0; i < result.size(); i += 3) {
+				for (int k = 0; k < 3; k++) {
+					const uint32_t a = welded[result[i + k]];
+					const uint32_t b = welded[result[i + (k + 1) % 3]];
+					if (!locked[a]) {
+						Quadric q = quadrics[a];
+						q += quadrics[b];
+						collapses.push_back({ a, b, static_cast<float>(q.error(vertices[b].position)) });
+					}
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+			// every collapse removes about two triangles, stop at the target
+			const uint32_t collapseGoal = static_cast<uint32_t>((result.size() - targetIndexCount) / 6 + 1);
+			uint32_t collapseCount = 0;
+			std::fill(touched.begin(), touched.end(), false);
+			for (const Collapse& collapse : collapses) {
+				if (collapseCount >= collapseGoal) break;
+				if (collapse.error > maxSquaredError) {
+					errorLimitReached = true;
+					break;
+				}
+				// one collapse per neighbourhood and pass, so the flip test below sees final positions
+				if (touched[collapse.from] || touched[collapse.to]) continue;
+
+				const glm::vec3& target = vertices[collapse.to].position;
+				uint32_t targetVertex = NO_VERTEX;
+				bool flips = false;
+				for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !flips; a++) {
+					const uint32_t* triangle = &result[3 * adjacency[a]];
+					int moved = -1;
+					bool sharesEdge = false;
+					for (int k = 0; k < 3; k++) {
+						const uint32_t vertex = welded[triangle[k]];
+						if (vertex == collapse.from) moved = k;
+						if (vertex == collapse.to) {
+							sharesEdge = true;
+							targetVertex = triangle[k];
+						}
+					}
+					if (sharesEdge || moved < 0) continue;
+
+					const glm::vec3& p0 = vertices[triangle[0]].position;
+					const glm::vec3& p1 = vertices[triangle[1]].position;
+					const glm::vec3& p2 = vertices[triangle[2]].position;
+					const glm::vec3 before = glm::cross(p1 - p0, p2 - p0);
+					glm::vec3 q[3] = { p0, p1, p2 };
+					q[moved] = target;
+					const glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+					flips = glm::dot(before, after) <= 0.f;
+				}
+				if (flips || targetVertex == NO_VERTEX) continue;
+
+				for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++) {
+					const uint32_t* triangle = &result[3 * adjacency[a]];
+					for (int k = 0; k < 3; k++) {
+						touched[welded[triangle[k]]] = true;
+					}
+				}
+				// the vertex is neither split nor on a border, so it is its own welded vertex
+				collapseTo[collapse.from] = targetVertex;
+				quadrics[collapse.to] += quadrics[collapse.from];
+				resultError = glm::max(resultError, collapse.error);
+				collapseCount++;
+			}
+			if (collapseCount == 0) break;
+
+			size_t kept = 0;
+			for (uint32_t triangle = 0; triangle < triangleCount; triangle++) {
+				uint32_t corners[3];
+				for (int k = 0; k < 3; k++) {
+					const uint32_t vertex = result[3 * triangle + k];
+					corners[k] = collapseTo[vertex] != NO_VERTEX ? collapseTo[vertex] : vertex;
+				}
+				const uint32_t w0 = welded[corners[0]], w1 = welded[corners[1]], w2 = welded[corners[2]];
+				if (w0 == w1 || w1 == w2 || w0 == w2) continue;
+				result[kept++] = corners[0];
+				result[kept++] = corners[1];
+				result[kept++] = corners[2];
+			}
+			result.resize(kept);
+			// collapsed vertices no longer appear, their entries can stay
+		}
+
+		resultError = std::sqrt(resultError);
+		return result;
+	}
+
+	void AmasMeshSimplifier::generateLods(AmasModel::Builder& builder) {
+		const std::vector<uint32_t> source = builder.indices;
+		builder.lods.clear();
+		builder.lods.push_back({ 0, static_cast<uint32_t>(source.size()), 0.f });
+
+		const AmasModel::Bounds bounds = builder.bounds ? *builder.bounds : AmasModel::computeBounds(builder.vertices);
+		const float maxError = bounds.radius * MAX_LOD_ERROR;
+		size_t previousCount = source.size();
+		// every level starts from the full mesh, so its error is measured against the original surface
+		for (uint32_t lod = 1; lod < MAX_LOD_COUNT; lod++) {
+			const size_t target = (previousCount / 2) / 3 * 3;
+			if (target < 3) break;
+
+			float error = 0.f;
+			std::vector<uint32_t> indices = simplify(builder.vertices, source, target, maxError, error);
+			if (indices.empty() || indices.size() > previousCount * (1.f - MIN_LOD_REDUCTION)) break;
+
+			builder.lods.push_back({
+				static_cast<uint32_t>(builder.indices.size()),
+				static_cast<uint32_t>(indices.size()),
+				glm::max(error, builder.lods.back().error) });
+			builder.indices.insert(builder.indices.end(), indices.begin(), indices.end());
+			previousCount = indices.size();
+		}
+	}
+
+}  // namespace amas
@@ -0,0 +1,176 @@
+#include "../include/amas_meshlet_builder.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace amas {
+
+	namespace {
+
+		constexpr uint32_t NO_MESHLET = std::numeric_limits<uint32_t>::max();
+
+		struct PositionKey {
+			uint32_t x, y, z;
+			bool operator==(const PositionKey& other) const = default;
+		};
+
+		struct PositionKeyHash {
+			size_t operator()(const PositionKey& key) const {
+				uint64_t h = key.x * 0x9e3779b97f4a7c15ull;
+				h ^= key.y * 0xc2b2ae3d27d4eb4full;
+				h ^= key.z * 0x165667b19e3779f9ull;
+				return static_cast<size_t>(h ^ (h >> 29));
+			}
+		};
+
+	}  // namespace
+
+	int AmasMeshletBuilder::surfaceOrientation(
+		const std::vector<AmasModel::Vertex>& vertices, const uint32_t* indices, uint32_t indexCount) {
+		assert(indexCount % 3 == 0 && "Index count must be a multiple of 3");
+		if (indexCount == 0) return 0;
+
+		// vertices split by a seam still close the surface, edges are compared between positions
+		std::vector<uint32_t> welded(vertices.size());
+		{
+			std::unordered_map<PositionKey, uint32_t, PositionKeyHash> firstAt{};
+			firstAt.reserve(vertices.size());
+			for (uint32_t v = 0; v < vertices.size(); v++) {
+				PositionKey key{};
+				std::memcpy(&key, &vertices[v].position, sizeof(key));
+				welded[v] = firstAt.try_emplace(key, v).first->second;
+			}
+		}
+
+		// Every edge of a closed, consistently wound surface is walked once in each direction. The
+		// edges leaving each vertex are listed together, a vertex has few of them to search.
+		const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+		std::vector<uint32_t> offsets(vertexCount + 1, 0);
+		for (uint32_t i = 0; i < indexCount; i++) {
+			offsets[welded[indices[i]] + 1]++;
+		}
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+		std::vector<uint32_t> edgeEnds(indexCount);
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (uint32_t i = 0; i < indexCount; i += 3) {
+			for (int k = 0; k < 3; k++) {
+				edgeEnds[fill[welded[indices[i + k]]]++] = welded[indices[i + (k + 1) % 3]];
+			}
+		}
+		auto hasEdge = [&](uint32_t from, uint32_t to) {
+			return std::find(edgeEnds.begin() + offsets[from], edgeEnds.begin() + offsets[from + 1], to) !=
+				edgeEnds.begin() + offsets[from + 1];
+		};
+
+		double volume = 0.0;
+		for (uint32_t i = 0; i < indexCount; i += 3) {
+			for (int k = 0; k < 3; k++) {
+				if (!hasEdge(welded[indices[i + (k + 1) % 3]], welded[indices[i + k]])) return 0;
+			}
+			const glm::dvec3 p0 = vertices[indices[i]].position;
+			const glm::dvec3 p1 = vertices[indices[i + 1]].position;
+			const glm::dvec3 p2 = vertices[indices[i + 2]].position;
+			volume += glm::dot(p0, glm::cross(p1, p2));
+		}
+		return volume > 0.0 ? 1 : volume < 0.0 ? -1 : 0;
+	}
+
+	AmasModel::Meshlet AmasMeshletBuilder::computeBounds(
+		const std::vector<AmasModel::Vertex>& vertices, const uint32_t* indices, uint32_t indexCount, int orientation) {
+		AmasModel::Meshlet meshlet{};
+		meshlet.indexCount = indexCount;
+		if (indexCount == 0) return meshlet;
+
+		glm::vec3 min = vertices[indices[0]].position;
+		glm::vec3 max = min;
+		for (uint32_t i = 1; i < indexCount; i++) {
+			min = glm::min(min, vertices[indices[i]].position);
+			max = glm::max(max, vertices[indices[i]].position);
+		}
+		const glm::vec3 center = (min + max) * .5f;
+		float radius = 0.f;
+		for (uint32_t i = 0; i < indexCount; i++) {
+			radius = glm::max(radius, glm::length(vertices[indices[i]].position - center));
+		}
+		meshlet.sphere = glm::vec4(center, radius);
+
+		if (orientation == 0) return meshlet;
+
+		std::vector<glm::vec3> normals{};
+		normals.reserve(indexCount / 3);
+		glm::vec3 axis{ 0.f };
+		for (uint32_t i = 0; i < indexCount; i += 3) {
+			const glm::vec3& p0 = vertices[indices[i]].position;
+			const glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+			const float length = glm::length(normal);
+			// degenerate triangles have no side to face away with
+			if (length <= 0.f) continue;
+			normals.push_back(normal * (static_cast<float>(orientation) / length));
+			axis += normals.back();
+		}
+		const float axisLength = glm::length(axis);
+		if (normals.empty() || axisLength <= 0.f) return meshlet;
+		axis /= axisLength;
+
+		float minDot = 1.f;
+		for (const auto& normal : normals) {
+			minDot = glm::min(minDot, glm::dot(normal, axis));
+		}
+		// normals spread over a half space or more can face the viewer from anywhere
+		if (minDot <= 0.f) return meshlet;
+		meshlet.cone = glm::vec4(axis, std::sqrt(1.f - minDot * minDot));
+		return meshlet;
+	}
+
+	void AmasMeshletBuilder::build(AmasModel::Builder& builder) {
+		builder.meshlets.clear();
+		const uint32_t indexCount = builder.lods.empty()
+			? static_cast<uint32_t>(builder.indices.size())
+			: builder.lods[0].indexCount;
+		const uint32_t firstIndex = builder.lods.empty() ? 0 : builder.lods[0].firstIndex;
+		if (indexCount <= 3 * MAX_TRIANGLES && builder.vertices.size() <= MAX_VERTICES) return;
+
+		const uint32_t* indices = builder.indices.data() + firstIndex;
+		const int orientation = surfaceOrientation(builder.vertices, indices, indexCount);
+
+		std::vector<uint32_t> meshletOf(builder.vertices.size(), NO_MESHLET);
+		uint32_t meshletStart = 0;
+		uint32_t meshletVertices = 0;
+		auto finish = [&](uint32_t end) {
+			AmasModel::Meshlet meshlet = computeBounds(builder.vertices, indices + meshletStart, end - meshletStart, orientation);
+			meshlet.firstIndex = firstIndex + meshletStart;
+			builder.meshlets.push_back(meshlet);
+			meshletStart = end;
+			meshletVertices = 0;
+		};
+
+		for (uint32_t i = 0; i < indexCount; i += 3) {
+			uint32_t current = static_cast<uint32_t>(builder.meshlets.size());
+			auto newVertices = [&]() {
+				uint32_t count = 0;
+				for (uint32_t k = 0; k < 3; k++) {
+					const uint32_t vertex = indices[i + k];
+					const bool repeated = (k > 0 && indices[i] == vertex) || (k > 1 && indices[i + 1] == vertex);
+					count += meshletOf[vertex] != current && !repeated ? 1 : 0;
+				}
+				return count;
+			};
+			if (i - meshletStart == 3 * MAX_TRIANGLES || meshletVertices + newVertices() > MAX_VERTICES) {
+				finish(i);
+				current++;
+			}
+			meshletVertices += newVertices();
+			for (uint32_t k = 0; k < 3; k++) {
+				meshletOf[indices[i + k]] = current;
+			}
+		}
+		finish(indexCount);
+	}
+
+}  // namespace amas
@@ -1,36 +1,198 @@
 #include "../include/amas_model.hpp"
-#include "../include/amas_utils.hpp"
+#include "../include/amas_file_system.hpp"
+#include "../include/amas_geometry_pool.hpp"
+#include "../include/amas_job_system.hpp"
+#include "../include/amas_mesh_cache.hpp"
+#include "../include/amas_mesh_optimizer.hpp"
+#include "../include/amas_mesh_simplifier.hpp"
+#include "../include/amas_meshlet_builder.hpp"
 
 // libs
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "../externals/tinyobjloader/tiny_obj_loader.h"
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+#include <glm/gtc/packing.hpp>
 
 // std
+#include <algorithm>
 #include <cassert>
 #include <cstring>
-#include <unordered_map>
+#include <iostream>
+#include <istream>
+#include <limits>
+#include <sstream>
 
-namespace std {
-	template <>
-	struct hash<amas::AmasModel::Vertex> {
-		size_t operator()(amas::AmasModel::Vertex const& vertex) const {
-			size_t seed = 0;
-			amas::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-			return seed;
+namespace amas {
+
+	namespace {
+
+		// Open addressing map from an OBJ index triple to the vertex it became. Sized up front from
+		// the number of indices it may see, so it never rehashes and stays at most two thirds full
+		// even when no index repeats.
+		class IndexTripleMap {
+		public:
+			explicit IndexTripleMap(size_t indexCount) {
+				size_t capacity = 16;
+				while (capacity < indexCount + indexCount / 2) capacity <<= 1;
+				mask = capacity - 1;
+				slots.resize(capacity);
+			}
+
+			// vertex the triple maps to, newVertex after inserting it when it was not there yet
+			uint32_t findOrInsert(const tinyobj::index_t& key, uint32_t newVertex, bool& inserted) {
+				size_t slot = hash(key) & mask;
+				while (true) {
+					Slot& entry = slots[slot];
+					if (entry.vertex == EMPTY) {
+						entry = { key.vertex_index, key.normal_index, key.texcoord_index, newVertex };
+						inserted = true;
+						return newVertex;
+					}
+					if (entry.position == key.vertex_index && entry.normal == key.normal_index &&
+						entry.texcoord == key.texcoord_index) {
+						inserted = false;
+						return entry.vertex;
+					}
+					slot = (slot + 1) & mask;
+				}
+			}
+
+		private:
+			static constexpr uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+
+			struct Slot {
+				int position;
+				int normal;
+				int texcoord;
+				uint32_t vertex = EMPTY;
+			};
+
+			static size_t hash(const tinyobj::index_t& key) {
+				uint64_t h = static_cast<uint32_t>(key.vertex_index) * 0x9e3779b97f4a7c15ull;
+				h ^= static_cast<uint32_t>(key.normal_index) * 0xc2b2ae3d27d4eb4full;
+				h ^= static_cast<uint32_t>(key.texcoord_index) * 0x165667b19e3779f9ull;
+				return static_cast<size_t>(h ^ (h >> 29));
+			}
+
+			std::vector<Slot> slots;
+			size_t mask;
+		};
+
+		// matches the compact vertex in simple_shader.vert, the color is left out for SNORM16_NO_COLOR
+		struct CompactVertex {
+			uint16_t position[4];  // half or snorm16, w unused
+			uint32_t normal;       // octahedral, 2 x snorm16
+			uint32_t uv;           // 2 x half
+			uint32_t color;        // 4 x unorm8
+		};
+
+		// Maps the unit sphere onto the octahedron and unfolds it into [-1, 1]^2, octDecode in
+		// simple_shader.vert undoes it.
+		glm::vec2 octEncode(const glm::vec3& normal) {
+			const float sum = glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+			if (sum == 0.f) return glm::vec2(0.f);
+			glm::vec2 p = glm::vec2(normal) / sum;
+			if (normal.z < 0.f) {
+				const glm::vec2 sign{ p.x >= 0.f ? 1.f : -1.f, p.y >= 0.f ? 1.f : -1.f };
+				p = (1.f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+			}
+			return p;
 		}
-	};
-}  // namespace std
 
-namespace amas {
+		AmasModel::Vertex objVertex(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index) {
+			AmasModel::Vertex vertex{};
+
+			if (index.vertex_index >= 0) {
+				vertex.position = {
+					attrib.vertices[3 * index.vertex_index + 0],
+					attrib.vertices[3 * index.vertex_index + 1],
+					attrib.vertices[3 * index.vertex_index + 2],
+				};
+
+				vertex.color = {
+					attrib.colors[3 * index.vertex_index + 0],
+					attrib.colors[3 * index.vertex_index + 1],
+					attrib.colors[3 * index.vertex_index + 2],
+				};
+			}
+
+			if (index.normal_index >= 0) {
+				vertex.normal = {
+					attrib.normals[3 * index.normal_index + 0],
+					attrib.normals[3 * index.normal_index + 1],
+					attrib.normals[3 * index.normal_index + 2],
+				};
+			}
+
+			if (index.texcoord_index >= 0) {
+				vertex.uv = {
+					attrib.texcoords[2 * index.texcoord_index + 0],
+					attrib.texcoords[2 * index.texcoord_index + 1],
+				};
+			}
+
+			return vertex;
+		}
+
+		// Read-only view of a mapped file as a stream buffer, nothing is copied. The parser sees a
+		// window of the file at a time and the pages it has moved past leave the working set, so a
+		// large file does not stay resident alongside what was parsed out of it.
+		class MappedStreamBuffer : public std::streambuf {
+		public:
+			static constexpr size_t WINDOW_SIZE = 4u << 20;
+
+			explicit MappedStreamBuffer(const AmasFile& file) : file{ file } {
+				char* begin = window(0);
+				setg(begin, begin, window(std::min(WINDOW_SIZE, file.size())));
+			}
+
+		protected:
+			int_type underflow() override {
+				const size_t end = static_cast<size_t>(egptr() - window(0));
+				if (end >= file.size()) return traits_type::eof();
+				// the window before stays readable for putbacks, the one before that is released
+				const size_t start = end >= WINDOW_SIZE ? end - WINDOW_SIZE : 0;
+				if (start >= WINDOW_SIZE) file.release(start - WINDOW_SIZE, WINDOW_SIZE);
+				setg(window(start), window(end), window(std::min(end + WINDOW_SIZE, file.size())));
+				return traits_type::to_int_type(*gptr());
+			}
+
+		private:
+			char* window(size_t offset) const {
+				return const_cast<char*>(reinterpret_cast<const char*>(file.data())) + offset;
+			}
+
+			const AmasFile& file;
+		};
+
+		// Appends the vertices first seen in objIndices and the indices of all of them, relative to
+		// the start of vertices.
+		void dedupIndices(
+			const tinyobj::attrib_t& attrib,
+			const std::vector<tinyobj::index_t>& objIndices,
+			IndexTripleMap& uniqueVertices,
+			std::vector<AmasModel::Vertex>& vertices,
+			std::vector<uint32_t>& indices) {
+			for (const auto& index : objIndices) {
+				bool inserted;
+				uint32_t vertex = uniqueVertices.findOrInsert(index, static_cast<uint32_t>(vertices.size()), inserted);
+				if (inserted) {
+					vertices.push_back(objVertex(attrib, index));
+				}
+				indices.push_back(vertex);
+			}
+		}
+
+	}  // namespace
 
 	AmasModel::AmasModel(AmasDevice& device, const AmasModel::Builder& builder) : amasDevice{ device } {
-		createVertexBuffers(builder.vertices);
-		createIndexBuffers(builder.indices);
+		createMesh(builder);
 	}
 
-	AmasModel::~AmasModel() { }
+	AmasModel::~AmasModel() {
+		// the copies into our range of the pool must not land after it is reused
+		amasDevice.getUploader().wait(uploadTicket);
+		amasDevice.getGeometryPool().free(mesh);
+	}
 
 	std::unique_ptr<AmasModel> AmasModel::createModelFromFile(
 		AmasDevice& device, const std::string& filepath) {
@@ -39,156 +201,231 @@ namespace amas {
 		return std::make_unique<AmasModel>(device, builder);
 	}
 
-	void AmasModel::createVertexBuffers(const std::vector<Vertex>& vertices) {
-		vertexCount = static_cast<uint32_t>(vertices.size());
-		assert(vertexCount >= 3 && "Vertex count must be at least 3");
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-		uint32_t vertexSize = sizeof(vertices[0]);
-
-		AmasBuffer stagingBuffer{
-			amasDevice,
-			vertexSize,
-			vertexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		};
-
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)vertices.data());
-
-		vertexBuffer = std::make_unique<AmasBuffer>(
-			amasDevice,
-			vertexSize,
-			vertexCount,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	AmasModel::Bounds AmasModel::computeBounds(std::span<const Vertex> vertices) {
+		Bounds bounds{};
+		if (vertices.empty()) return bounds;
 
-		amasDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+		bounds.min = bounds.max = vertices[0].position;
+		for (const auto& vertex : vertices) {
+			bounds.min = glm::min(bounds.min, vertex.position);
+			bounds.max = glm::max(bounds.max, vertex.position);
+		}
+		bounds.center = (bounds.min + bounds.max) * .5f;
+		for (const auto& vertex : vertices) {
+			bounds.radius = glm::max(bounds.radius, glm::length(vertex.position - bounds.center));
+		}
+		return bounds;
 	}
 
-	void AmasModel::createIndexBuffers(const std::vector<uint32_t>& indices) {
-		indexCount = static_cast<uint32_t>(indices.size());
-		hasIndexBuffer = indexCount > 0;
-
-		if (!hasIndexBuffer) {
+	void AmasModel::encodeVertices(
+		std::span<const Vertex> vertices, const Bounds& bounds, VertexFormat format, PositionDecode& decode, void* destination) {
+		const uint32_t stride = Vertex::getStride(format);
+		auto* encoded = static_cast<uint8_t*>(destination);
+		if (format == VertexFormat::FLOAT) {
+			decode = {};
+			std::memcpy(encoded, vertices.data(), vertices.size_bytes());
 			return;
 		}
 
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-		uint32_t indexSize = sizeof(indices[0]);
+		// the box maps onto [-1, 1], an axis the mesh is flat along keeps a unit scale
+		decode.offset = (bounds.min + bounds.max) * .5f;
+		decode.scale = (bounds.max - bounds.min) * .5f;
+		for (int axis = 0; axis < 3; axis++) {
+			if (decode.scale[axis] <= 0.f) decode.scale[axis] = 1.f;
+		}
 
-		AmasBuffer stagingBuffer{
-			amasDevice,
-			indexSize,
-			indexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		};
+		for (size_t i = 0; i < vertices.size(); i++) {
+			const Vertex& vertex = vertices[i];
+			const glm::vec4 position{ glm::clamp((vertex.position - decode.offset) / decode.scale, -1.f, 1.f), 0.f };
+
+			CompactVertex compact{};
+			const uint64_t packedPosition =
+				format == VertexFormat::HALF ? glm::packHalf4x16(position) : glm::packSnorm4x16(position);
+			std::memcpy(compact.position, &packedPosition, sizeof(compact.position));
+			compact.normal = glm::packSnorm2x16(octEncode(vertex.normal));
+			compact.uv = glm::packHalf2x16(vertex.uv);
+			compact.color = glm::packUnorm4x8(glm::vec4(vertex.color, 1.f));
+			std::memcpy(encoded + i * stride, &compact, stride);
+		}
+	}
 
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)indices.data());
+	float AmasModel::positionErrorBound(VertexFormat format, const PositionDecode& decode) {
+		// half rounds values below 1 to 11 significant bits, snorm16 to steps of 1 / 32767
+		switch (format) {
+		case VertexFormat::HALF:
+			return glm::length(decode.scale) / 4096.f;
+		case VertexFormat::SNORM16:
+		case VertexFormat::SNORM16_NO_COLOR:
+			return glm::length(decode.scale) * .5f / 32767.f;
+		default:
+			return 0.f;
+		}
+	}
 
-		indexBuffer = std::make_unique<AmasBuffer>(
-			amasDevice,
-			indexSize,
-			indexCount,
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	void AmasModel::createMesh(const Builder& builder) {
+		const std::span<const Vertex> vertices = builder.getVertices();
+		const std::span<const uint32_t> indices = builder.getIndices();
+		uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+		assert(vertexCount >= 3 && "Vertex count must be at least 3");
 
+		bounds = builder.bounds ? *builder.bounds : computeBounds(vertices);
+		lods = builder.lods;
+		if (lods.empty()) {
+			lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.f });
+		}
+		meshlets = builder.meshlets;
 
-		amasDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+		// encoded straight into staging memory, the indices are copied there from wherever they live
+		mesh = amasDevice.getGeometryPool().allocate(
+			vertexCount,
+			Vertex::getStride(VERTEX_FORMAT),
+			[&](void* staging) { encodeVertices(vertices, bounds, VERTEX_FORMAT, positionDecode, staging); },
+			indices,
+			uploadTicket);
 	}
 
-	void AmasModel::draw(VkCommandBuffer commandBuffer) {
-		if (hasIndexBuffer) {
-			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
-		}
-		else {
-			vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
-		}
+	void AmasModel::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance, uint32_t lod) {
+		vkCmdDrawIndexed(
+			commandBuffer,
+			lods[lod].indexCount,
+			instanceCount,
+			mesh.firstIndex + lods[lod].firstIndex,
+			mesh.vertexOffset,
+			firstInstance);
 	}
 
 	void AmasModel::bind(VkCommandBuffer commandBuffer) {
-		VkBuffer buffers[] = { vertexBuffer->getBuffer() };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+		amasDevice.getGeometryPool().bind(commandBuffer, mesh.page);
+	}
 
-		if (hasIndexBuffer) {
-			vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	uint32_t AmasModel::Vertex::getStride(VertexFormat format) {
+		switch (format) {
+		case VertexFormat::FLOAT:
+			return sizeof(Vertex);
+		case VertexFormat::SNORM16_NO_COLOR:
+			return offsetof(CompactVertex, color);
+		default:
+			return sizeof(CompactVertex);
 		}
 	}
 
-	std::vector<VkVertexInputBindingDescription> AmasModel::Vertex::getBindingDescriptions() {
+	std::vector<VkVertexInputBindingDescription> AmasModel::Vertex::getBindingDescriptions(VertexFormat format) {
 		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
 		bindingDescriptions[0].binding = 0;
-		bindingDescriptions[0].stride = sizeof(Vertex);
+		bindingDescriptions[0].stride = getStride(format);
 		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 		return bindingDescriptions;
 	}
 
-	std::vector<VkVertexInputAttributeDescription> AmasModel::Vertex::getAttributeDescriptions() {
+	std::vector<VkVertexInputAttributeDescription> AmasModel::Vertex::getAttributeDescriptions(VertexFormat format) {
 		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
 
-		attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position) });
-		attributeDescriptions.push_back({ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color) });
-		attributeDescriptions.push_back({ 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) });
-		attributeDescriptions.push_back({ 3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv) });
+		if (format == VertexFormat::FLOAT) {
+			attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position) });
+			attributeDescriptions.push_back({ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color) });
+			attributeDescriptions.push_back({ 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) });
+			attributeDescriptions.push_back({ 3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv) });
+			return attributeDescriptions;
+		}
+
+		// three component 16 bit formats are rarely supported for vertex input, positions take four
+		const VkFormat positionFormat =
+			format == VertexFormat::HALF ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R16G16B16A16_SNORM;
+		attributeDescriptions.push_back({ 0, 0, positionFormat, offsetof(CompactVertex, position) });
+		if (format != VertexFormat::SNORM16_NO_COLOR) {
+			attributeDescriptions.push_back({ 1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(CompactVertex, color) });
+		}
+		attributeDescriptions.push_back({ 2, 0, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, normal) });
+		attributeDescriptions.push_back({ 3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(CompactVertex, uv) });
 
 		return attributeDescriptions;
 	}
 
-	void AmasModel::Builder::loadModel(const std::string& filepath) {
+	void AmasModel::Builder::loadModel(const std::string& filepath, AmasJobSystem* jobSystem) {
+		if (AmasMeshCache::read(filepath, *this)) return;
+
+		loadObj(filepath, jobSystem);
+		AmasMeshSimplifier::generateLods(*this);
+
+		AmasMeshOptimizer::Statistics before{};
+		AmasMeshOptimizer::Statistics after{};
+		AmasMeshOptimizer::optimize(*this, true, &before, &after);
+		AmasMeshletBuilder::build(*this);
+		// one write, imports may run on several workers at once
+		std::ostringstream report{};
+		report << "Imported " << filepath << ":  ACMR " << before.acmr << " -> " << after.acmr
+			<< ",  ATVR " << before.atvr << " -> " << after.atvr << ",  LOD triangles";
+		for (const auto& lod : lods) {
+			report << " " << lod.indexCount / 3;
+		}
+		report << ",  " << meshlets.size() << " meshlets\n";
+		std::cout << report.str();
+
+		bounds = computeBounds(vertices);
+		AmasMeshCache::write(filepath, *this);
+	}
+
+	void AmasModel::Builder::loadObj(const std::string& filepath, AmasJobSystem* jobSystem) {
 		tinyobj::attrib_t attrib;
 		std::vector<tinyobj::shape_t> shapes;
 		std::vector<tinyobj::material_t> materials;
 		std::string warn, err;
 
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str())) {
+		// tinyobj parses from the mapped pages instead of an ifstream copying them into its buffer
+		const AmasFile file = AmasFileSystem::open(filepath);
+		MappedStreamBuffer buffer{ file };
+		std::istream stream{ &buffer };
+		tinyobj::MaterialFileReader materialReader{ "" };
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream, &materialReader)) {
 			throw std::runtime_error(warn + err);
 		}
 
 		vertices.clear();
 		indices.clear();
-
-		std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+		bounds.reset();
+		lods.clear();
+		meshlets.clear();
+		mappedFile.reset();
+		mappedVertices = {};
+		mappedIndices = {};
+
+		size_t indexCount = 0;
 		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				Vertex vertex{};
-
-				if (index.vertex_index >= 0) {
-					vertex.position = {
-						attrib.vertices[3 * index.vertex_index + 0],
-						attrib.vertices[3 * index.vertex_index + 1],
-						attrib.vertices[3 * index.vertex_index + 2],
-					};
-
-					vertex.color = {
-						attrib.colors[3 * index.vertex_index + 0],
-						attrib.colors[3 * index.vertex_index + 1],
-						attrib.colors[3 * index.vertex_index + 2],
-					};
-				}
-
-				if (index.normal_index >= 0) {
-					vertex.normal = {
-						attrib.normals[3 * index.normal_index + 0],
-						attrib.normals[3 * index.normal_index + 1],
-						attrib.normals[3 * index.normal_index + 2],
-					};
-				}
+			indexCount += shape.mesh.indices.size();
+		}
+		indices.reserve(indexCount);
+
+		// vertices are keyed on the position, normal and texcoord indices rather than their values,
+		// so two OBJ vertices only merge when they come from the same triple
+		if (jobSystem == nullptr || shapes.size() < 2) {
+			IndexTripleMap uniqueVertices{ indexCount };
+			for (const auto& shape : shapes) {
+				dedupIndices(attrib, shape.mesh.indices, uniqueVertices, vertices, indices);
+			}
+			return;
+		}
 
-				if (index.texcoord_index >= 0) {
-					vertex.uv = {
-						attrib.texcoords[2 * index.texcoord_index + 0],
-						attrib.texcoords[2 * index.texcoord_index + 1],
-					};
-				}
+		// Every shape deduplicated on its own, then appended in order. A triple used by two shapes
+		// becomes two vertices.
+		struct ShapeResult {
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+		};
+		std::vector<ShapeResult> results(shapes.size());
+		jobSystem->parallelFor(static_cast<uint32_t>(shapes.size()), 1, [&](uint32_t first, uint32_t last) {
+			for (uint32_t i = first; i < last; i++) {
+				const auto& objIndices = shapes[i].mesh.indices;
+				IndexTripleMap uniqueVertices{ objIndices.size() };
+				results[i].indices.reserve(objIndices.size());
+				dedupIndices(attrib, objIndices, uniqueVertices, results[i].vertices, results[i].indices);
+			}
+		});
 
-				if (uniqueVertices.count(vertex) == 0) {
-					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-					vertices.push_back(vertex);
-				}
-				indices.push_back(uniqueVertices[vertex]);
+		for (const auto& result : results) {
+			const uint32_t base = static_cast<uint32_t>(vertices.size());
+			vertices.insert(vertices.end(), result.vertices.begin(), result.vertices.end());
+			for (uint32_t index : result.indices) {
+				indices.push_back(base + index);
 			}
 		}
 	}
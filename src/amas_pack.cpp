@@ -0,0 +1,205 @@
+#include "../include/amas_pack.hpp"
+#include "../include/amas_lz4.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace amas {
+
+	namespace {
+
+		struct FileHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t entryCount;
+			uint32_t alignment;
+			uint64_t namesOffset;
+			uint64_t namesSize;
+		};
+
+		// the table of contents follows the header, the path strings follow the table
+		struct FileEntry {
+			uint64_t nameOffset;  // into the path strings
+			uint64_t offset;
+			uint64_t storedSize;
+			uint64_t size;
+			int64_t sourceTime;
+			uint32_t nameSize;
+			uint32_t compression;
+		};
+
+		uint64_t alignUp(uint64_t value) {
+			return (value + AmasPack::ALIGNMENT - 1) / AmasPack::ALIGNMENT * AmasPack::ALIGNMENT;
+		}
+
+		// keyed the same way as the mesh cache keys its sources
+		int64_t sourceTime(const std::string& filepath) {
+			std::error_code error;
+			auto writeTime = std::filesystem::last_write_time(filepath, error);
+			return error ? 0 : static_cast<int64_t>(writeTime.time_since_epoch().count());
+		}
+
+	}  // namespace
+
+	AmasPack::AmasPack(const std::string& filepath) {
+		// Entries are read one by one, the pack is not read ahead as a whole. Not RANDOM either, that
+		// would also stop the pages around a fault being mapped with it.
+		auto file = std::make_shared<AmasMappedFile>(filepath, AmasMappedFile::Access::NORMAL);
+		const uint8_t* data = file->data();
+		const uint64_t packSize = file->size();
+
+		FileHeader header{};
+		if (packSize < sizeof(FileHeader)) {
+			throw std::runtime_error("invalid pack file: " + filepath);
+		}
+		std::memcpy(&header, data, sizeof(header));
+		const uint64_t tableSize = uint64_t{ header.entryCount } * sizeof(FileEntry);
+		if (header.magic != MAGIC || header.version != VERSION || header.alignment != ALIGNMENT ||
+			header.namesOffset != sizeof(FileHeader) + tableSize ||
+			header.namesSize > packSize || header.namesOffset > packSize - header.namesSize) {
+			throw std::runtime_error("invalid pack file: " + filepath);
+		}
+
+		const char* names = reinterpret_cast<const char*>(data + header.namesOffset);
+		entries.resize(header.entryCount);
+		for (uint32_t i = 0; i < header.entryCount; i++) {
+			FileEntry fileEntry{};
+			std::memcpy(&fileEntry, data + sizeof(FileHeader) + i * sizeof(FileEntry), sizeof(fileEntry));
+			if (fileEntry.nameOffset > header.namesSize || fileEntry.nameSize > header.namesSize - fileEntry.nameOffset ||
+				fileEntry.storedSize > packSize || fileEntry.offset > packSize - fileEntry.storedSize ||
+				fileEntry.compression > static_cast<uint32_t>(Compression::LZ4) ||
+				(fileEntry.compression == static_cast<uint32_t>(Compression::NONE) && fileEntry.size != fileEntry.storedSize)) {
+				throw std::runtime_error("invalid pack file: " + filepath);
+			}
+
+			Entry& entry = entries[i];
+			entry.path = { names + fileEntry.nameOffset, fileEntry.nameSize };
+			entry.offset = fileEntry.offset;
+			entry.storedSize = fileEntry.storedSize;
+			entry.size = fileEntry.size;
+			entry.sourceTime = fileEntry.sourceTime;
+			entry.compression = static_cast<Compression>(fileEntry.compression);
+			// lookups binary search the table
+			if (i > 0 && !(entries[i - 1].path < entry.path)) {
+				throw std::runtime_error("invalid pack file: " + filepath);
+			}
+		}
+		mapping = std::move(file);
+	}
+
+	const AmasPack::Entry* AmasPack::find(std::string_view path) const {
+		auto it = std::lower_bound(entries.begin(), entries.end(), path, [](const Entry& entry, std::string_view key) {
+			return entry.path < key;
+		});
+		return it != entries.end() && it->path == path ? &*it : nullptr;
+	}
+
+	void AmasPack::write(const std::string& filepath, std::vector<Source> sources) {
+		for (auto& source : sources) {
+			source.path = normalizePath(source.path);
+		}
+		std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) { return a.path < b.path; });
+
+		std::string names{};
+		std::vector<FileEntry> table(sources.size());
+		for (size_t i = 0; i < sources.size(); i++) {
+			if (i > 0 && sources[i - 1].path == sources[i].path) {
+				throw std::runtime_error("duplicate pack entry: " + sources[i].path);
+			}
+			table[i].nameOffset = names.size();
+			table[i].nameSize = static_cast<uint32_t>(sources[i].path.size());
+			names += sources[i].path;
+		}
+
+		FileHeader header{};
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.entryCount = static_cast<uint32_t>(sources.size());
+		header.alignment = ALIGNMENT;
+		header.namesOffset = sizeof(FileHeader) + table.size() * sizeof(FileEntry);
+		header.namesSize = names.size();
+
+		// written aside and renamed into place, a running engine never maps half a pack
+		const std::string tempPath = filepath + ".tmp";
+		{
+			std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+			auto fail = [&](const std::string& message) {
+				file.close();
+				std::error_code error;
+				std::filesystem::remove(tempPath, error);
+				throw std::runtime_error(message);
+			};
+			if (!file) {
+				fail("failed to write pack file: " + filepath);
+			}
+
+			// the entries go first, the table is written over the zeroed space before them once
+			// their offsets and sizes are known
+			uint64_t position = 0;
+			auto padTo = [&](uint64_t offset) {
+				static const char zeros[ALIGNMENT]{};
+				for (; position < offset; position += std::min<uint64_t>(offset - position, ALIGNMENT)) {
+					file.write(zeros, std::min<uint64_t>(offset - position, ALIGNMENT));
+				}
+			};
+			padTo(header.namesOffset + header.namesSize);
+
+			for (size_t i = 0; i < sources.size(); i++) {
+				AmasMappedFile source{};
+				if (!source.open(sources[i].filepath, AmasMappedFile::Access::SEQUENTIAL)) {
+					fail("failed to open file: " + sources[i].filepath);
+				}
+				const char* payload = reinterpret_cast<const char*>(source.data());
+				uint64_t payloadSize = source.size();
+				table[i].compression = static_cast<uint32_t>(Compression::NONE);
+
+				std::vector<uint8_t> compressed{};
+				if (sources[i].compress && source.size() > 0) {
+					compressed = AmasLz4::compress(source.data(), source.size());
+					if (compressed.size() <= source.size() - source.size() / 8) {
+						payload = reinterpret_cast<const char*>(compressed.data());
+						payloadSize = compressed.size();
+						table[i].compression = static_cast<uint32_t>(Compression::LZ4);
+					}
+				}
+
+				padTo(alignUp(position));
+				table[i].offset = position;
+				table[i].storedSize = payloadSize;
+				table[i].size = source.size();
+				table[i].sourceTime = sourceTime(sources[i].filepath);
+				file.write(payload, static_cast<std::streamsize>(payloadSize));
+				position += payloadSize;
+			}
+
+			file.seekp(0);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(FileEntry));
+			file.write(names.data(), names.size());
+			if (!file) {
+				fail("failed to write pack file: " + filepath);
+			}
+		}
+		std::error_code error;
+		std::filesystem::rename(tempPath, filepath, error);
+		if (error) {
+			std::filesystem::remove(tempPath, error);
+			throw std::runtime_error("failed to write pack file: " + filepath);
+		}
+	}
+
+	std::string AmasPack::normalizePath(std::string_view path) {
+		std::string normalized{ path };
+		std::replace(normalized.begin(), normalized.end(), '\\', '/');
+		while (normalized.rfind("./", 0) == 0) {
+			normalized.erase(0, 2);
+		}
+		return normalized;
+	}
+
+}  // namespace amas
@@ -1,9 +1,9 @@
 #include "../include/amas_pipeline.hpp"
 #include "../include/amas_model.hpp"
+#include "../include/amas_mapped_file.hpp"
 
 // std
 #include <cassert>
-#include <fstream>
 #include <iostream>
 #include <stdexcept>
 
@@ -18,27 +18,16 @@ namespace amas {
 		createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
 	}
 
+	AmasPipeline::AmasPipeline(AmasDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout)
+		: amasDevice{ device }, bindPoint{ VK_PIPELINE_BIND_POINT_COMPUTE } {
+		createComputePipeline(compFilepath, pipelineLayout);
+	}
+
 	AmasPipeline::~AmasPipeline() {
 		vkDestroyShaderModule(amasDevice.device(), vertShaderModule, nullptr);
 		vkDestroyShaderModule(amasDevice.device(), fragShaderModule, nullptr);
-		vkDestroyPipeline(amasDevice.device(), graphicsPipeline, nullptr);
-	}
-
-	std::vector<char> AmasPipeline::readFile(const std::string& filepath) {
-		std::ifstream file{ filepath, std::ios::ate | std::ios::binary };
-
-		if (!file.is_open()) {
-			throw std::runtime_error("failed to open file: " + filepath);
-		}
-
-		size_t fileSize = static_cast<size_t>(file.tellg());
-		std::vector<char> buffer(fileSize);
-
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
-
-		file.close();
-		return buffer;
+		vkDestroyShaderModule(amasDevice.device(), compShaderModule, nullptr);
+		vkDestroyPipeline(amasDevice.device(), pipeline, nullptr);
 	}
 
 	void AmasPipeline::createGraphicsPipeline(
@@ -52,8 +41,9 @@ namespace amas {
 			configInfo.renderPass != VK_NULL_HANDLE &&
 			"Cannot create graphics pipeline: no renderPass provided in configInfo");
 
-		auto vertCode = readFile(vertFilepath);
-		auto fragCode = readFile(fragFilepath);
+		// SPIR-V is handed to the driver straight from the mapped files
+		const AmasFile vertCode = AmasFileSystem::open(vertFilepath);
+		const AmasFile fragCode = AmasFileSystem::open(fragFilepath);
 
 		createShaderModule(vertCode, &vertShaderModule);
 		createShaderModule(fragCode, &fragShaderModule);
@@ -110,15 +100,48 @@ namespace amas {
 			1,
 			&pipelineInfo,
 			nullptr,
-			&graphicsPipeline) != VK_SUCCESS) {
+			&pipeline) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create graphics pipeline");
 		}
 	}
 
-	void AmasPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
+	void AmasPipeline::createComputePipeline(const std::string& compFilepath, VkPipelineLayout pipelineLayout) {
+		assert(
+			pipelineLayout != VK_NULL_HANDLE &&
+			"Cannot create compute pipeline: no pipelineLayout provided");
+
+		const AmasFile compCode = AmasFileSystem::open(compFilepath);
+		createShaderModule(compCode, &compShaderModule);
+
+		VkPipelineShaderStageCreateInfo shaderStage{};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderStage.module = compShaderModule;
+		shaderStage.pName = "main";
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = shaderStage;
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineIndex = -1;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+		if (vkCreateComputePipelines(
+			amasDevice.device(),
+			VK_NULL_HANDLE,
+			1,
+			&pipelineInfo,
+			nullptr,
+			&pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline");
+		}
+	}
+
+	void AmasPipeline::createShaderModule(const AmasFile& code, VkShaderModule* shaderModule) {
 		VkShaderModuleCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 		createInfo.codeSize = code.size();
+		// mappings and pack entries start on a page boundary, aligned for the uint32_t words of SPIR-V
 		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
 		if (vkCreateShaderModule(amasDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
@@ -127,7 +150,7 @@ namespace amas {
 	}
 
 	void AmasPipeline::bind(VkCommandBuffer commandBuffer) {
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+		vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
 	}
 
 	void AmasPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
@@ -1,19 +1,27 @@
 #include "../include/amas_renderer.hpp"
+#include "../include/amas_geometry_pool.hpp"
+#include "../include/amas_uploader.hpp"
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <exception>
 #include <stdexcept>
 
 namespace amas {
 
-	AmasRenderer::AmasRenderer(AmasWindow& window, AmasDevice& device)
-		: amasWindow{ window }, amasDevice{ device } {
+	AmasRenderer::AmasRenderer(AmasWindow& window, AmasDevice& device, AmasJobSystem& jobSystem)
+		: amasWindow{ window }, amasDevice{ device }, jobSystem{ jobSystem } {
 		recreateSwapChain();
 		createCommandBuffers();
+		createRecordingSlots();
 	}
 
-	AmasRenderer::~AmasRenderer() { freeCommandBuffers(); }
+	AmasRenderer::~AmasRenderer() {
+		freeCommandBuffers();
+		destroyRecordingSlots();
+	}
 
 	void AmasRenderer::recreateSwapChain() {
 		auto extent = amasWindow.getExtent();
@@ -60,6 +68,35 @@ namespace amas {
 		commandBuffers.clear();
 	}
 
+	void AmasRenderer::createRecordingSlots() {
+		recordingSlotCount = std::clamp(jobSystem.getThreadCount(), 1u, MAX_RECORDING_SLOTS);
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = amasDevice.findPhysicalQueueFamilies().graphicsFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		recordingSlots.resize(AmasSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& frameSlots : recordingSlots) {
+			frameSlots.resize(recordingSlotCount);
+			for (auto& slot : frameSlots) {
+				if (vkCreateCommandPool(amasDevice.device(), &poolInfo, nullptr, &slot.commandPool) != VK_SUCCESS) {
+					throw std::runtime_error("failed to create recording command pool!");
+				}
+			}
+		}
+	}
+
+	void AmasRenderer::destroyRecordingSlots() {
+		// destroying a pool frees its command buffers
+		for (auto& frameSlots : recordingSlots) {
+			for (auto& slot : frameSlots) {
+				vkDestroyCommandPool(amasDevice.device(), slot.commandPool, nullptr);
+			}
+		}
+		recordingSlots.clear();
+	}
+
 	VkCommandBuffer AmasRenderer::beginFrame() {
 		assert(!isFrameStarted && "Can't call beginFrame while already in progress");
 
@@ -75,6 +112,14 @@ namespace amas {
 
 		isFrameStarted = true;
 
+		// the fence waited on by acquireNextImage covers the secondary buffers of this frame too
+		for (auto& slot : recordingSlots[currentFrameIndex]) {
+			if (slot.usedCount == 0) continue;
+			vkResetCommandPool(amasDevice.device(), slot.commandPool, 0);
+			slot.usedCount = 0;
+		}
+		amasDevice.getGeometryPool().beginFrame();
+
 		auto commandBuffer = getCurrentCommandBuffer();
 		VkCommandBufferBeginInfo beginInfo{};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -92,6 +137,11 @@ namespace amas {
 			throw std::runtime_error("failed to record command buffer!");
 		}
 
+		// uploads recorded this frame go to the queue ahead of the draws that read them
+		auto& uploader = amasDevice.getUploader();
+		uploader.submit();
+		uploader.collect();
+
 		auto result = amasSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
 			amasWindow.wasWindowResized()) {
@@ -106,7 +156,7 @@ namespace amas {
 		currentFrameIndex = (currentFrameIndex + 1) % AmasSwapChain::MAX_FRAMES_IN_FLIGHT;
 	}
 
-	void AmasRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+	void AmasRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents) {
 		assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
 		assert(
 			commandBuffer == getCurrentCommandBuffer() &&
@@ -126,8 +176,16 @@ namespace amas {
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+		subpassContents = contents;
+
+		// secondary command buffers do not inherit dynamic state, they set their own
+		if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+			setViewportAndScissor(commandBuffer);
+		}
+	}
 
+	void AmasRenderer::setViewportAndScissor(VkCommandBuffer commandBuffer) {
 		VkViewport viewport{};
 		viewport.x = 0.0f;
 		viewport.y = 0.0f;
@@ -145,7 +203,94 @@ namespace amas {
 		assert(
 			commandBuffer == getCurrentCommandBuffer() &&
 			"Can't end render pass on command buffer from a different frame");
+
+		if (!secondaryCommandBuffers.empty()) {
+			vkCmdExecuteCommands(
+				commandBuffer,
+				static_cast<uint32_t>(secondaryCommandBuffers.size()),
+				secondaryCommandBuffers.data());
+			secondaryCommandBuffers.clear();
+		}
 		vkCmdEndRenderPass(commandBuffer);
+		subpassContents = VK_SUBPASS_CONTENTS_INLINE;
+	}
+
+	VkCommandBuffer AmasRenderer::beginSecondaryCommandBuffer(uint32_t slot) {
+		auto& recordingSlot = recordingSlots[currentFrameIndex][slot];
+		if (recordingSlot.usedCount == recordingSlot.commandBuffers.size()) {
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = recordingSlot.commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(amasDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate secondary command buffer!");
+			}
+			recordingSlot.commandBuffers.push_back(commandBuffer);
+		}
+		VkCommandBuffer commandBuffer = recordingSlot.commandBuffers[recordingSlot.usedCount++];
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = amasSwapChain->getRenderPass();
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = amasSwapChain->getFrameBuffer(currentImageIndex);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags =
+			VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording secondary command buffer!");
+		}
+		setViewportAndScissor(commandBuffer);
+		return commandBuffer;
+	}
+
+	void AmasRenderer::recordSecondary(uint32_t itemCount, uint32_t minItemsPerBuffer, const RecordFunction& record) {
+		assert(
+			subpassContents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS &&
+			"Secondary command buffers need a render pass begun for them");
+		if (itemCount == 0) {
+			return;
+		}
+
+		const uint32_t rangeCount = std::clamp(itemCount / std::max(minItemsPerBuffer, 1u), 1u, recordingSlotCount);
+		const size_t firstBuffer = secondaryCommandBuffers.size();
+		secondaryCommandBuffers.resize(firstBuffer + rangeCount);
+
+		// range n records from slot n, so no command pool is ever used by two threads at once
+		auto recordRange = [&](uint32_t range) {
+			const uint32_t first = static_cast<uint32_t>(uint64_t{ itemCount } * range / rangeCount);
+			const uint32_t last = static_cast<uint32_t>(uint64_t{ itemCount } * (range + 1) / rangeCount);
+			VkCommandBuffer commandBuffer = beginSecondaryCommandBuffer(range);
+			record(commandBuffer, first, last);
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to record secondary command buffer!");
+			}
+			secondaryCommandBuffers[firstBuffer + range] = commandBuffer;
+		};
+
+		AmasJobCounter counter;
+		for (uint32_t range = 1; range < rangeCount; range++) {
+			jobSystem.submit([&recordRange, range] { recordRange(range); }, &counter);
+		}
+		// the jobs reference this frame, they have to finish even if our own range fails
+		std::exception_ptr error;
+		try {
+			recordRange(0);
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		jobSystem.wait(counter);
+		if (error) {
+			std::rethrow_exception(error);
+		}
 	}
 
 }  // namespace amas
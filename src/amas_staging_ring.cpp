@@ -0,0 +1,77 @@
+#include "../include/amas_staging_ring.hpp"
+
+// std
+#include <cassert>
+
+namespace amas {
+
+	AmasStagingRing::AmasStagingRing(AmasDevice& device, VkDeviceSize capacity) : capacity{ capacity } {
+		buffer = std::make_unique<AmasBuffer>(
+			device,
+			capacity,
+			1,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		buffer->map();
+	}
+
+	bool AmasStagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, uint64_t tag, Slice& slice) {
+		assert(alignment > 0 && "Staging alignment must be non-zero");
+		if (size == 0 || size > capacity) {
+			return false;
+		}
+
+		if (used == 0) {
+			head = tail = 0;
+		}
+
+		VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+		if (used == 0 || head > tail) {
+			// free space is [head, capacity) followed by [0, tail)
+			if (offset + size <= capacity) {
+				commit(tag, offset + size, offset + size - head);
+			}
+			else if (size <= tail) {
+				offset = 0;
+				commit(tag, size, capacity - head + size);
+			}
+			else {
+				return false;
+			}
+		}
+		else {
+			// free space is [head, tail)
+			if (offset + size > tail) {
+				return false;
+			}
+			commit(tag, offset + size, offset + size - head);
+		}
+
+		slice.buffer = buffer->getBuffer();
+		slice.offset = offset;
+		slice.data = static_cast<char*>(buffer->getMappedMemory()) + offset;
+		return true;
+	}
+
+	void AmasStagingRing::commit(uint64_t tag, VkDeviceSize end, VkDeviceSize bytes) {
+		head = end;
+		used += bytes;
+
+		if (!markers.empty() && markers.back().tag == tag) {
+			markers.back().end = end;
+			markers.back().bytes += bytes;
+		}
+		else {
+			markers.push_back({ tag, end, bytes });
+		}
+	}
+
+	void AmasStagingRing::retire(uint64_t completedTag) {
+		while (!markers.empty() && markers.front().tag <= completedTag) {
+			tail = markers.front().end;
+			used -= markers.front().bytes;
+			markers.pop_front();
+		}
+	}
+
+}  // namespace amas
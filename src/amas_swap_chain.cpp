@@ -46,7 +46,7 @@ namespace amas {
 		for (int i = 0; i < depthImages.size(); i++) {
 			vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
 			vkDestroyImage(device.device(), depthImages[i], nullptr);
-			vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+			device.getAllocator().free(depthImageAllocations[i]);
 		}
 
 		for (auto framebuffer : swapChainFramebuffers) {
@@ -304,7 +304,7 @@ namespace amas {
 		VkExtent2D swapChainExtent = getSwapChainExtent();
 
 		depthImages.resize(imageCount());
-		depthImageMemorys.resize(imageCount());
+		depthImageAllocations.resize(imageCount());
 		depthImageViews.resize(imageCount());
 
 		for (int i = 0; i < depthImages.size(); i++) {
@@ -328,7 +328,7 @@ namespace amas {
 				imageInfo,
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 				depthImages[i],
-				depthImageMemorys[i]);
+				depthImageAllocations[i]);
 
 			VkImageViewCreateInfo viewInfo{};
 			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -1,32 +1,208 @@
 #include "../include/amas_texture.hpp"
+#include "../include/amas_block_compression.hpp"
 #include "../include/amas_buffer.hpp"
+#include "../include/amas_file_system.hpp"
+#include "../include/amas_uploader.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "../externals/include/stb_image.h"
+#include <climits>
+#include <cstring>
 #include <stdexcept>
 #include <cmath>
 
 namespace amas {
-	AmasTexture::AmasTexture(AmasDevice& device, const std::string& filepath) :amasDevice{ device } {
-		int channels;
+	namespace {
+
+		const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+		// the level index follows the header, one entry per level, level 0 (the finest) first
+		struct Ktx2Header {
+			uint8_t identifier[12];
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+			uint32_t dfdByteOffset;
+			uint32_t dfdByteLength;
+			uint32_t kvdByteOffset;
+			uint32_t kvdByteLength;
+			uint64_t sgdByteOffset;
+			uint64_t sgdByteLength;
+		};
+
+		struct Ktx2Level {
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+
+		uint32_t levelExtent(int extent, size_t level) {
+			return std::max(static_cast<uint32_t>(extent) >> level, 1u);
+		}
+
+		// Plain 2D textures only, no arrays, cube maps or supercompression. The levels are uploaded
+		// from the file as they are, so it is kept open with them.
+		AmasTexture::Pixels loadKtx2(const std::string& filepath, AmasFile&& file) {
+			Ktx2Header header{};
+			if (file.size() < sizeof(Ktx2Header)) {
+				throw std::runtime_error("invalid KTX2 file: " + filepath);
+			}
+			std::memcpy(&header, file.data(), sizeof(header));
+
+			const VkFormat format = static_cast<VkFormat>(header.vkFormat);
+			AmasBlockCompression::FormatInfo info{};
+			if (!AmasBlockCompression::getFormatInfo(format, info)) {
+				throw std::runtime_error("unsupported KTX2 texture format: " + filepath);
+			}
+			const uint32_t levelCount = std::max(header.levelCount, 1u);
+			if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 ||
+				header.pixelWidth > static_cast<uint32_t>(INT_MAX) || header.pixelHeight > static_cast<uint32_t>(INT_MAX) ||
+				header.layerCount > 1 || header.faceCount != 1 || header.supercompressionScheme != 0 ||
+				levelCount > std::floor(std::log2(std::max(header.pixelWidth, header.pixelHeight))) + 1 ||
+				file.size() < sizeof(Ktx2Header) + levelCount * sizeof(Ktx2Level)) {
+				throw std::runtime_error("unsupported KTX2 file: " + filepath);
+			}
+
+			AmasTexture::Pixels pixels{};
+			pixels.width = static_cast<int>(header.pixelWidth);
+			pixels.height = static_cast<int>(header.pixelHeight);
+			pixels.format = format;
+			pixels.levels.resize(levelCount);
+			for (size_t i = 0; i < levelCount; i++) {
+				Ktx2Level level{};
+				std::memcpy(&level, file.data() + sizeof(Ktx2Header) + i * sizeof(Ktx2Level), sizeof(level));
+				if (level.byteLength != AmasBlockCompression::levelSize(info, levelExtent(pixels.width, i), levelExtent(pixels.height, i)) ||
+					level.byteLength > file.size() || level.byteOffset > file.size() - level.byteLength) {
+					throw std::runtime_error("invalid KTX2 file: " + filepath);
+				}
+				pixels.levels[i] = { static_cast<size_t>(level.byteOffset), static_cast<size_t>(level.byteLength) };
+			}
+			pixels.file = std::make_shared<const AmasFile>(std::move(file));
+			return pixels;
+		}
+
+	}  // namespace
+
+	const unsigned char* AmasTexture::Pixels::getData() const {
+		return file ? file->data() : data.get();
+	}
+
+	AmasTexture::Pixels AmasTexture::Pixels::loadFromFile(const std::string& filepath) {
 		int bytesPerPixel;
+		Pixels pixels{};
+		// decoded straight from the mapped file or pack, stb never reads it through a stdio buffer
+		AmasFile file{};
+		if (!AmasFileSystem::open(filepath, file)) {
+			throw std::runtime_error("failed to load texture image " + filepath + "!");
+		}
+		if (file.size() >= sizeof(KTX2_IDENTIFIER) && std::memcmp(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0) {
+			return loadKtx2(filepath, std::move(file));
+		}
+		if (file.size() > static_cast<size_t>(INT_MAX)) {
+			throw std::runtime_error("failed to load texture image " + filepath + "!");
+		}
+		pixels.data = {
+			stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &pixels.width, &pixels.height, &bytesPerPixel, 4),
+			stbi_image_free };
+		if (!pixels.data) {
+			throw std::runtime_error("failed to load texture image " + filepath + "!");
+		}
+		pixels.levels = { { 0, static_cast<size_t>(pixels.width) * pixels.height * 4 } };
+		return pixels;
+	}
+
+	AmasTexture::Pixels AmasTexture::Pixels::solidColor(unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+		Pixels pixels{};
+		pixels.width = 1;
+		pixels.height = 1;
+		pixels.levels = { { 0, 4 } };
+		pixels.data = { new unsigned char[4]{ r, g, b, a }, [](void* data) { delete[] static_cast<unsigned char*>(data); } };
+		return pixels;
+	}
+
+	AmasTexture::Pixels AmasTexture::Pixels::decompress() const {
+		if (!AmasBlockCompression::canDecompress(format)) {
+			throw std::runtime_error("texture format cannot be decompressed: " + std::to_string(format));
+		}
+
+		Pixels pixels{};
+		pixels.width = width;
+		pixels.height = height;
+		pixels.format = AmasBlockCompression::decompressedFormat(format);
+		pixels.levels.resize(levels.size());
+		size_t size = 0;
+		for (size_t i = 0; i < levels.size(); i++) {
+			pixels.levels[i].offset = size;
+			pixels.levels[i].size = static_cast<size_t>(levelExtent(width, i)) * levelExtent(height, i) * 4;
+			size += pixels.levels[i].size;
+		}
+		pixels.data = { new unsigned char[size], [](void* data) { delete[] static_cast<unsigned char*>(data); } };
+
+		for (size_t i = 0; i < levels.size(); i++) {
+			AmasBlockCompression::decompress(format,
+				getData() + levels[i].offset,
+				levelExtent(width, i),
+				levelExtent(height, i),
+				pixels.data.get() + pixels.levels[i].offset);
+		}
+		return pixels;
+	}
+
+	bool AmasTexture::supportsFormat(AmasDevice& device, VkFormat format) {
+		AmasBlockCompression::FormatInfo info{};
+		if (!AmasBlockCompression::getFormatInfo(format, info)) return false;
+		if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK &&
+			!device.optionalFeatures.textureCompressionBC) {
+			return false;
+		}
+		if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK &&
+			!device.optionalFeatures.textureCompressionASTC_LDR) {
+			return false;
+		}
+
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device.getPhysicalDevice(), format, &formatProperties);
+		const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		return (formatProperties.optimalTilingFeatures & required) == required;
+	}
 
-		stbi_uc* data = stbi_load(filepath.c_str(), &width, &height, &bytesPerPixel, 4);
+	AmasTexture::AmasTexture(AmasDevice& device, const std::string& filepath)
+		: AmasTexture(device, Pixels::loadFromFile(filepath)) {}
+
+	AmasTexture::AmasTexture(AmasDevice& device, const Pixels& source)
+		: width{ source.width }, height{ source.height }, amasDevice{ device } {
+		// the asset loader already decompresses on its worker, this covers textures created directly
+		Pixels decompressed{};
+		if (!supportsFormat(amasDevice, source.format)) {
+			if (!AmasBlockCompression::canDecompress(source.format)) {
+				throw std::runtime_error("texture format not supported by the device: " + std::to_string(source.format));
+			}
+			decompressed = source.decompress();
+		}
+		const Pixels& pixels = decompressed.levels.empty() ? source : decompressed;
+		const unsigned char* data = pixels.getData();
 
-		mipLevels = std::floor(std::log2(std::max(width, height))) + 1;
+		AmasBlockCompression::FormatInfo formatInfo{};
+		AmasBlockCompression::getFormatInfo(pixels.format, formatInfo);
+		// a single uncompressed level gets its chain blitted, a container brings its own
+		const bool generateMips = pixels.levels.size() == 1 && formatInfo.blockWidth == 1;
+		mipLevels = generateMips ? static_cast<int>(std::floor(std::log2(std::max(width, height)))) + 1
+			: static_cast<int>(pixels.levels.size());
 
-		AmasBuffer stagingBuffer(
-			amasDevice,
-			4,
-			static_cast<uint32_t>(width * height),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		);
+		imageFormat = pixels.format;
 
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer(data);
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(amasDevice.getPhysicalDevice(), imageFormat, &formatProperties);
 
-		imageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+		if (generateMips && !(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+			throw std::runtime_error("AmasTexture image format does not support linear blitting");
+		}
 
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -41,18 +217,87 @@ namespace amas {
 		imageInfo.extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
 		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
-		amasDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
-
-		transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-		amasDevice.copyBufferToImage(stagingBuffer.getBuffer(),
-			image,
-			static_cast<uint32_t>(width),
-			static_cast<uint32_t>(height),
-			1
-		);
-
-		generateMinmaps();
+		amasDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageAllocation, this);
+
+		VkImageSubresourceRange range{};
+		range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		range.baseMipLevel = 0;
+		range.levelCount = mipLevels;
+		range.baseArrayLayer = 0;
+		range.layerCount = 1;
+
+		if (!generateMips) {
+			// every level goes into one staging slice, each at an offset a copy can read blocks from
+			std::vector<VkDeviceSize> stagingOffsets(pixels.levels.size());
+			VkDeviceSize stagingSize = 0;
+			for (size_t i = 0; i < pixels.levels.size(); i++) {
+				stagingOffsets[i] = stagingSize;
+				stagingSize = (stagingSize + pixels.levels[i].size + 15) & ~VkDeviceSize{ 15 };
+			}
+
+			uploadTicket = amasDevice.getUploader().stage(
+				stagingSize,
+				[&](void* staging) {
+					for (size_t i = 0; i < pixels.levels.size(); i++) {
+						std::memcpy(static_cast<unsigned char*>(staging) + stagingOffsets[i],
+							data + pixels.levels[i].offset,
+							pixels.levels[i].size);
+					}
+				},
+				[&](AmasUploader::Recorder& recorder, VkBuffer stagingBuffer, VkDeviceSize stagingOffset) {
+					transitionImageLayout(recorder.transfer(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+					std::vector<VkBufferImageCopy> regions(pixels.levels.size());
+					for (size_t i = 0; i < regions.size(); i++) {
+						regions[i].bufferOffset = stagingOffset + stagingOffsets[i];
+						regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+						regions[i].imageSubresource.mipLevel = static_cast<uint32_t>(i);
+						regions[i].imageSubresource.baseArrayLayer = 0;
+						regions[i].imageSubresource.layerCount = 1;
+						regions[i].imageExtent = { levelExtent(width, i), levelExtent(height, i), 1 };
+					}
+					vkCmdCopyBufferToImage(recorder.transfer(),
+						stagingBuffer,
+						image,
+						VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						static_cast<uint32_t>(regions.size()),
+						regions.data());
+
+					recorder.transferOwnership(image,
+						range,
+						VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						VK_PIPELINE_STAGE_TRANSFER_BIT,
+						VK_ACCESS_TRANSFER_WRITE_BIT);
+
+					transitionImageLayout(recorder.graphics(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				});
+		}
+		else {
+			uploadTicket = amasDevice.getUploader().stage(
+				data,
+				static_cast<VkDeviceSize>(width) * height * 4,
+				[&](AmasUploader::Recorder& recorder, VkBuffer stagingBuffer, VkDeviceSize stagingOffset) {
+					transitionImageLayout(recorder.transfer(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+					amasDevice.copyBufferToImage(recorder.transfer(),
+						stagingBuffer,
+						image,
+						static_cast<uint32_t>(width),
+						static_cast<uint32_t>(height),
+						1,
+						stagingOffset
+					);
+
+					// blits need the graphics queue, so the mip chain is built after the handover
+					recorder.transferOwnership(image,
+						range,
+						VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						VK_PIPELINE_STAGE_TRANSFER_BIT,
+						VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+
+					generateMinmaps(recorder.graphics());
+				});
+		}
 
 		//transitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
@@ -69,7 +314,7 @@ namespace amas {
 		samplerInfo.mipLodBias = 0.0f;
 		samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = 0.0f;
+		samplerInfo.maxLod = static_cast<float>(mipLevels);
 		samplerInfo.maxAnisotropy = 4.0f;
 		samplerInfo.anisotropyEnable = VK_TRUE;
 		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
@@ -92,20 +337,17 @@ namespace amas {
 		imageViewInfo.image = image;
 
 		vkCreateImageView(amasDevice.device(), &imageViewInfo, nullptr, &imageView);
-
-		stbi_image_free(data);
 	}
 
 	AmasTexture::~AmasTexture() {
+		amasDevice.getUploader().wait(uploadTicket);
 		vkDestroyImage(amasDevice.device(), image, nullptr);
-		vkFreeMemory(amasDevice.device(), imageMemory, nullptr);
+		amasDevice.getAllocator().free(imageAllocation);
 		vkDestroyImageView(amasDevice.device(), imageView, nullptr);
 		vkDestroySampler(amasDevice.device(), sampler, nullptr);
 	}
 
-	void AmasTexture::transitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout) {
-		VkCommandBuffer commandBuffer = amasDevice.beginSingleTimeCommands();
-
+	void AmasTexture::transitionImageLayout(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout) {
 		VkImageMemoryBarrier barrier{};
 		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		barrier.oldLayout = oldLayout;
@@ -141,20 +383,9 @@ namespace amas {
 		}
 
 		vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-		amasDevice.endSingleTimeCommands(commandBuffer);
 	}
 
-	void AmasTexture::generateMinmaps() {
-		VkFormatProperties formatProperties;
-		vkGetPhysicalDeviceFormatProperties(amasDevice.getPhysicalDevice(), imageFormat, &formatProperties);
-
-		if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-			throw std::runtime_error("AmasTexture image format does not support linear blitting");
-		}
-
-		VkCommandBuffer commandBuffer = amasDevice.beginSingleTimeCommands();
-
+	void AmasTexture::generateMinmaps(VkCommandBuffer commandBuffer) {
 		VkImageMemoryBarrier barrier{};
 		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		barrier.image = image;
@@ -169,7 +400,7 @@ namespace amas {
 		int32_t mipWidth = width;
 		int32_t mipHeight = height;
 
-		for (uint32_t i = 1; i < mipLevels; i++) {
+		for (uint32_t i = 1; i < static_cast<uint32_t>(mipLevels); i++) {
 			barrier.subresourceRange.baseMipLevel = i - 1;
 			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
@@ -224,8 +455,6 @@ namespace amas {
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
 			0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-		amasDevice.endSingleTimeCommands(commandBuffer);
 	}
 
 } // namespace amas
\ No newline at end of file
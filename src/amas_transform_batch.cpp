@@ -0,0 +1,350 @@
+#include "../include/amas_transform_batch.hpp"
+
+// std
+#include <cstddef>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define AMAS_TRANSFORM_SSE2
+#include <emmintrin.h>
+// msvc hands out avx intrinsics without /arch, other compilers only when building for avx2
+#if defined(_MSC_VER) || defined(__AVX2__)
+#define AMAS_TRANSFORM_AVX2
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace amas {
+
+	namespace {
+
+		struct Streams {
+			const float* translation[3];
+			const float* rotation[3];
+			const float* scale[3];
+		};
+
+		void composeScalar(const Streams& in, size_t begin, size_t end, glm::mat4* models, glm::mat3* normals) {
+			for (size_t i = begin; i < end; i++) {
+				AmasTransformBatch::compose(
+					{ in.translation[0][i], in.translation[1][i], in.translation[2][i] },
+					{ in.rotation[0][i], in.rotation[1][i], in.rotation[2][i] },
+					{ in.scale[0][i], in.scale[1][i], in.scale[2][i] },
+					models[i],
+					normals[i]);
+			}
+		}
+
+		// sine and cosine of every lane, the cephes single precision polynomials after reducing
+		// the angle to [-pi/4, pi/4]
+		template <typename Ops>
+		inline void sinCos(typename Ops::V x, typename Ops::V& sine, typename Ops::V& cosine) {
+			using V = typename Ops::V;
+			using I = typename Ops::I;
+
+			const V signMask = Ops::asFloat(Ops::setInt(static_cast<int>(0x80000000u)));
+			V sineSign = Ops::andBits(x, signMask);
+			x = Ops::andNot(signMask, x);
+
+			// octant of the angle, rounded up to even
+			I octant = Ops::toInt(Ops::mul(x, Ops::set(1.27323954473516f)));
+			octant = Ops::intAnd(Ops::intAdd(octant, Ops::setInt(1)), Ops::setInt(~1));
+			const V y = Ops::toFloat(octant);
+
+			const V sineSwap = Ops::asFloat(Ops::shiftSign(Ops::intAnd(octant, Ops::setInt(4))));
+			const V cosineSign = Ops::asFloat(Ops::shiftSign(
+				Ops::intAndNot(Ops::intSub(octant, Ops::setInt(2)), Ops::setInt(4))));
+			const V usePolySin = Ops::asFloat(Ops::intEqual(Ops::intAnd(octant, Ops::setInt(2)), Ops::setInt(0)));
+			sineSign = Ops::xorBits(sineSign, sineSwap);
+
+			// x - y * pi/4 in three steps to keep the precision
+			x = Ops::sub(x, Ops::mul(y, Ops::set(.78515625f)));
+			x = Ops::sub(x, Ops::mul(y, Ops::set(2.4187564849853515625e-4f)));
+			x = Ops::sub(x, Ops::mul(y, Ops::set(3.77489497744594108e-8f)));
+			const V z = Ops::mul(x, x);
+
+			V polyCos = Ops::set(2.443315711809948e-5f);
+			polyCos = Ops::add(Ops::mul(polyCos, z), Ops::set(-1.388731625493765e-3f));
+			polyCos = Ops::add(Ops::mul(polyCos, z), Ops::set(4.166664568298827e-2f));
+			polyCos = Ops::mul(Ops::mul(polyCos, z), z);
+			polyCos = Ops::sub(polyCos, Ops::mul(z, Ops::set(.5f)));
+			polyCos = Ops::add(polyCos, Ops::set(1.f));
+
+			V polySin = Ops::set(-1.9515295891e-4f);
+			polySin = Ops::add(Ops::mul(polySin, z), Ops::set(8.3321608736e-3f));
+			polySin = Ops::add(Ops::mul(polySin, z), Ops::set(-1.6666654611e-1f));
+			polySin = Ops::add(Ops::mul(Ops::mul(polySin, z), x), x);
+
+			sine = Ops::xorBits(Ops::select(usePolySin, polySin, polyCos), sineSign);
+			cosine = Ops::xorBits(Ops::select(usePolySin, polyCos, polySin), cosineSign);
+		}
+
+		// Same math as AmasTransformBatch::compose for Ops::WIDTH objects at a time, the tail that
+		// does not fill a register goes through the scalar path.
+		template <typename Ops>
+		inline void composeLanes(const Streams& in, size_t count, glm::mat4* models, glm::mat3* normals) {
+			using V = typename Ops::V;
+			constexpr size_t WIDTH = Ops::WIDTH;
+
+			alignas(32) float last[WIDTH];
+			const V zero = Ops::set(0.f);
+			const V one = Ops::set(1.f);
+
+			const size_t blocked = count - count % WIDTH;
+			for (size_t i = 0; i < blocked; i += WIDTH) {
+				V s1, c1, s2, c2, s3, c3;
+				sinCos<Ops>(Ops::load(in.rotation[1] + i), s1, c1);
+				sinCos<Ops>(Ops::load(in.rotation[0] + i), s2, c2);
+				sinCos<Ops>(Ops::load(in.rotation[2] + i), s3, c3);
+
+				const V s1s2 = Ops::mul(s1, s2);
+				const V c1s2 = Ops::mul(c1, s2);
+				const V u[3] = {
+					Ops::add(Ops::mul(c1, c3), Ops::mul(s1s2, s3)),
+					Ops::mul(c2, s3),
+					Ops::sub(Ops::mul(c1s2, s3), Ops::mul(c3, s1)) };
+				const V v[3] = {
+					Ops::sub(Ops::mul(s1s2, c3), Ops::mul(c1, s3)),
+					Ops::mul(c2, c3),
+					Ops::add(Ops::mul(c1s2, c3), Ops::mul(s1, s3)) };
+				const V w[3] = { Ops::mul(c2, s1), Ops::sub(zero, s2), Ops::mul(c1, c2) };
+				const V* axes[3] = { u, v, w };
+
+				// rows of the 4x4 and 3x3 column major matrices, lane n holds object i + n
+				V model[16];
+				V normal[9];
+				for (int column = 0; column < 3; column++) {
+					const V scale = Ops::load(in.scale[column] + i);
+					const V invScale = Ops::div(one, scale);
+					for (int row = 0; row < 3; row++) {
+						model[column * 4 + row] = Ops::mul(axes[column][row], scale);
+						normal[column * 3 + row] = Ops::mul(axes[column][row], invScale);
+					}
+					model[column * 4 + 3] = zero;
+					model[12 + column] = Ops::load(in.translation[column] + i);
+				}
+				model[15] = one;
+
+				// transposed four floats at a time, the ninth float of the normal matrix goes one by one
+				float* modelOut = &models[i][0][0];
+				float* normalOut = &normals[i][0][0];
+				for (int quad = 0; quad < 4; quad++) {
+					Ops::storeQuads(model + quad * 4, modelOut + quad * 4, 16);
+				}
+				Ops::storeQuads(normal, normalOut, 9);
+				Ops::storeQuads(normal + 4, normalOut + 4, 9);
+				Ops::store(last, normal[8]);
+				for (size_t lane = 0; lane < WIDTH; lane++) {
+					normalOut[lane * 9 + 8] = last[lane];
+				}
+			}
+			composeScalar(in, blocked, count, models, normals);
+		}
+
+#ifdef AMAS_TRANSFORM_SSE2
+		// writes lane n of the four rows to out + n * stride
+		inline void transposeStore(__m128 r0, __m128 r1, __m128 r2, __m128 r3, float* out, size_t stride) {
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(out, r0);
+			_mm_storeu_ps(out + stride, r1);
+			_mm_storeu_ps(out + 2 * stride, r2);
+			_mm_storeu_ps(out + 3 * stride, r3);
+		}
+
+		struct Sse2Ops {
+			static constexpr size_t WIDTH = 4;
+			using V = __m128;
+			using I = __m128i;
+
+			static V load(const float* p) { return _mm_loadu_ps(p); }
+			static void store(float* p, V a) { _mm_store_ps(p, a); }
+			static V set(float a) { return _mm_set1_ps(a); }
+			static V add(V a, V b) { return _mm_add_ps(a, b); }
+			static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+			static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+			static V div(V a, V b) { return _mm_div_ps(a, b); }
+			static V andBits(V a, V b) { return _mm_and_ps(a, b); }
+			static V andNot(V a, V b) { return _mm_andnot_ps(a, b); }
+			static V xorBits(V a, V b) { return _mm_xor_ps(a, b); }
+			static V select(V mask, V a, V b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+			static void storeQuads(const V* rows, float* out, size_t stride) {
+				transposeStore(rows[0], rows[1], rows[2], rows[3], out, stride);
+			}
+
+			static I setInt(int a) { return _mm_set1_epi32(a); }
+			static I toInt(V a) { return _mm_cvttps_epi32(a); }
+			static V toFloat(I a) { return _mm_cvtepi32_ps(a); }
+			static V asFloat(I a) { return _mm_castsi128_ps(a); }
+			static I intAdd(I a, I b) { return _mm_add_epi32(a, b); }
+			static I intSub(I a, I b) { return _mm_sub_epi32(a, b); }
+			static I intAnd(I a, I b) { return _mm_and_si128(a, b); }
+			static I intAndNot(I a, I b) { return _mm_andnot_si128(a, b); }
+			static I intEqual(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+			// moves bit 2 into the sign bit
+			static I shiftSign(I a) { return _mm_slli_epi32(a, 29); }
+		};
+#endif
+
+#ifdef AMAS_TRANSFORM_AVX2
+		struct Avx2Ops {
+			static constexpr size_t WIDTH = 8;
+			using V = __m256;
+			using I = __m256i;
+
+			static V load(const float* p) { return _mm256_loadu_ps(p); }
+			static void store(float* p, V a) { _mm256_store_ps(p, a); }
+			static V set(float a) { return _mm256_set1_ps(a); }
+			static V add(V a, V b) { return _mm256_add_ps(a, b); }
+			static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+			static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+			static V div(V a, V b) { return _mm256_div_ps(a, b); }
+			static V andBits(V a, V b) { return _mm256_and_ps(a, b); }
+			static V andNot(V a, V b) { return _mm256_andnot_ps(a, b); }
+			static V xorBits(V a, V b) { return _mm256_xor_ps(a, b); }
+			static V select(V mask, V a, V b) { return _mm256_blendv_ps(b, a, mask); }
+			static void storeQuads(const V* rows, float* out, size_t stride) {
+				transposeStore(
+					_mm256_castps256_ps128(rows[0]), _mm256_castps256_ps128(rows[1]),
+					_mm256_castps256_ps128(rows[2]), _mm256_castps256_ps128(rows[3]), out, stride);
+				transposeStore(
+					_mm256_extractf128_ps(rows[0], 1), _mm256_extractf128_ps(rows[1], 1),
+					_mm256_extractf128_ps(rows[2], 1), _mm256_extractf128_ps(rows[3], 1), out + 4 * stride, stride);
+			}
+
+			static I setInt(int a) { return _mm256_set1_epi32(a); }
+			static I toInt(V a) { return _mm256_cvttps_epi32(a); }
+			static V toFloat(I a) { return _mm256_cvtepi32_ps(a); }
+			static V asFloat(I a) { return _mm256_castsi256_ps(a); }
+			static I intAdd(I a, I b) { return _mm256_add_epi32(a, b); }
+			static I intSub(I a, I b) { return _mm256_sub_epi32(a, b); }
+			static I intAnd(I a, I b) { return _mm256_and_si256(a, b); }
+			static I intAndNot(I a, I b) { return _mm256_andnot_si256(a, b); }
+			static I intEqual(I a, I b) { return _mm256_cmpeq_epi32(a, b); }
+			static I shiftSign(I a) { return _mm256_slli_epi32(a, 29); }
+		};
+
+		bool cpuSupportsAvx2() {
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7) return false;
+
+			__cpuid(info, 1);
+			const bool osxsave = (info[2] & (1 << 27)) != 0;
+			const bool avx = (info[2] & (1 << 28)) != 0;
+			// the os also has to save the ymm registers on context switches
+			if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#else
+			return true;
+#endif
+		}
+#endif
+
+	}  // namespace
+
+	void AmasTransformBatch::clear() {
+		for (auto* stream : { &translationX, &translationY, &translationZ, &rotationX, &rotationY, &rotationZ,
+			&scaleX, &scaleY, &scaleZ }) {
+			stream->clear();
+		}
+	}
+
+	void AmasTransformBatch::reserve(size_t count) {
+		for (auto* stream : { &translationX, &translationY, &translationZ, &rotationX, &rotationY, &rotationZ,
+			&scaleX, &scaleY, &scaleZ }) {
+			stream->reserve(count);
+		}
+	}
+
+	void AmasTransformBatch::add(const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale) {
+		translationX.push_back(translation.x);
+		translationY.push_back(translation.y);
+		translationZ.push_back(translation.z);
+		rotationX.push_back(rotation.x);
+		rotationY.push_back(rotation.y);
+		rotationZ.push_back(rotation.z);
+		scaleX.push_back(scale.x);
+		scaleY.push_back(scale.y);
+		scaleZ.push_back(scale.z);
+	}
+
+	void AmasTransformBatch::compose(glm::mat4* models, glm::mat3* normals) const {
+		compose(0, size(), models, normals);
+	}
+
+	void AmasTransformBatch::compose(
+		size_t first, size_t last, glm::mat4* models, glm::mat3* normals, Kernel kernel) const {
+		const Streams in{
+			{ translationX.data() + first, translationY.data() + first, translationZ.data() + first },
+			{ rotationX.data() + first, rotationY.data() + first, rotationZ.data() + first },
+			{ scaleX.data() + first, scaleY.data() + first, scaleZ.data() + first } };
+		const size_t count = last - first;
+		models += first;
+		normals += first;
+
+		if (kernel > bestKernel()) {
+			kernel = bestKernel();
+		}
+		switch (kernel) {
+#ifdef AMAS_TRANSFORM_AVX2
+			case Kernel::AVX2:
+				composeLanes<Avx2Ops>(in, count, models, normals);
+				_mm256_zeroupper();
+				return;
+#endif
+#ifdef AMAS_TRANSFORM_SSE2
+			case Kernel::SSE2:
+				composeLanes<Sse2Ops>(in, count, models, normals);
+				return;
+#endif
+			default:
+				composeScalar(in, 0, count, models, normals);
+				return;
+		}
+	}
+
+	void AmasTransformBatch::compose(
+		const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale,
+		glm::mat4& model, glm::mat3& normal) {
+		// Rotations correspond to Tait-bryan angles of Y(1), X(2), Z(3)
+		// https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
+		const float c3 = glm::cos(rotation.z);
+		const float s3 = glm::sin(rotation.z);
+		const float c2 = glm::cos(rotation.x);
+		const float s2 = glm::sin(rotation.x);
+		const float c1 = glm::cos(rotation.y);
+		const float s1 = glm::sin(rotation.y);
+		const glm::vec3 u{ (c1 * c3 + s1 * s2 * s3), (c2 * s3), (c1 * s2 * s3 - c3 * s1) };
+		const glm::vec3 v{ (c3 * s1 * s2 - c1 * s3), (c2 * c3), (c1 * c3 * s2 + s1 * s3) };
+		const glm::vec3 w{ (c2 * s1), (-s2), (c1 * c2) };
+
+		model = glm::mat4{
+			glm::vec4(scale.x * u, 0.0f),
+			glm::vec4(scale.y * v, 0.0f),
+			glm::vec4(scale.z * w, 0.0f),
+			glm::vec4(translation, 1.0f) };
+
+		const glm::vec3 invScale = 1.0f / scale;
+		normal = glm::mat3{ invScale.x * u, invScale.y * v, invScale.z * w };
+	}
+
+	AmasTransformBatch::Kernel AmasTransformBatch::bestKernel() {
+		static const Kernel kernel = [] {
+#ifdef AMAS_TRANSFORM_AVX2
+			if (cpuSupportsAvx2()) return Kernel::AVX2;
+#endif
+#ifdef AMAS_TRANSFORM_SSE2
+			return Kernel::SSE2;
+#else
+			return Kernel::SCALAR;
+#endif
+		}();
+		return kernel;
+	}
+
+}  // namespace amas
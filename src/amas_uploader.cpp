@@ -0,0 +1,443 @@
+#include "../include/amas_uploader.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace amas {
+
+	AmasUploader::AmasUploader(AmasDevice& device) : amasDevice{ device }, stagingRing{ device } {
+		// copyBufferToImage needs texel-aligned offsets, 16 covers every format we use, the compressed blocks too
+		stagingAlignment = std::max<VkDeviceSize>(16, amasDevice.properties.limits.optimalBufferCopyOffsetAlignment);
+
+		QueueFamilyIndices queueFamilyIndices = amasDevice.findPhysicalQueueFamilies();
+		dedicatedTransfer = queueFamilyIndices.transferFamilyHasValue;
+		graphicsFamily = queueFamilyIndices.graphicsFamily;
+		transferFamily = dedicatedTransfer ? queueFamilyIndices.transferFamily : graphicsFamily;
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = graphicsFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		if (vkCreateCommandPool(amasDevice.device(), &poolInfo, nullptr, &graphicsCommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload command pool!");
+		}
+
+		if (dedicatedTransfer) {
+			poolInfo.queueFamilyIndex = transferFamily;
+			if (vkCreateCommandPool(amasDevice.device(), &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create transfer command pool!");
+			}
+		}
+		else {
+			transferCommandPool = graphicsCommandPool;
+		}
+	}
+
+	AmasUploader::~AmasUploader() {
+		waitIdle();
+		for (auto fence : freeFences) {
+			vkDestroyFence(amasDevice.device(), fence, nullptr);
+		}
+		for (auto semaphore : freeSemaphores) {
+			vkDestroySemaphore(amasDevice.device(), semaphore, nullptr);
+		}
+		if (dedicatedTransfer) {
+			vkDestroyCommandPool(amasDevice.device(), transferCommandPool, nullptr);
+		}
+		vkDestroyCommandPool(amasDevice.device(), graphicsCommandPool, nullptr);
+	}
+
+	VkCommandBuffer AmasUploader::Recorder::transfer() const { return batch.transferCommandBuffer; }
+
+	VkCommandBuffer AmasUploader::Recorder::graphics() const { return batch.graphicsCommandBuffer; }
+
+	void AmasUploader::Recorder::transferOwnership(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+		if (!uploader.dedicatedTransfer) {
+			return;
+		}
+
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = uploader.transferFamily;
+		barrier.dstQueueFamilyIndex = uploader.graphicsFamily;
+		barrier.buffer = buffer;
+		barrier.offset = offset;
+		barrier.size = size;
+
+		vkCmdPipelineBarrier(
+			batch.transferCommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+			VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(
+			batch.graphicsCommandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	void AmasUploader::Recorder::transferOwnership(
+		VkImage image,
+		const VkImageSubresourceRange& range,
+		VkImageLayout layout,
+		VkPipelineStageFlags dstStageMask,
+		VkAccessFlags dstAccessMask) {
+		if (!uploader.dedicatedTransfer) {
+			return;
+		}
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.oldLayout = layout;
+		barrier.newLayout = layout;
+		barrier.srcQueueFamilyIndex = uploader.transferFamily;
+		barrier.dstQueueFamilyIndex = uploader.graphicsFamily;
+		barrier.image = image;
+		barrier.subresourceRange = range;
+
+		vkCmdPipelineBarrier(
+			batch.transferCommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dstAccessMask;
+
+		vkCmdPipelineBarrier(
+			batch.graphicsCommandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			dstStageMask,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	VkFence AmasUploader::acquireFence() {
+		if (!freeFences.empty()) {
+			VkFence fence = freeFences.back();
+			freeFences.pop_back();
+			return fence;
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		VkFence fence;
+		if (vkCreateFence(amasDevice.device(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload fence!");
+		}
+		return fence;
+	}
+
+	VkSemaphore AmasUploader::acquireSemaphore() {
+		if (!freeSemaphores.empty()) {
+			VkSemaphore semaphore = freeSemaphores.back();
+			freeSemaphores.pop_back();
+			return semaphore;
+		}
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		VkSemaphore semaphore;
+		if (vkCreateSemaphore(amasDevice.device(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload semaphore!");
+		}
+		return semaphore;
+	}
+
+	VkCommandBuffer AmasUploader::beginCommandBuffer(VkCommandPool pool) {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = pool;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(amasDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate upload command buffer!");
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		return commandBuffer;
+	}
+
+	void AmasUploader::beginBatch() {
+		pending = std::make_unique<Batch>();
+		pending->ticket = nextTicket++;
+		pending->graphicsCommandBuffer = beginCommandBuffer(graphicsCommandPool);
+		pending->transferCommandBuffer =
+			dedicatedTransfer ? beginCommandBuffer(transferCommandPool) : pending->graphicsCommandBuffer;
+	}
+
+	AmasUploader::Ticket AmasUploader::record(
+		const std::function<void(Recorder&)>& commands,
+		std::unique_ptr<AmasBuffer> staging) {
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		if (!pending) {
+			beginBatch();
+		}
+		Recorder recorder{ *this, *pending };
+		commands(recorder);
+
+		if (staging) {
+			pending->stagingBytes += staging->getBufferSize();
+			pending->stagingBuffers.push_back(std::move(staging));
+		}
+
+		Ticket ticket = pending->ticket;
+		if (pending->stagingBytes >= MAX_BATCH_STAGING_BYTES) {
+			submitLocked();
+		}
+		return ticket;
+	}
+
+	AmasUploader::Ticket AmasUploader::stage(
+		const void* data,
+		VkDeviceSize size,
+		const std::function<void(Recorder&, VkBuffer, VkDeviceSize)>& commands) {
+		return stage(
+			size,
+			[&](void* staging) { std::memcpy(staging, data, static_cast<size_t>(size)); },
+			commands);
+	}
+
+	AmasUploader::Ticket AmasUploader::stage(
+		VkDeviceSize size,
+		const std::function<void(void*)>& write,
+		const std::function<void(Recorder&, VkBuffer, VkDeviceSize)>& commands) {
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		if (!pending) {
+			beginBatch();
+		}
+
+		AmasStagingRing::Slice slice{};
+		if (allocateStaging(size, slice)) {
+			write(slice.data);
+			Recorder recorder{ *this, *pending };
+			commands(recorder, slice.buffer, slice.offset);
+			pending->stagingBytes += size;
+			pending->usesStagingRing = true;
+		}
+		else {
+			auto staging = std::make_unique<AmasBuffer>(
+				amasDevice,
+				size,
+				1,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			staging->map();
+			write(staging->getMappedMemory());
+			Recorder recorder{ *this, *pending };
+			commands(recorder, staging->getBuffer(), 0);
+			pending->stagingBytes += size;
+			pending->stagingBuffers.push_back(std::move(staging));
+			stagingFallbackCount++;
+		}
+
+		Ticket ticket = pending->ticket;
+		if (pending->stagingBytes >= MAX_BATCH_STAGING_BYTES) {
+			submitLocked();
+		}
+		return ticket;
+	}
+
+	AmasUploader::Ticket AmasUploader::copyBuffer(
+		const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset) {
+		return copyBuffer(
+			size,
+			[&](void* staging) { std::memcpy(staging, data, static_cast<size_t>(size)); },
+			dstBuffer,
+			dstOffset);
+	}
+
+	AmasUploader::Ticket AmasUploader::copyBuffer(
+		VkDeviceSize size, const std::function<void(void*)>& write, VkBuffer dstBuffer, VkDeviceSize dstOffset) {
+		return stage(size, write, [&](Recorder& recorder, VkBuffer srcBuffer, VkDeviceSize srcOffset) {
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = srcOffset;
+			copyRegion.dstOffset = dstOffset;
+			copyRegion.size = size;
+			vkCmdCopyBuffer(recorder.transfer(), srcBuffer, dstBuffer, 1, &copyRegion);
+			recorder.transferOwnership(dstBuffer, dstOffset, size);
+		});
+	}
+
+	bool AmasUploader::allocateStaging(VkDeviceSize size, AmasStagingRing::Slice& slice) {
+		// anything over half the ring would stall every other upload behind it
+		if (size > stagingRing.getCapacity() / 2) {
+			return false;
+		}
+
+		while (!stagingRing.allocate(size, stagingAlignment, pending->ticket, slice)) {
+			collectLocked();
+			if (stagingRing.allocate(size, stagingAlignment, pending->ticket, slice)) {
+				return true;
+			}
+
+			if (!inFlight.empty()) {
+				vkWaitForFences(
+					amasDevice.device(),
+					1,
+					&inFlight.front()->fence,
+					VK_TRUE,
+					std::numeric_limits<uint64_t>::max());
+			}
+			else if (pending->usesStagingRing) {
+				// the ring is filled by the batch we are recording, push it out and start a new one
+				submitLocked();
+				beginBatch();
+			}
+			else {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	AmasUploader::Ticket AmasUploader::submit() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		return submitLocked();
+	}
+
+	AmasUploader::Ticket AmasUploader::submitLocked() {
+		if (!pending) {
+			return nextTicket - 1;
+		}
+
+		// make every transfer write in the batch visible to whatever is submitted after it
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+			VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			pending->graphicsCommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		if (vkEndCommandBuffer(pending->graphicsCommandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record upload command buffer!");
+		}
+
+		pending->fence = acquireFence();
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+		// the copies run on the transfer queue, the graphics side only acquires what they wrote
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		if (dedicatedTransfer) {
+			if (vkEndCommandBuffer(pending->transferCommandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to record transfer command buffer!");
+			}
+
+			pending->semaphore = acquireSemaphore();
+
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &pending->transferCommandBuffer;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &pending->semaphore;
+
+			if (vkQueueSubmit(amasDevice.transferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+				throw std::runtime_error("failed to submit transfer command buffer!");
+			}
+
+			submitInfo.signalSemaphoreCount = 0;
+			submitInfo.pSignalSemaphores = nullptr;
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &pending->semaphore;
+			submitInfo.pWaitDstStageMask = &waitStage;
+		}
+
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &pending->graphicsCommandBuffer;
+
+		if (vkQueueSubmit(amasDevice.graphicsQueue(), 1, &submitInfo, pending->fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload command buffer!");
+		}
+		submissionCount++;
+
+		Ticket ticket = pending->ticket;
+		inFlight.push_back(std::move(pending));
+		return ticket;
+	}
+
+	void AmasUploader::collectLocked() {
+		// the fences all signal on the graphics queue, so batches retire in submission order
+		while (!inFlight.empty() && vkGetFenceStatus(amasDevice.device(), inFlight.front()->fence) == VK_SUCCESS) {
+			auto& batch = inFlight.front();
+			completedTicket = batch->ticket;
+			stagingRing.retire(completedTicket);
+			vkFreeCommandBuffers(amasDevice.device(), graphicsCommandPool, 1, &batch->graphicsCommandBuffer);
+			if (dedicatedTransfer) {
+				vkFreeCommandBuffers(amasDevice.device(), transferCommandPool, 1, &batch->transferCommandBuffer);
+				freeSemaphores.push_back(batch->semaphore);
+			}
+			vkResetFences(amasDevice.device(), 1, &batch->fence);
+			freeFences.push_back(batch->fence);
+			inFlight.pop_front();
+		}
+	}
+
+	void AmasUploader::collect() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		collectLocked();
+	}
+
+	bool AmasUploader::isComplete(Ticket ticket) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		collectLocked();
+		return ticket <= completedTicket;
+	}
+
+	void AmasUploader::wait(Ticket ticket) {
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		// a finished ticket, 0 included, must not wait on whatever batch is in flight now
+		collectLocked();
+		if (ticket <= completedTicket) {
+			return;
+		}
+
+		if (pending && ticket >= pending->ticket) {
+			submitLocked();
+		}
+
+		for (auto& batch : inFlight) {
+			if (batch->ticket < ticket) continue;
+			vkWaitForFences(
+				amasDevice.device(),
+				1,
+				&batch->fence,
+				VK_TRUE,
+				std::numeric_limits<uint64_t>::max());
+			break;
+		}
+		collectLocked();
+	}
+
+	void AmasUploader::waitIdle() { wait(nextTicket - 1); }
+
+}  // namespace amas
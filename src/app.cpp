@@ -1,10 +1,13 @@
 #include "../include/app.hpp"
 #include "../include/amas_buffer.hpp"
+#include "../include/amas_file_system.hpp"
 #include "../include/keyboard_movement_controller.hpp"
 #include "../include/amas_camera.hpp"
 #include "../include/simple_render_system.hpp"
 #include "../include/point_light_system.hpp"
+#include "../include/transform_system.hpp"
 #include "../include/amas_texture.hpp"
+#include "../include/amas_uploader.hpp"
 
 // libs
 #include "../externals/include/stb_image.h"
@@ -16,6 +19,7 @@
 
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <chrono>
@@ -27,6 +31,8 @@
 namespace amas {
 
 	App::App() {
+		// without a pack next to the executable the content is read from the loose files
+		AmasFileSystem::mount(ASSET_PACK);
 		loadGameObjects();
 		initDescriptorPool(getMaterialHavingObjectsCount(), textures.size());
 	}
@@ -36,8 +42,9 @@ namespace amas {
 	int App::getMaterialHavingObjectsCount() const {
 		int count = 0;
 
-		for (int i = 0; i < gameObjects.size(); i++) {
-			if (gameObjects.at(i).material == nullptr || gameObjects.at(i).pointLight != nullptr) continue;
+		for (uint32_t i = 0; i < registry.getEntityCount(); i++) {
+			Entity entity = registry.entityAt(i);
+			if (!registry.has<MaterialComponent>(entity) || registry.has<PointLightComponent>(entity)) continue;
 			++count;
 		}
 		return count;
@@ -55,7 +62,7 @@ namespace amas {
 	void App::initDescriptorLayouts() {
 		
 		auto builder1 = AmasDescriptorSetLayout::Builder(amasDevice);
-		builder1.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS);
+		builder1.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT);
 
 		//lets guess for now that we have at least 1 material but this works fine i think
 		for (int i = 0; i < textures.size(); i++) {
@@ -97,15 +104,8 @@ namespace amas {
 
 	void App::initDescriptorSets(std::vector<VkDescriptorSet>& globalSets, std::vector<std::unique_ptr<AmasBuffer>>& globalBuffers,
 								 std::vector<VkDescriptorSet>& componentSets, std::vector<std::unique_ptr<AmasBuffer>>& componentBuffers) {
-		AmasDescriptorWriter writer1(*descriptorSetLayouts[0], *globalPool);
 		for (int i = 0; i < globalSets.size(); i++) {
-			auto bufferInfo = globalBuffers[i]->descriptorInfo();
-			writer1.writeBuffer(0, &bufferInfo);
-			for (int j = 0; j < getMaterialHavingObjectsCount(); j++) {
-				//need to implement a predicate for map 
-				writer1.writeImage(j + 1, &gameObjects.at(j).material->info);
-			}
-			writer1.build(globalSets[i]);
+			writeGlobalSet(globalSets[i], *globalBuffers[i], false);
 		}
 
 		AmasDescriptorWriter writer2(*descriptorSetLayouts[1], *globalPool);
@@ -118,6 +118,22 @@ namespace amas {
 	}
 
 
+	void App::writeGlobalSet(VkDescriptorSet& set, AmasBuffer& buffer, bool overwrite) {
+		AmasDescriptorWriter writer(*descriptorSetLayouts[0], *globalPool);
+		auto bufferInfo = buffer.descriptorInfo();
+		writer.writeBuffer(0, &bufferInfo);
+		for (int j = 0; j < getMaterialHavingObjectsCount(); j++) {
+			//need to implement a predicate for map 
+			writer.writeImage(j + 1, &registry.get<MaterialComponent>(registry.entityAt(j)).info);
+		}
+		if (overwrite) {
+			writer.overwrite(set);
+		}
+		else {
+			writer.build(set);
+		}
+	}
+
 	void App::run() {
 		initDescriptorLayouts();
 		std::vector<std::unique_ptr<AmasBuffer>> uboBuffers = initUboBuffers(
@@ -136,7 +152,8 @@ namespace amas {
 		std::cout << getMaterialHavingObjectsCount() << std::endl;
 
 		for (int i = 0; i < componentUboBuffers.size(); i++) {
-			componentUboBuffers[i]->writeToBuffer(&gameObjects.at(i).gameObjectUBO);
+			ComponentUbo componentUbo{ i };
+			componentUboBuffers[i]->writeToBuffer(&componentUbo);
 			componentUboBuffers[i]->flush();
 		}
 
@@ -149,39 +166,59 @@ namespace amas {
 
 		SimpleRenderSystem simpleRenderSystem{ amasDevice, AmasRenderer.getSwapChainRenderPass(), descriptorSetLayouts };
 		PointLightSystem pointLightSystem{ amasDevice, AmasRenderer.getSwapChainRenderPass(), descriptorSetLayouts[0]->getDescriptorSetLayout()};
+		TransformSystem transformSystem{};
 		AmasCamera camera{};
 
-		auto viewerObject = AmasGameObject::createGameObject();
-		viewerObject.transform.translation.z = -2.5f;
+		TransformComponent viewerTransform{};
+		viewerTransform.setTranslation({ 0.f, 0.f, -2.5f });
 		KeyboardMovementController cameraController{};
 
+		// set to rewrite once the frame using it comes around, after a material got its real texture
+		std::vector<bool> staleGlobalSets(AmasSwapChain::MAX_FRAMES_IN_FLIGHT, false);
+
 		auto currentTime = std::chrono::high_resolution_clock::now();
+		float statsTimer = 0.f;
 		while (!amasWindow.shouldClose()) {
 			glfwPollEvents();
 
+			// assets finished loading in the background replace their placeholders
+			if (assetLoader.update(registry, sceneBvh)) {
+				std::fill(staleGlobalSets.begin(), staleGlobalSets.end(), true);
+			}
+
 			auto newTime = std::chrono::high_resolution_clock::now();
 			float frameTime =
 				std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
 			currentTime = newTime;
 
-			cameraController.moveInPlaneXZ(amasWindow.getGLFWwindow(), frameTime, viewerObject);
-			camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
+			cameraController.moveInPlaneXZ(amasWindow.getGLFWwindow(), frameTime, viewerTransform);
+			camera.setViewYXZ(viewerTransform.getTranslation(), viewerTransform.getRotation());
 
 			float aspect = AmasRenderer.getAspectRatio();
 			camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 10000.f);
 
 			if (auto commandBuffer = AmasRenderer.beginFrame()) {
 				int frameIndex = AmasRenderer.getFrameIndex();
+				if (staleGlobalSets[frameIndex]) {
+					writeGlobalSet(globalDescriptorSets[frameIndex], *uboBuffers[frameIndex], true);
+					staleGlobalSets[frameIndex] = false;
+				}
 				FrameInfo frameInfo{
 					frameIndex,
 					frameTime,
 					commandBuffer,
 					camera,
 					globalDescriptorSets[frameIndex],
-					gameObjects
+					registry,
+					sceneBvh,
+					hierarchy,
+					AmasRenderer,
+					jobSystem
 				};
 
 				//update
+				transformSystem.update(frameInfo);
+
 				GlobalUbo ubo{};
 				ubo.projection = camera.getProjection();
 				ubo.view = camera.getView();
@@ -191,8 +228,27 @@ namespace amas {
 				uboBuffers[frameIndex]->writeToBuffer(&ubo);
 				uboBuffers[frameIndex]->flush();
 
+				//cull
+				simpleRenderSystem.prepareGameObjects(frameInfo);
+
+				if (PRINT_FRAME_STATS) {
+					statsTimer += frameTime;
+					if (statsTimer >= 1.f) {
+						statsTimer = 0.f;
+						const auto& stats = simpleRenderSystem.getCullingStats();
+						std::cout << "Visible objects:  " << stats.visibleCount << " / " << stats.objectCount
+							<< " (culled " << stats.culledCount << ")\n";
+						if (stats.clusterCount > 0) {
+							std::cout << "Visible meshlets:  " << stats.visibleClusterCount << " / " << stats.clusterCount << "\n";
+						}
+						const auto& lodStats = simpleRenderSystem.getLodStats();
+						std::cout << "Triangles:  " << lodStats.drawnTriangles << " / " << lodStats.fullDetailTriangles
+							<< " at full detail\n";
+					}
+				}
+
 				//render
-				AmasRenderer.beginSwapChainRenderPass(commandBuffer);
+				AmasRenderer.beginSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
 				simpleRenderSystem.renderGameObjects(frameInfo, componentSets, componentUboBuffers);
 				pointLightSystem.render(frameInfo);
@@ -206,41 +262,38 @@ namespace amas {
 	}
 
 	void App::loadGameObjects() {
-		AmasGameObject::setDevice(amasDevice);
-
-		std::shared_ptr<AmasTexture> texture1 = std::make_shared<AmasTexture>(amasDevice, "objs/lain.jpg");
+		// decoded in the background, the entities show placeholders until then
+		auto texture1 = assetLoader.loadTexture("objs/lain.jpg");
 		textures.push_back(texture1);
 
-		std::shared_ptr<AmasModel> cubeModel =
-			AmasModel::createModelFromFile(amasDevice, "objs/Cube.obj");
+		auto cubeModel = assetLoader.loadModel("objs/Cube.obj");
 
-		auto cube1 = AmasGameObject::createGameObject();
-		cube1.model = cubeModel;
-		cube1.transform.translation = { -.5f, .5f, 0 };
-		cube1.transform.scale = { 1.f, 1.f, 1.f };
-		cube1.attachMaterial(texture1);
-		gameObjects.emplace(cube1.getId(), std::move(cube1));
+		auto cube1 = AmasGameObject::createGameObject(registry);
+		assetLoader.assignModel(registry, cube1, cubeModel);
+		auto& cube1Transform = registry.get<TransformComponent>(cube1);
+		cube1Transform.setTranslation({ -.5f, .5f, 0 });
+		cube1Transform.setScale({ 1.f, 1.f, 1.f });
+		assetLoader.assignTexture(registry, cube1, texture1);
 
 		//point lights creation
 		{
-			auto pointLight1 = AmasGameObject::makePointLight(2.f);
-			pointLight1.color = glm::vec3(.4f, .7f, .3f);
-			pointLight1.pointLight->lightIntensity = .3f;
-			pointLight1.transform.translation += glm::vec3(4.f, -.7f, -.3f);
-			gameObjects.emplace(pointLight1.getId(), std::move(pointLight1));
-			auto pointLight2 = AmasGameObject::makePointLight(1.f);
-			pointLight2.pointLight->lightIntensity = 1.5f;
-			pointLight2.color = glm::vec3(.5f, .2f, .8f);
-			pointLight2.transform.translation += glm::vec3(-1.2f, -1.3f, .5f);
-			gameObjects.emplace(pointLight2.getId(), std::move(pointLight2));
-			auto pointLight3 = AmasGameObject::makePointLight(.5f);
-			pointLight3.pointLight->lightIntensity = .5f;
-			pointLight3.color = glm::vec3(.2f, .5f, .5f);
-			pointLight3.transform.translation += glm::vec3(1.8f, -1.7f, -.7f);
-			gameObjects.emplace(pointLight3.getId(), std::move(pointLight3));
+			auto pointLight1 = AmasGameObject::makePointLight(registry, .3f, .1f, glm::vec3(.4f, .7f, .3f));
+			registry.get<TransformComponent>(pointLight1).translate(glm::vec3(4.f, -.7f, -.3f));
+			auto pointLight2 = AmasGameObject::makePointLight(registry, 1.5f, .1f, glm::vec3(.5f, .2f, .8f));
+			registry.get<TransformComponent>(pointLight2).translate(glm::vec3(-1.2f, -1.3f, .5f));
+			auto pointLight3 = AmasGameObject::makePointLight(registry, .5f, .1f, glm::vec3(.2f, .5f, .5f));
+			registry.get<TransformComponent>(pointLight3).translate(glm::vec3(1.8f, -1.7f, -.7f));
 		}
 
-		std::cout << "GameObjects overall count:  " << gameObjects.size() << "\n";
+		registry.each<TransformComponent>([&](Entity entity, TransformComponent&) {
+			sceneBvh.insert(registry, entity);
+		});
+
+		amasDevice.getUploader().submit();
+
+		std::cout << "GameObjects overall count:  " << registry.getEntityCount() << "\n";
+		std::cout << "Upload submissions:  " << amasDevice.getUploader().getSubmissionCount() << "\n";
+		amasDevice.getAllocator().printStats(std::cout);
 	}
 
 }  // namespace amas
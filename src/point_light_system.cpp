@@ -7,10 +7,11 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <stdexcept>
-#include <map>
+#include <utility>
 
 namespace amas {
 
@@ -76,9 +77,29 @@ namespace amas {
 			firstTime = false;
 		}
 
-		for (auto& kv : frameInfo.gameObjects) {
-			auto& obj = kv.second;
-			if (obj.pointLight == nullptr) continue;
+		auto& transforms = frameInfo.registry.pool<TransformComponent>();
+		auto& pointLights = frameInfo.registry.pool<PointLightComponent>();
+
+		// the ubo only has room for MAX_LIGHTS, keep the ones closest to the camera
+		const glm::vec3 cameraPosition = frameInfo.camera.getPosition();
+		lightQuery.clear();
+		frameInfo.sceneBvh.lights.querySphere(cameraPosition, LIGHT_GATHER_RADIUS, lightQuery);
+		if (lightQuery.size() > MAX_LIGHTS) {
+			auto distanceSquared = [&](uint32_t id) {
+				auto offset = transforms.get(id).getWorldTranslation() - cameraPosition;
+				return glm::dot(offset, offset);
+			};
+			std::partial_sort(
+				lightQuery.begin(),
+				lightQuery.begin() + MAX_LIGHTS,
+				lightQuery.end(),
+				[&](uint32_t a, uint32_t b) { return distanceSquared(a) < distanceSquared(b); });
+			lightQuery.resize(MAX_LIGHTS);
+		}
+
+		for (uint32_t id : lightQuery) {
+			auto& transform = transforms.get(id);
+			auto& light = pointLights.get(id);
 
 			//update something
 		/*
@@ -88,27 +109,27 @@ namespace amas {
 			if (elapsedTime >= interval) {
 				int x = rand() % 4 + 1;
 				if (x == 1) {
-					obj.color = glm::vec3(1.f, 0.f, 0.f);
+					light.color = glm::vec3(1.f, 0.f, 0.f);
 				}
 				else if (x == 2) {
-					obj.color = glm::vec3(0.f, 1.f, 0.f);
+					light.color = glm::vec3(0.f, 1.f, 0.f);
 				}
 				else if (x == 3) {
-					obj.color = glm::vec3(0.f, 0.f, 1.f);
+					light.color = glm::vec3(0.f, 0.f, 1.f);
 				}
 				else if (x == 4) {
-					obj.color = glm::vec3(1.f, 1.f, 1.f);
+					light.color = glm::vec3(1.f, 1.f, 1.f);
 				}
 
 				startTime = currentTime;
 			}
 
 
-			obj.transform.translation += glm::vec3(0.f, -.0005f, 0.f);
+			transform.translate(glm::vec3(0.f, -.0005f, 0.f));
 		*/
 		//copy light to the ubo
-			ubo.pointLights[lightIndex].position = glm::vec4(obj.transform.translation, 1.f);
-			ubo.pointLights[lightIndex].color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
+			ubo.pointLights[lightIndex].position = glm::vec4(transform.getWorldTranslation(), 1.f);
+			ubo.pointLights[lightIndex].color = glm::vec4(light.color, light.lightIntensity);
 
 			lightIndex += 1;
 		}
@@ -116,51 +137,57 @@ namespace amas {
 	}
 
 	void PointLightSystem::render(FrameInfo& frameInfo) {
-		//sort lights
-		std::map<float, AmasGameObject::id_t> sorted;
+		// only billboards inside the view frustum are drawn
+		lightQuery.clear();
+		frameInfo.sceneBvh.lights.queryFrustum(frameInfo.camera.getFrustum(), lightQuery);
+
+		// blended back to front, the push constants are gathered here so the recording threads
+		// never touch the registry
+		auto& transforms = frameInfo.registry.pool<TransformComponent>();
+		auto& pointLights = frameInfo.registry.pool<PointLightComponent>();
+		std::vector<std::pair<float, PointLightPushConstants>> sorted;
+		sorted.reserve(lightQuery.size());
+		for (uint32_t id : lightQuery) {
+			auto& transform = transforms.get(id);
+			auto& light = pointLights.get(id);
 
-		for (auto& kv : frameInfo.gameObjects) {
-			auto& obj = kv.second;
-			if (obj.pointLight == nullptr) continue;
+			PointLightPushConstants push{};
+			push.position = glm::vec4(transform.getWorldTranslation(), 1.f);
+			push.color = glm::vec4(light.color, light.lightIntensity);
+			push.radius = transform.getScale().x;
 
 			//calculate distance
-			auto offset = frameInfo.camera.getPosition() - obj.transform.translation;
-			float disSquared = glm::dot(offset, offset);
-			sorted[disSquared] = obj.getId();
+			auto offset = frameInfo.camera.getPosition() - transform.getWorldTranslation();
+			sorted.emplace_back(glm::dot(offset, offset), push);
 		}
+		std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
 
+		auto recordLights = [&](VkCommandBuffer commandBuffer, uint32_t first, uint32_t last) {
+			amasPipeline->bind(commandBuffer);
 
-		amasPipeline->bind(frameInfo.commandBuffer);
-
-		vkCmdBindDescriptorSets(
-			frameInfo.commandBuffer,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			pipelineLayout,
-			0,
-			1,
-			&frameInfo.globalDescriptorSet,
-			0,
-			nullptr);
-
-		for (auto it = sorted.rbegin(); it != sorted.rend(); ++it) {
-			// use gameobject id to find light object
-			auto& obj = frameInfo.gameObjects.at(it->second);
-
-			PointLightPushConstants push{};
-			push.position = glm::vec4(obj.transform.translation, 1.f);
-			push.color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
-			push.radius = obj.transform.scale.x;
-
-			vkCmdPushConstants(
-				frameInfo.commandBuffer,
+			vkCmdBindDescriptorSets(
+				commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
 				pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
 				0,
-				sizeof(PointLightPushConstants),
-				&push
-			);
-
-			vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
-		}
+				1,
+				&frameInfo.globalDescriptorSet,
+				0,
+				nullptr);
+
+			for (uint32_t i = first; i < last; i++) {
+				vkCmdPushConstants(
+					commandBuffer,
+					pipelineLayout,
+					VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+					0,
+					sizeof(PointLightPushConstants),
+					&sorted[i].second
+				);
+
+				vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+			}
+		};
+		frameInfo.renderer.recordSecondary(static_cast<uint32_t>(sorted.size()), MIN_LIGHTS_PER_BUFFER, recordLights);
 	}
 }  // namespace amas
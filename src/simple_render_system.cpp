@@ -1,5 +1,7 @@
 #include "../include/simple_render_system.hpp"
 #include "../include/amas_descriptors.hpp"
+#include "../include/amas_geometry_pool.hpp"
+#include "../include/amas_swap_chain.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -8,44 +10,214 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <functional>
 #include <stdexcept>
 
 namespace amas {
 
-	struct SimplePushConstantData {
+	// matches InstanceData in simple_shader.vert and cull.comp (std430)
+	struct InstanceData {
 		glm::mat4 modelMatrix{ 1.f };
 		glm::mat4 normalMatrix{ 1.f };
+		glm::vec4 positionOffset{ 0.f };  // undoes the vertex format's position encoding
+		glm::vec4 positionScale{ 1.f };
 	};
 
+	// matches CullObject in cull.comp (std430), an instance or one meshlet of an instance
+	struct CullObject {
+		glm::vec4 sphere{};  // object-space center, w is radius
+		glm::vec4 cone{ 0.f, 0.f, 0.f, 1.f };  // see AmasModel::Meshlet, w of 1 skips the test
+		uint32_t commandIndex;
+		uint32_t instanceIndex;
+		uint32_t cluster;  // counted as a meshlet rather than an object
+		uint32_t padding;
+	};
+
+	// matches CullingStats in cull.comp
+	struct CullingCounters {
+		uint32_t visibleCount;
+		uint32_t culledCount;
+		uint32_t visibleClusterCount;
+		uint32_t culledClusterCount;
+	};
+
+	struct CullPushConstantData {
+		uint32_t objectCount;
+	};
+
+	constexpr uint32_t MIN_INSTANCE_CAPACITY = 64;
+	constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+
+	// vertex shader variant decoding the format meshes are uploaded in, built by shaders/compile.bat
+	static const char* vertexShaderPath(AmasModel::VertexFormat format) {
+		switch (format) {
+		case AmasModel::VertexFormat::FLOAT:
+			return "shaders/simple_shader.vert.spv";
+		case AmasModel::VertexFormat::SNORM16_NO_COLOR:
+			return "shaders/simple_shader_compact_no_color.vert.spv";
+		default:
+			return "shaders/simple_shader_compact.vert.spv";
+		}
+	}
+
+	// largest axis scale of a world matrix, what a bounding sphere grows by, as cull.comp has it
+	static float maxScale(const glm::mat4& matrix) {
+		return glm::max(glm::length(glm::vec3(matrix[0])), glm::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+	}
+
+	// A meshlet's normal cone keeps its angle under rotations, mirrors and uniform scales only,
+	// other transforms skip the back-face test.
+	static bool preservesAngles(const glm::mat4& matrix) {
+		static constexpr float TOLERANCE = 1e-3f;
+		const glm::vec3 x{ matrix[0] };
+		const glm::vec3 y{ matrix[1] };
+		const glm::vec3 z{ matrix[2] };
+		const float xx = glm::dot(x, x);
+		const float yy = glm::dot(y, y);
+		const float zz = glm::dot(z, z);
+		const float largest = glm::max(xx, glm::max(yy, zz));
+		const float smallest = glm::min(xx, glm::min(yy, zz));
+		const float skew = glm::abs(glm::dot(x, y)) + glm::abs(glm::dot(x, z)) + glm::abs(glm::dot(y, z));
+		return largest - smallest <= TOLERANCE * largest && skew <= TOLERANCE * largest;
+	}
+
+	// Grows a per-frame host-visible buffer to hold at least count elements, returns true when
+	// the buffer was replaced. The frame's previous submission has finished by the time we get here.
+	static bool reserveFrameBuffer(
+		AmasDevice& device,
+		std::unique_ptr<AmasBuffer>& buffer,
+		VkDeviceSize elementSize,
+		uint32_t count,
+		VkBufferUsageFlags usage) {
+		if (buffer && buffer->getInstanceCount() >= count) {
+			return false;
+		}
+
+		uint32_t capacity = buffer ? buffer->getInstanceCount() * 2 : MIN_INSTANCE_CAPACITY;
+		buffer = std::make_unique<AmasBuffer>(
+			device,
+			elementSize,
+			std::max(capacity, count),
+			usage,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		buffer->map();
+		return true;
+	}
+
 	SimpleRenderSystem::SimpleRenderSystem(AmasDevice& device, VkRenderPass renderPass, const std::vector<std::unique_ptr<AmasDescriptorSetLayout>>& layouts)
 		: amasDevice{ device } {
+		setCullingMode(CullingMode::GPU);
+		createInstanceDescriptors();
 		createPipelineLayout(layouts);
 		createPipeline(renderPass);
+		createCullPipeline(layouts);
 	}
 
 	SimpleRenderSystem::~SimpleRenderSystem() {
 		vkDestroyPipelineLayout(amasDevice.device(), pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(amasDevice.device(), cullPipelineLayout, nullptr);
 	}
 
-	void SimpleRenderSystem::createPipelineLayout(const std::vector<std::unique_ptr<AmasDescriptorSetLayout>>& layouts) {
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(SimplePushConstantData);
+	void SimpleRenderSystem::createInstanceDescriptors() {
+		VkShaderStageFlags sharedStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+		instanceSetLayout = AmasDescriptorSetLayout::Builder(amasDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sharedStages)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sharedStages)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		instancePool = AmasDescriptorPool::Builder(amasDevice)
+			.setMaxSets(AmasSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, AmasSwapChain::MAX_FRAMES_IN_FLIGHT * 5)
+			.build();
+
+		instanceBuffers.resize(AmasSwapChain::MAX_FRAMES_IN_FLIGHT);
+		visibleBuffers.resize(AmasSwapChain::MAX_FRAMES_IN_FLIGHT);
+		cullBuffers.resize(AmasSwapChain::MAX_FRAMES_IN_FLIGHT);
+		indirectBuffers.resize(AmasSwapChain::MAX_FRAMES_IN_FLIGHT);
+		statsBuffers.resize(AmasSwapChain::MAX_FRAMES_IN_FLIGHT);
+		drawCountBuffers.resize(AmasSwapChain::MAX_FRAMES_IN_FLIGHT);
+		instanceSets.resize(AmasSwapChain::MAX_FRAMES_IN_FLIGHT);
+		frameObjectCounts.resize(AmasSwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+		frameClusteredCounts.resize(AmasSwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+		for (size_t i = 0; i < instanceSets.size(); i++) {
+			statsBuffers[i] = std::make_unique<AmasBuffer>(
+				amasDevice,
+				sizeof(CullingCounters),
+				1,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			statsBuffers[i]->map();
+			CullingCounters counters{};
+			statsBuffers[i]->writeToBuffer(&counters);
+			statsBuffers[i]->flush();
+
+			if (!instancePool->allocateDescriptor(instanceSetLayout->getDescriptorSetLayout(), instanceSets[i])) {
+				throw std::runtime_error("failed to allocate instance descriptor set!");
+			}
+			reserveInstances(static_cast<int>(i), MIN_INSTANCE_CAPACITY, MIN_INSTANCE_CAPACITY);
+		}
+	}
+
+	void SimpleRenderSystem::reserveInstances(int frameIndex, uint32_t instanceCount, uint32_t cullObjectCount) {
+		reserveFrameBuffer(
+			amasDevice,
+			drawCountBuffers[frameIndex],
+			sizeof(uint32_t),
+			amasDevice.getGeometryPool().getPageCount(),
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+		// a command never holds less than one cull object, so the command count is bounded by theirs
+		bool replaced = reserveFrameBuffer(
+			amasDevice,
+			indirectBuffers[frameIndex],
+			sizeof(VkDrawIndexedIndirectCommand),
+			cullObjectCount,
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		replaced |= reserveFrameBuffer(
+			amasDevice, instanceBuffers[frameIndex], sizeof(InstanceData), instanceCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		replaced |= reserveFrameBuffer(
+			amasDevice, visibleBuffers[frameIndex], sizeof(uint32_t), cullObjectCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		replaced |= reserveFrameBuffer(
+			amasDevice, cullBuffers[frameIndex], sizeof(CullObject), cullObjectCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		if (!replaced) {
+			return;
+		}
+
+		auto instanceInfo = instanceBuffers[frameIndex]->descriptorInfo();
+		auto visibleInfo = visibleBuffers[frameIndex]->descriptorInfo();
+		auto cullInfo = cullBuffers[frameIndex]->descriptorInfo();
+		auto indirectInfo = indirectBuffers[frameIndex]->descriptorInfo();
+		auto statsInfo = statsBuffers[frameIndex]->descriptorInfo();
+		AmasDescriptorWriter(*instanceSetLayout, *instancePool)
+			.writeBuffer(0, &instanceInfo)
+			.writeBuffer(1, &visibleInfo)
+			.writeBuffer(2, &cullInfo)
+			.writeBuffer(3, &indirectInfo)
+			.writeBuffer(4, &statsInfo)
+			.overwrite(instanceSets[frameIndex]);
+	}
 
+	void SimpleRenderSystem::createPipelineLayout(const std::vector<std::unique_ptr<AmasDescriptorSetLayout>>& layouts) {
 		std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
 		for (int i = 0; i < layouts.size(); i++) {
 			descriptorSetLayouts.push_back(layouts[i]->getDescriptorSetLayout());
 		}
+		// the shader expects the instance buffer right after the global and component sets
+		assert(descriptorSetLayouts.size() == 2 && "Instance set must be bound at set 2");
+		descriptorSetLayouts.push_back(instanceSetLayout->getDescriptorSetLayout());
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
 		if (vkCreatePipelineLayout(amasDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
 			VK_SUCCESS) {
 			throw std::runtime_error("failed to create pipeline layout!");
@@ -61,51 +233,457 @@ namespace amas {
 		pipelineConfig.pipelineLayout = pipelineLayout;
 		amasPipeline = std::make_unique<AmasPipeline>(
 			amasDevice,
-			"shaders/simple_shader.vert.spv",
+			vertexShaderPath(AmasModel::VERTEX_FORMAT),
 			"shaders/simple_shader.frag.spv",
 			pipelineConfig);
 	}
 
-	void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo, std::vector<VkDescriptorSet>& componentSets, std::vector<std::unique_ptr<AmasBuffer>>& componentUboBuffers) {
-		amasPipeline->bind(frameInfo.commandBuffer);
+	void SimpleRenderSystem::createCullPipeline(const std::vector<std::unique_ptr<AmasDescriptorSetLayout>>& layouts) {
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(CullPushConstantData);
+
+		// the frustum comes from the global ubo, the instance set follows it
+		std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts{
+			layouts[0]->getDescriptorSetLayout(),
+			instanceSetLayout->getDescriptorSetLayout() };
 
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(amasDevice.device(), &pipelineLayoutInfo, nullptr, &cullPipelineLayout) !=
+			VK_SUCCESS) {
+			throw std::runtime_error("failed to create cull pipeline layout!");
+		}
+
+		cullPipeline = std::make_unique<AmasPipeline>(amasDevice, "shaders/cull.comp.spv", cullPipelineLayout);
+	}
+
+	void SimpleRenderSystem::setCullingMode(CullingMode mode) {
+		if (mode == CullingMode::GPU && !amasDevice.optionalFeatures.drawIndirectFirstInstance) {
+			mode = CullingMode::CPU;
+		}
+		cullingMode = mode;
+	}
+
+	void SimpleRenderSystem::readCullingStats(int frameIndex) {
+		auto& statsBuffer = statsBuffers[frameIndex];
+		statsBuffer->invalidate();
+		auto* counters = static_cast<CullingCounters*>(statsBuffer->getMappedMemory());
+
+		if (frameObjectCounts[frameIndex] > 0) {
+			cullingStats.objectCount = frameObjectCounts[frameIndex];
+			cullingStats.visibleCount = counters->visibleCount + frameClusteredCounts[frameIndex];
+			// objects the bvh rejected never reached the shader, count them as culled too
+			cullingStats.culledCount = cullingStats.objectCount - cullingStats.visibleCount;
+			cullingStats.clusterCount = counters->visibleClusterCount + counters->culledClusterCount;
+			cullingStats.visibleClusterCount = counters->visibleClusterCount;
+		}
+
+		*counters = CullingCounters{};
+		statsBuffer->flush();
+	}
+
+	void SimpleRenderSystem::prepareGameObjects(FrameInfo& frameInfo) {
+		// beginFrame waited on this frame's previous submission, so its counters are final
+		readCullingStats(frameInfo.frameIndex);
+
+		drawItems.clear();
+		drawBatches.clear();
+		auto& registry = frameInfo.registry;
+		auto& materials = registry.pool<MaterialComponent>();
+		auto addDrawItem = [&](Entity entity, ModelComponent& model, TransformComponent& transform) {
+			if (model.model == nullptr) return;
+			auto* material = materials.tryGet(entity.index);
+			AmasTexture* texture = material ? material->AmasTexture.get() : nullptr;
+			drawItems.push_back({ model.model.get(), texture, entity.index, &transform, transform.mat4() });
+		};
+
+		uint32_t objectCount = 0;
+		const AmasFrustum frustum = frameInfo.camera.getFrustum();
+		if (cullingMode == CullingMode::NONE) {
+			registry.each<ModelComponent, TransformComponent>(addDrawItem);
+			objectCount = static_cast<uint32_t>(drawItems.size());
+		}
+		else {
+			// only objects whose box touches the frustum are visited, the exact test then runs per mode
+			bvhResults.clear();
+			frameInfo.sceneBvh.models.queryFrustum(frustum, bvhResults);
+			auto& models = registry.pool<ModelComponent>();
+			auto& transforms = registry.pool<TransformComponent>();
+			for (uint32_t index : bvhResults) {
+				addDrawItem(registry.entityAt(index), models.get(index), transforms.get(index));
+			}
+			objectCount = frameInfo.sceneBvh.models.getProxyCount();
+
+			if (cullingMode == CullingMode::CPU) {
+				cullOnHost(frustum);
+			}
+		}
+
+		const bool gpuCulling = cullingMode == CullingMode::GPU;
+		frameObjectCounts[frameInfo.frameIndex] = gpuCulling ? objectCount : 0;
+		frameClusteredCounts[frameInfo.frameIndex] = 0;
+		if (!gpuCulling) {
+			uint32_t visibleCount = static_cast<uint32_t>(drawItems.size());
+			cullingStats = { objectCount, visibleCount, objectCount - visibleCount, 0, 0 };
+		}
+
+		uint32_t instanceCount = static_cast<uint32_t>(drawItems.size());
+		lodStats = {};
+		if (drawItems.empty()) {
+			return;
+		}
+
+		selectLods(frameInfo.camera, static_cast<float>(frameInfo.renderer.getSwapChainExtent().height));
+
+		// Objects sharing a model, level of detail and material become neighbours and turn into one
+		// instanced command, commands on the same geometry page then go out as a single indirect draw.
+		std::sort(drawItems.begin(), drawItems.end(), [](const DrawItem& a, const DrawItem& b) {
+			uint32_t pageA = a.model->getMesh().page;
+			uint32_t pageB = b.model->getMesh().page;
+			if (pageA != pageB) return pageA < pageB;
+			if (a.model != b.model) return std::less<AmasModel*>{}(a.model, b.model);
+			if (a.lod != b.lod) return a.lod < b.lod;
+			return std::less<AmasTexture*>{}(a.texture, b.texture);
+		});
+
+		// Objects drawn at full detail from a split mesh get one cull object per meshlet, and every
+		// meshlet of a group its own command. The level is shared by the group, so is the choice.
+		uint32_t clusterCount = 0;
+		uint32_t clusteredCount = 0;
+		uint32_t cullObjectCount = 0;
+		for (auto& item : drawItems) {
+			const uint32_t meshletCount = item.model->getMeshletCount();
+			item.clustered = cullingMode != CullingMode::NONE && item.lod == 0 && meshletCount > 0;
+			item.firstCluster = clusterCount;
+			if (item.clustered) {
+				clusterCount += meshletCount;
+				clusteredCount++;
+			}
+			cullObjectCount += item.clustered ? meshletCount : 1;
+		}
+		frameClusteredCounts[frameInfo.frameIndex] = gpuCulling ? clusteredCount : 0;
+		if (cullingMode == CullingMode::CPU) {
+			cullClustersOnHost(frustum, frameInfo.camera);
+		}
+
+		reserveInstances(frameInfo.frameIndex, instanceCount, cullObjectCount);
+
+		auto& instanceBuffer = instanceBuffers[frameInfo.frameIndex];
+		auto& visibleBuffer = visibleBuffers[frameInfo.frameIndex];
+		auto& cullBuffer = cullBuffers[frameInfo.frameIndex];
+		auto& indirectBuffer = indirectBuffers[frameInfo.frameIndex];
+		auto* instances = static_cast<InstanceData*>(instanceBuffer->getMappedMemory());
+		auto* visible = static_cast<uint32_t*>(visibleBuffer->getMappedMemory());
+		auto* cullObjects = static_cast<CullObject*>(cullBuffer->getMappedMemory());
+		auto* commands = static_cast<VkDrawIndexedIndirectCommand*>(indirectBuffer->getMappedMemory());
+
+		uint32_t commandCount = 0;
+		auto addCommand = [&](const AmasGeometryPool::Mesh& mesh, uint32_t indexCount, uint32_t firstIndex,
+			uint32_t instanceCount, uint32_t firstInstance) {
+			if (drawBatches.empty() || drawBatches.back().page != mesh.page) {
+				drawBatches.push_back({ mesh.page, commandCount, 0 });
+			}
+			drawBatches.back().commandCount++;
+
+			// the culling pass counts the surviving instances back up from zero
+			auto& command = commands[commandCount++];
+			command.indexCount = indexCount;
+			command.instanceCount = gpuCulling ? 0 : instanceCount;
+			command.firstIndex = mesh.firstIndex + firstIndex;
+			command.vertexOffset = mesh.vertexOffset;
+			command.firstInstance = firstInstance;
+		};
+
+		// every cull object owns a slot of the visible buffer within its command's range
+		uint32_t slotCount = 0;
+		uint32_t first = 0;
+		while (first < instanceCount) {
+			uint32_t last = first + 1;
+			while (last < instanceCount && drawItems[last].model == drawItems[first].model &&
+				drawItems[last].lod == drawItems[first].lod && drawItems[last].texture == drawItems[first].texture) {
+				last++;
+			}
+
+			const AmasModel& model = *drawItems[first].model;
+			const auto& mesh = model.getMesh();
+			const auto& bounds = model.getBounds();
+			const auto& decode = model.getPositionDecode();
+			for (uint32_t i = first; i < last; i++) {
+				instances[i].modelMatrix = drawItems[i].modelMatrix;
+				instances[i].normalMatrix = drawItems[i].transform->normalMatrix();
+				instances[i].positionOffset = glm::vec4(decode.offset, 0.f);
+				instances[i].positionScale = glm::vec4(decode.scale, 0.f);
+			}
+
+			if (!drawItems[first].clustered) {
+				const uint32_t firstSlot = slotCount;
+				for (uint32_t i = first; i < last; i++) {
+					cullObjects[slotCount] = { glm::vec4(bounds.center, bounds.radius), glm::vec4(0.f, 0.f, 0.f, 1.f), commandCount, i, 0, 0 };
+					visible[slotCount++] = i;
+				}
+				const auto& lod = model.getLod(drawItems[first].lod);
+				addCommand(mesh, lod.indexCount, lod.firstIndex, last - first, firstSlot);
+				first = last;
+				continue;
+			}
+
+			for (uint32_t m = 0; m < model.getMeshletCount(); m++) {
+				const auto& meshlet = model.getMeshlet(m);
+				const uint32_t firstSlot = slotCount;
+				for (uint32_t i = first; i < last; i++) {
+					if (gpuCulling) {
+						const glm::vec4 cone = preservesAngles(drawItems[i].modelMatrix) ? meshlet.cone : glm::vec4(0.f, 0.f, 0.f, 1.f);
+						cullObjects[slotCount] = { meshlet.sphere, cone, commandCount, i, 1, 0 };
+						visible[slotCount++] = i;
+					}
+					else if (clusterVisibility[drawItems[i].firstCluster + m]) {
+						visible[slotCount++] = i;
+					}
+				}
+				// the host already dropped the culled instances, a meshlet none of them shows needs no command
+				if (slotCount == firstSlot) continue;
+				addCommand(mesh, meshlet.indexCount, meshlet.firstIndex, slotCount - firstSlot, firstSlot);
+			}
+			first = last;
+		}
+		instanceBuffer->flush();
+		visibleBuffer->flush();
+		cullBuffer->flush();
+		indirectBuffer->flush();
+
+		auto& drawCountBuffer = drawCountBuffers[frameInfo.frameIndex];
+		auto* drawCounts = static_cast<uint32_t*>(drawCountBuffer->getMappedMemory());
+		for (uint32_t i = 0; i < drawBatches.size(); i++) {
+			drawCounts[i] = drawBatches[i].commandCount;
+		}
+		drawCountBuffer->flush();
+
+		if (!gpuCulling) {
+			return;
+		}
+
+		cullPipeline->bind(frameInfo.commandBuffer);
+
+		std::array<VkDescriptorSet, 2> descriptorSets{
+			frameInfo.globalDescriptorSet,
+			instanceSets[frameInfo.frameIndex] };
 		vkCmdBindDescriptorSets(
 			frameInfo.commandBuffer,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			cullPipelineLayout,
+			0,
+			static_cast<uint32_t>(descriptorSets.size()),
+			descriptorSets.data(),
+			0,
+			nullptr);
+
+		CullPushConstantData push{};
+		push.objectCount = slotCount;
+		vkCmdPushConstants(
+			frameInfo.commandBuffer,
+			cullPipelineLayout,
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			0,
+			sizeof(CullPushConstantData),
+			&push);
+
+		vkCmdDispatch(frameInfo.commandBuffer, (slotCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+		// the draws read the culled commands and visible indices written above
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			frameInfo.commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			0,
+			1,
+			&barrier,
+			0,
+			nullptr,
+			0,
+			nullptr);
+	}
+
+	void SimpleRenderSystem::selectLods(const AmasCamera& camera, float viewportHeight) {
+		// nearer than this the bounding sphere is treated as touching the camera
+		static constexpr float MIN_LOD_DISTANCE = .01f;
+
+		const glm::mat4& projection = camera.getProjection();
+		// an orthographic projection keeps the same scale at every distance
+		const bool perspective = projection[3][3] == 0.f;
+		const float pixelsPerUnit = glm::abs(projection[1][1]) * viewportHeight * .5f;
+		const glm::vec3 cameraPosition = camera.getPosition();
+
+		for (auto& item : drawItems) {
+			item.lod = 0;
+			const uint32_t lodCount = item.model->getLodCount();
+			if (lodErrorThreshold > 0.f && lodCount > 1) {
+				const auto& bounds = item.model->getBounds();
+				const float scale = maxScale(item.modelMatrix);
+				const glm::vec3 center = glm::vec3(item.modelMatrix * glm::vec4(bounds.center, 1.f));
+				const float distance = perspective
+					? glm::max(glm::length(center - cameraPosition) - bounds.radius * scale, MIN_LOD_DISTANCE)
+					: 1.f;
+				const float pixelsPerObjectUnit = pixelsPerUnit * scale / distance;
+				while (item.lod + 1 < lodCount &&
+					item.model->getLod(item.lod + 1).error * pixelsPerObjectUnit <= lodErrorThreshold) {
+					item.lod++;
+				}
+			}
+			lodStats.drawnTriangles += item.model->getLod(item.lod).indexCount / 3;
+			lodStats.fullDetailTriangles += item.model->getLod(0).indexCount / 3;
+		}
+	}
+
+	void SimpleRenderSystem::cullOnHost(const AmasFrustum& frustum) {
+		cullSpheres.clear();
+		cullSpheres.reserve(drawItems.size());
+		for (const auto& item : drawItems) {
+			const auto& bounds = item.model->getBounds();
+			cullSpheres.add(glm::vec3(item.modelMatrix * glm::vec4(bounds.center, 1.f)), bounds.radius * maxScale(item.modelMatrix));
+		}
+
+		cullSpheres.cull(frustum, cullVisibility);
+
+		size_t kept = 0;
+		for (size_t i = 0; i < drawItems.size(); i++) {
+			if (cullVisibility[i]) {
+				drawItems[kept++] = drawItems[i];
+			}
+		}
+		drawItems.resize(kept);
+	}
+
+	void SimpleRenderSystem::cullClustersOnHost(const AmasFrustum& frustum, const AmasCamera& camera) {
+		cullSpheres.clear();
+		for (const auto& item : drawItems) {
+			if (!item.clustered) continue;
+			const float scale = maxScale(item.modelMatrix);
+			for (uint32_t m = 0; m < item.model->getMeshletCount(); m++) {
+				const glm::vec4& sphere = item.model->getMeshlet(m).sphere;
+				cullSpheres.add(glm::vec3(item.modelMatrix * glm::vec4(glm::vec3(sphere), 1.f)), sphere.w * scale);
+			}
+		}
+		cullingStats.clusterCount = static_cast<uint32_t>(cullSpheres.size());
+		cullingStats.visibleClusterCount = cullSpheres.cull(frustum, clusterVisibility);
+
+		// an orthographic view looks along the same direction from everywhere
+		const bool perspective = camera.getProjection()[3][3] == 0.f;
+		const glm::vec3 cameraPosition = camera.getPosition();
+		const glm::vec3 viewDirection = glm::vec3(camera.getInverseView()[2]);
+		for (const auto& item : drawItems) {
+			if (!item.clustered || !preservesAngles(item.modelMatrix)) continue;
+			const glm::mat3& normalMatrix = item.transform->normalMatrix();
+			const float scale = maxScale(item.modelMatrix);
+			for (uint32_t m = 0; m < item.model->getMeshletCount(); m++) {
+				const auto& meshlet = item.model->getMeshlet(m);
+				uint8_t& visible = clusterVisibility[item.firstCluster + m];
+				if (!visible || meshlet.cone.w >= 1.f) continue;
+
+				const glm::vec3 axis = glm::normalize(normalMatrix * glm::vec3(meshlet.cone));
+				const glm::vec3 center = glm::vec3(item.modelMatrix * glm::vec4(glm::vec3(meshlet.sphere), 1.f));
+				const glm::vec3 view = perspective ? center - cameraPosition : viewDirection;
+				const float radius = perspective ? meshlet.sphere.w * scale : 0.f;
+				if (glm::dot(view, axis) >= meshlet.cone.w * glm::length(view) + radius) {
+					visible = 0;
+					cullingStats.visibleClusterCount--;
+				}
+			}
+		}
+	}
+
+	void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo, std::vector<VkDescriptorSet>& componentSets, std::vector<std::unique_ptr<AmasBuffer>>& componentUboBuffers) {
+		if (drawItems.empty()) {
+			return;
+		}
+
+		// the component set only carries an object id that the shaders never read, it is bound once
+		// so the layout stays compatible with the per-object path
+		const std::array<VkDescriptorSet, 3> descriptorSets{
+			frameInfo.globalDescriptorSet,
+			componentSets.at(drawItems[0].entityIndex),
+			instanceSets[frameInfo.frameIndex] };
+
+		// every thread takes a run of draw batches, they only read state prepared above
+		frameInfo.renderer.recordSecondary(
+			static_cast<uint32_t>(drawBatches.size()),
+			MIN_BATCHES_PER_BUFFER,
+			[&](VkCommandBuffer commandBuffer, uint32_t first, uint32_t last) {
+				recordDrawBatches(frameInfo.frameIndex, commandBuffer, descriptorSets, first, last);
+			});
+	}
+
+	void SimpleRenderSystem::recordDrawBatches(
+		int frameIndex,
+		VkCommandBuffer commandBuffer,
+		const std::array<VkDescriptorSet, 3>& descriptorSets,
+		uint32_t firstBatch,
+		uint32_t lastBatch) {
+		amasPipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(
+			commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			pipelineLayout,
 			0,
-			1,
-			&frameInfo.globalDescriptorSet,
+			static_cast<uint32_t>(descriptorSets.size()),
+			descriptorSets.data(),
 			0,
 			nullptr);
 
-		for (auto& kv : frameInfo.gameObjects) {
-			auto& obj = kv.second;
-			if (obj.model == nullptr) continue;
-			SimplePushConstantData push{};
-			push.modelMatrix = obj.transform.mat4();
-			push.normalMatrix = obj.transform.normalMatrix();
-
-			vkCmdPushConstants(
-				frameInfo.commandBuffer,
-				pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0,
-				sizeof(SimplePushConstantData),
-				&push);
-
-			vkCmdBindDescriptorSets(
-				frameInfo.commandBuffer,
-				VK_PIPELINE_BIND_POINT_GRAPHICS,
-				pipelineLayout,
-				1,
-				1,
-				&componentSets.at(obj.getId()),
-				0,
-				nullptr);
+		auto& indirectBuffer = indirectBuffers[frameIndex];
+		auto& drawCountBuffer = drawCountBuffers[frameIndex];
+		auto* commands = static_cast<VkDrawIndexedIndirectCommand*>(indirectBuffer->getMappedMemory());
+		auto& geometryPool = amasDevice.getGeometryPool();
+		const auto& features = amasDevice.optionalFeatures;
+		constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+		for (uint32_t i = firstBatch; i < lastBatch; i++) {
+			const auto& batch = drawBatches[i];
+			geometryPool.bind(commandBuffer, batch.page);
 
-			obj.model->bind(frameInfo.commandBuffer);
-			obj.model->draw(frameInfo.commandBuffer);
+			VkDeviceSize offset = static_cast<VkDeviceSize>(batch.firstCommand) * stride;
+			if (!features.drawIndirectFirstInstance) {
+				// indirect commands cannot address our instance slices, replay them directly,
+				// culling is off in this case so the CPU-written counts are final
+				for (uint32_t c = batch.firstCommand; c < batch.firstCommand + batch.commandCount; c++) {
+					vkCmdDrawIndexed(
+						commandBuffer,
+						commands[c].indexCount,
+						commands[c].instanceCount,
+						commands[c].firstIndex,
+						commands[c].vertexOffset,
+						commands[c].firstInstance);
+				}
+			}
+			else if (features.drawIndirectCount) {
+				amasDevice.cmdDrawIndexedIndirectCount(
+					commandBuffer,
+					indirectBuffer->getBuffer(),
+					offset,
+					drawCountBuffer->getBuffer(),
+					i * sizeof(uint32_t),
+					batch.commandCount,
+					stride);
+			}
+			else if (features.multiDrawIndirect) {
+				vkCmdDrawIndexedIndirect(
+					commandBuffer, indirectBuffer->getBuffer(), offset, batch.commandCount, stride);
+			}
+			else {
+				for (uint32_t c = 0; c < batch.commandCount; c++) {
+					vkCmdDrawIndexedIndirect(
+						commandBuffer, indirectBuffer->getBuffer(), offset + c * stride, 1, stride);
+				}
+			}
 		}
 	}
 
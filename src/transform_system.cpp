@@ -0,0 +1,41 @@
+#include "../include/transform_system.hpp"
+
+namespace amas {
+
+	void TransformSystem::update(FrameInfo& frameInfo) {
+		auto& registry = frameInfo.registry;
+
+		// the dirty transforms are gathered into one batch so their matrices are built several at a time
+		batch.clear();
+		pending.clear();
+		for (auto& transform : registry.pool<TransformComponent>().getComponents()) {
+			if (!transform.isDirty()) continue;
+			batch.add(transform.getTranslation(), transform.getRotation(), transform.getScale());
+			pending.push_back(&transform);
+		}
+		updatedCount = static_cast<uint32_t>(pending.size());
+		models.resize(updatedCount);
+		normals.resize(updatedCount);
+		// every range writes back its own transforms, no two ranges share one
+		frameInfo.jobSystem.parallelFor(updatedCount, COMPOSE_GRAIN_SIZE, [&](uint32_t first, uint32_t last) {
+			batch.compose(first, last, models.data(), normals.data());
+			for (uint32_t i = first; i < last; i++) {
+				pending[i]->setLocalMatrices(models[i], normals[i]);
+			}
+		});
+
+		// world matrices of the parented transforms below anything that changed
+		frameInfo.hierarchy.propagate(registry);
+		updatedCount += frameInfo.hierarchy.getUpdatedCount();
+
+		// compared by version rather than by the dirty flag, a transform may also have been rebuilt
+		// by an earlier mat4() call
+		registry.each<BvhProxyComponent, TransformComponent>(
+			[&](Entity entity, BvhProxyComponent& bvhProxy, TransformComponent& transform) {
+				if (bvhProxy.transformVersion != transform.getVersion()) {
+					frameInfo.sceneBvh.update(registry, entity);
+				}
+			});
+	}
+
+}  // namespace amas
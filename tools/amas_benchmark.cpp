@@ -0,0 +1,316 @@
+#include "../include/amas_job_system.hpp"
+#include "../include/amas_model.hpp"
+#include "../include/amas_transform_batch.hpp"
+#include "../include/amas_utils.hpp"
+
+// libs
+#include "../externals/tinyobjloader/tiny_obj_loader.h"
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace std {
+	template <>
+	struct hash<amas::AmasModel::Vertex> {
+		size_t operator()(amas::AmasModel::Vertex const& vertex) const {
+			size_t seed = 0;
+			amas::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
+			return seed;
+		}
+	};
+}  // namespace std
+
+// Micro-benchmarks of the engine's cpu paths, run from a release build:
+//   amas-benchmark [transforms] [jobs] [obj]...
+// Without arguments every benchmark runs. Each time is the best of several runs.
+namespace {
+
+	constexpr int RUNS = 15;
+
+	// best wall time of fn over RUNS calls, in microseconds
+	double bestTime(const std::function<void()>& fn, int runs = RUNS) {
+		double best = 1e30;
+		for (int run = 0; run < runs; run++) {
+			const auto start = std::chrono::steady_clock::now();
+			fn();
+			const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::min(best, elapsed.count());
+		}
+		return best;
+	}
+
+	const char* kernelName(amas::AmasTransformBatch::Kernel kernel) {
+		switch (kernel) {
+		case amas::AmasTransformBatch::Kernel::SSE2: return "SSE2";
+		case amas::AmasTransformBatch::Kernel::AVX2: return "AVX2";
+		default: return "scalar";
+		}
+	}
+
+	// Every transform recomposed, as after a frame that moved them all. The per-object path is what
+	// TransformComponent::mat4() runs for each dirty transform.
+	void benchmarkTransforms() {
+		using amas::AmasTransformBatch;
+		std::printf("transforms (best kernel on this cpu: %s)\n", kernelName(AmasTransformBatch::bestKernel()));
+		std::printf("  %8s %12s %12s %12s %12s\n", "count", "per object", "scalar", "SSE2", "AVX2");
+
+		std::mt19937 random{ 1 };
+		std::uniform_real_distribution<float> value{ -10.f, 10.f };
+		for (size_t count : { 1000, 10000, 100000 }) {
+			std::vector<glm::vec3> translations(count), rotations(count), scales(count);
+			AmasTransformBatch batch{};
+			batch.reserve(count);
+			for (size_t i = 0; i < count; i++) {
+				translations[i] = { value(random), value(random), value(random) };
+				rotations[i] = { value(random), value(random), value(random) };
+				scales[i] = glm::abs(glm::vec3{ value(random), value(random), value(random) }) + .1f;
+				batch.add(translations[i], rotations[i], scales[i]);
+			}
+			std::vector<glm::mat4> models(count);
+			std::vector<glm::mat3> normals(count);
+
+			const double perObject = bestTime([&] {
+				for (size_t i = 0; i < count; i++) {
+					AmasTransformBatch::compose(translations[i], rotations[i], scales[i], models[i], normals[i]);
+				}
+			});
+			double kernels[3]{};
+			const AmasTransformBatch::Kernel kernelList[3] = {
+				AmasTransformBatch::Kernel::SCALAR, AmasTransformBatch::Kernel::SSE2, AmasTransformBatch::Kernel::AVX2 };
+			for (int k = 0; k < 3; k++) {
+				kernels[k] = bestTime([&] { batch.compose(0, count, models.data(), normals.data(), kernelList[k]); });
+			}
+			std::printf("  %8zu %10.1fus %10.1fus %10.1fus %10.1fus\n", count, perObject, kernels[0], kernels[1], kernels[2]);
+		}
+		std::printf("  a kernel the cpu lacks falls back to the best available one\n");
+	}
+
+	// The same work on 1 to N threads, N the hardware threads. One thread runs it inline, more use a
+	// job system with one worker less, the main thread taking part as it does in a frame.
+	void benchmarkJobs() {
+		using amas::AmasJobSystem;
+		const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		std::printf("jobs (%u hardware threads)\n", maxThreads);
+		std::printf("  %8s %22s %22s %22s\n", "threads", "compose 100k (2048)", "100k items (64)", "10k submits");
+
+		// the frame's TransformSystem pass
+		constexpr size_t TRANSFORM_COUNT = 100000;
+		amas::AmasTransformBatch batch{};
+		batch.reserve(TRANSFORM_COUNT);
+		std::mt19937 random{ 1 };
+		std::uniform_real_distribution<float> value{ -10.f, 10.f };
+		for (size_t i = 0; i < TRANSFORM_COUNT; i++) {
+			batch.add({ value(random), value(random), value(random) }, { value(random), value(random), value(random) }, { 1.f, 1.f, 1.f });
+		}
+		std::vector<glm::mat4> models(TRANSFORM_COUNT);
+		std::vector<glm::mat3> normals(TRANSFORM_COUNT);
+
+		// small uneven items, what culling or recording ranges look like
+		constexpr uint32_t ITEM_COUNT = 100000;
+		std::vector<float> items(ITEM_COUNT);
+		auto itemWork = [&](uint32_t first, uint32_t last) {
+			for (uint32_t i = first; i < last; i++) {
+				float x = static_cast<float>(i);
+				for (uint32_t k = 0; k < 16 + i % 32; k++) x = std::sqrt(x + 1.f);
+				items[i] = x;
+			}
+		};
+
+		double baseline[3]{};
+		for (uint32_t threads = 1; threads <= maxThreads; threads++) {
+			std::unique_ptr<AmasJobSystem> jobs = threads > 1 ? std::make_unique<AmasJobSystem>(threads - 1) : nullptr;
+			auto parallelFor = [&](uint32_t count, uint32_t grainSize, const AmasJobSystem::RangeJob& fn) {
+				if (jobs) jobs->parallelFor(count, grainSize, fn);
+				else fn(0, count);
+			};
+
+			double times[3]{};
+			times[0] = bestTime([&] {
+				parallelFor(static_cast<uint32_t>(TRANSFORM_COUNT), 2048, [&](uint32_t first, uint32_t last) {
+					batch.compose(first, last, models.data(), normals.data());
+				});
+			});
+			times[1] = bestTime([&] { parallelFor(ITEM_COUNT, 64, itemWork); });
+			times[2] = bestTime([&] {
+				constexpr uint32_t SUBMIT_COUNT = 10000;
+				if (!jobs) {
+					for (uint32_t i = 0; i < SUBMIT_COUNT; i++) itemWork(i, i + 1);
+					return;
+				}
+				amas::AmasJobCounter counter{};
+				for (uint32_t i = 0; i < SUBMIT_COUNT; i++) {
+					jobs->submit([&itemWork, i] { itemWork(i, i + 1); }, &counter);
+				}
+				jobs->wait(counter);
+			});
+
+			std::printf("  %8u", threads);
+			for (int k = 0; k < 3; k++) {
+				if (threads == 1) baseline[k] = times[k];
+				std::printf(" %10.1fus (%5.2fx)", times[k], baseline[k] / times[k]);
+			}
+			std::printf("\n");
+		}
+	}
+
+	// Grid of quads in shapeCount shapes, every grid vertex shared by the faces around it through
+	// the same position/texcoord/normal triple.
+	std::string writeObj(const std::string& name, uint32_t shapeCount, uint32_t gridSize) {
+		const auto path = std::filesystem::temp_directory_path() / name;
+		std::ofstream obj{ path };
+		uint32_t base = 1;
+		for (uint32_t shape = 0; shape < shapeCount; shape++) {
+			obj << "o shape" << shape << "\n";
+			for (uint32_t y = 0; y <= gridSize; y++) {
+				for (uint32_t x = 0; x <= gridSize; x++) {
+					const float u = static_cast<float>(x) / gridSize;
+					const float v = static_cast<float>(y) / gridSize;
+					obj << "v " << u << " " << std::sin(u * 6.f + shape) * .1f << " " << v << "\n";
+					obj << "vt " << u << " " << v << "\n";
+					obj << "vn 0 1 0\n";
+				}
+			}
+			const uint32_t row = gridSize + 1;
+			for (uint32_t y = 0; y < gridSize; y++) {
+				for (uint32_t x = 0; x < gridSize; x++) {
+					const uint32_t a = base + y * row + x;
+					const uint32_t corners[4] = { a, a + 1, a + row + 1, a + row };
+					obj << "f";
+					for (uint32_t corner : corners) obj << " " << corner << "/" << corner << "/" << corner;
+					obj << "\n";
+				}
+			}
+			base += row * row;
+		}
+		if (!obj) {
+			throw std::runtime_error("failed to write " + path.string());
+		}
+		return path.string();
+	}
+
+	// The import before the index triple table: every index builds its vertex and looks it up by
+	// value in an unordered_map.
+	void loadObjByValue(const std::string& filepath, std::vector<amas::AmasModel::Vertex>& vertices, std::vector<uint32_t>& indices) {
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn, err;
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str())) {
+			throw std::runtime_error(warn + err);
+		}
+
+		vertices.clear();
+		indices.clear();
+		std::unordered_map<amas::AmasModel::Vertex, uint32_t> uniqueVertices{};
+		for (const auto& shape : shapes) {
+			for (const auto& index : shape.mesh.indices) {
+				amas::AmasModel::Vertex vertex{};
+				if (index.vertex_index >= 0) {
+					vertex.position = {
+						attrib.vertices[3 * index.vertex_index + 0],
+						attrib.vertices[3 * index.vertex_index + 1],
+						attrib.vertices[3 * index.vertex_index + 2] };
+					vertex.color = {
+						attrib.colors[3 * index.vertex_index + 0],
+						attrib.colors[3 * index.vertex_index + 1],
+						attrib.colors[3 * index.vertex_index + 2] };
+				}
+				if (index.normal_index >= 0) {
+					vertex.normal = {
+						attrib.normals[3 * index.normal_index + 0],
+						attrib.normals[3 * index.normal_index + 1],
+						attrib.normals[3 * index.normal_index + 2] };
+				}
+				if (index.texcoord_index >= 0) {
+					vertex.uv = { attrib.texcoords[2 * index.texcoord_index + 0], attrib.texcoords[2 * index.texcoord_index + 1] };
+				}
+				if (uniqueVertices.count(vertex) == 0) {
+					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+					vertices.push_back(vertex);
+				}
+				indices.push_back(uniqueVertices[vertex]);
+			}
+		}
+	}
+
+	// OBJ import up to deduplicated vertices and indices, the part of an import that runs before
+	// the mesh is simplified and optimized
+	void benchmarkObj() {
+		std::printf("obj import\n");
+		std::printf("  %-8s %10s %10s %12s %12s %12s %12s\n", "file", "vertices", "indices", "parse only", "by value", "triples", "per shape");
+
+		amas::AmasJobSystem jobs{};
+		struct File {
+			const char* name;
+			uint32_t shapeCount;
+			uint32_t gridSize;
+		};
+		for (const File& file : { File{ "grid", 1, 400 }, File{ "shapes", 8, 300 } }) {
+			const std::string path = writeObj(std::string{ "amas-benchmark-" } + file.name + ".obj", file.shapeCount, file.gridSize);
+
+			const double parse = bestTime([&] {
+				tinyobj::attrib_t attrib;
+				std::vector<tinyobj::shape_t> shapes;
+				std::vector<tinyobj::material_t> materials;
+				std::string warn, err;
+				tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str());
+			}, 3);
+			std::vector<amas::AmasModel::Vertex> vertices;
+			std::vector<uint32_t> indices;
+			const double byValue = bestTime([&] { loadObjByValue(path, vertices, indices); }, 3);
+			amas::AmasModel::Builder builder{};
+			const double triples = bestTime([&] { builder.loadObj(path); }, 3);
+			const double perShape = bestTime([&] { builder.loadObj(path, &jobs); }, 3);
+
+			std::printf("  %-8s %10zu %10zu %10.1fms %10.1fms %10.1fms %10.1fms\n",
+				file.name, builder.vertices.size(), builder.indices.size(),
+				parse / 1000., byValue / 1000., triples / 1000., perShape / 1000.);
+			std::error_code error;
+			std::filesystem::remove(path, error);
+		}
+		std::printf("  per shape uses %u threads, a triple shared by two shapes becomes two vertices\n", jobs.getThreadCount());
+	}
+
+	struct Benchmark {
+		const char* name;
+		void (*run)();
+	};
+
+	const Benchmark BENCHMARKS[] = {
+		{ "transforms", benchmarkTransforms },
+		{ "jobs", benchmarkJobs },
+		{ "obj", benchmarkObj },
+	};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	std::vector<std::string> selected{ argv + 1, argv + argc };
+	bool ran = false;
+	for (const auto& benchmark : BENCHMARKS) {
+		if (!selected.empty() && std::find(selected.begin(), selected.end(), benchmark.name) == selected.end()) continue;
+		benchmark.run();
+		ran = true;
+	}
+	if (!ran) {
+		std::fprintf(stderr, "usage: amas-benchmark [transforms] [jobs] [obj]...\n");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+#include "../include/amas_pack.hpp"
+
+// std
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Packs engine content for AmasFileSystem:
+//   amas-packer [--lz4] <pack> <file or directory>...
+// Run from the engine's working directory, entries are named by their path relative to it.
+// Directories are packed whole, temporary files left by the mesh cache excepted.
+int main(int argc, char** argv) {
+	bool compress = false;
+	std::string packPath{};
+	std::vector<std::string> inputs{};
+	for (int i = 1; i < argc; i++) {
+		const std::string argument = argv[i];
+		if (argument == "--lz4") {
+			compress = true;
+		} else if (packPath.empty()) {
+			packPath = argument;
+		} else {
+			inputs.push_back(argument);
+		}
+	}
+	if (packPath.empty() || inputs.empty()) {
+		std::cerr << "usage: amas-packer [--lz4] <pack> <file or directory>...\n";
+		return EXIT_FAILURE;
+	}
+
+	try {
+		std::vector<amas::AmasPack::Source> sources{};
+		auto add = [&](const std::filesystem::path& path) {
+			if (path.extension() == ".tmp") return;
+			const std::string name = path.lexically_normal().generic_string();
+			sources.push_back({ name, name, compress });
+		};
+		for (const auto& input : inputs) {
+			if (std::filesystem::is_directory(input)) {
+				for (const auto& entry : std::filesystem::recursive_directory_iterator(input)) {
+					if (entry.is_regular_file()) add(entry.path());
+				}
+			} else if (std::filesystem::is_regular_file(input)) {
+				add(input);
+			} else {
+				throw std::runtime_error("failed to open file: " + input);
+			}
+		}
+
+		amas::AmasPack::write(packPath, std::move(sources));
+
+		// read back, the pack is validated the way the engine will mount it
+		const amas::AmasPack pack{ packPath };
+		uint64_t size = 0;
+		uint64_t storedSize = 0;
+		for (const auto& entry : pack.getEntries()) {
+			std::cout << entry.path << ":  " << entry.size << " bytes";
+			if (entry.compression == amas::AmasPack::Compression::LZ4) {
+				std::cout << ", lz4 " << entry.storedSize;
+			}
+			std::cout << "\n";
+			size += entry.size;
+			storedSize += entry.storedSize;
+		}
+		std::cout << pack.getEntries().size() << " entries, " << size << " bytes, " << storedSize << " stored, "
+			<< pack.getMapping()->size() << " byte pack\n";
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}